@@ -0,0 +1,34 @@
+#ifndef ChunkWriter_h
+#define ChunkWriter_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <Print.h>
+
+//A Print that collects output in a caller owned buffer and hands it to the target a chunk at a time,
+//so a long reply never needs a buffer (or a String) as big as the whole thing.
+//With no target the buffer is the whole reply and anything past its size is dropped.
+class ChunkWriter : public Print
+{
+public:
+  ChunkWriter(char * buffer, size_t size, Print * target = NULL);
+
+  virtual size_t write(uint8_t value);
+  virtual size_t write(const uint8_t * data, size_t len);
+  virtual void flush();
+
+  uint32_t bytesWritten() { return _total; }
+  const char * data() { return _buffer; }
+  size_t length() { return _used; }
+
+  using Print::write;
+
+private:
+  char * _buffer;
+  size_t _size;
+  size_t _used;
+  uint32_t _total;
+  Print * _target;
+};
+
+#endif
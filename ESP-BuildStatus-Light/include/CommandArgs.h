@@ -0,0 +1,77 @@
+#ifndef CommandArgs_h
+#define CommandArgs_h
+
+#include <inttypes.h>
+#include <WString.h>
+
+//Every key a command can take. Keys are matched case-insensitively once while parsing, after that values are looked up by id.
+enum CommandKey
+{
+  KeySsid,
+  KeyPw,
+  KeyUseDhcp,
+  KeyIp,
+  KeySubnet,
+  KeyGateway,
+  KeyIndex,
+  KeyId,
+  KeyRed,
+  KeyGreen,
+  KeyBlue,
+  KeyFlashTime,
+  KeyDisplayTime,
+  KeyEffect,
+  KeyPeriod,
+  KeyEase,
+  KeyProgress,
+  KeyBrightness,
+  KeyMessage,
+  KeyLevel,
+  KeyUserId,
+  KeyData,
+  KeyEncoding,
+  KeyPlain, //the body of an HTTP POST
+  KeyReset,
+  KeyZone,
+  KeyZones,
+  KeyUrl,
+  KeyInterval,
+  KeyStatusField,
+  KeyBranchField,
+  KeyAuthorField,
+  CommandKeyCount,
+};
+
+//Returns CommandKeyCount if the name isn't a known key
+CommandKey getCommandKey(const char * name, uint16_t len);
+const char * getCommandKeyName(CommandKey key);
+
+//Splits a "COMMAND KEY=value;KEY=value;" line into value spans in one pass. The spans point into the line,
+//so nothing is copied and the line has to outlive the CommandArgs.
+class CommandArgs
+{
+public:
+  CommandArgs();
+
+  //Returns how many known keys were found. Unknown keys are skipped, the first value for a key wins
+  //and a key with an empty value or no closing ; counts as not found.
+  uint8_t parse(const char * input, uint16_t len);
+  void clear();
+  //Adds a value that was already split out, like an HTTP arg. Same rules as parse().
+  bool set(CommandKey key, const char * value, uint16_t len);
+
+  bool has(CommandKey key) const;
+  //Returns NULL and a len of 0 if the key wasn't found
+  const char * get(CommandKey key, uint16_t &len) const;
+  //Same as String.toInt(), invalid or missing values read as 0
+  long getInt(CommandKey key) const;
+  bool equalsIgnoreCase(CommandKey key, const char * expected) const;
+  //Only needed for values that are kept, like settings
+  String getString(CommandKey key) const;
+
+private:
+  const char * _values[CommandKeyCount];
+  uint16_t _lengths[CommandKeyCount];
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef CommandTable_h
+#define CommandTable_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <Print.h>
+#include "CommandArgs.h"
+
+//Commands are listed once in a constexpr table that both the serial console and the HTTP server dispatch through.
+//Each one is looked up with a perfect hash built at compile time, so adding a command is just adding a row.
+
+#define COMMAND_AUTH 0x01 //HTTP callers need a valid userid, the serial console is trusted
+#define COMMAND_STREAM 0x02 //HTTP replies are sent in chunks as they are printed, always with a 200
+#define COMMAND_JSON 0x04 //HTTP replies that succeed are application/json, errors are still text
+#define COMMAND_SLOT_BITS 5
+#define COMMAND_SLOTS (1 << COMMAND_SLOT_BITS) //hash table size
+#define COMMAND_NONE 0xFF
+#define COMMAND_MAX_SEED 4096
+
+static_assert(CommandKeyCount <= 32, "Required params are a 32 bit mask of CommandKeys");
+
+//Returns an HTTP style status code, anything written to out is the reply
+typedef int (*CommandHandler)(const CommandArgs &args, Print &out);
+
+struct Command
+{
+  const char * name; //serial command, NULL if HTTP only
+  const char * route; //HTTP path, NULL if serial only
+  CommandHandler handler;
+  uint32_t required; //commandKeyBit() of every param that has to be there
+  uint8_t flags;
+};
+
+struct CommandIndex
+{
+  uint32_t seed;
+  uint8_t slots[COMMAND_SLOTS]; //index into the command table or COMMAND_NONE
+};
+
+constexpr uint32_t commandKeyBit(CommandKey key)
+{
+  return 1UL << key;
+}
+
+constexpr uint16_t commandNameLength(const char * name)
+{
+  uint16_t len = 0;
+
+  while (name[len])
+  {
+    len++;
+  }
+
+  return len;
+}
+
+//FNV-1a over the upper cased name, so serial lookups can be case-insensitive
+constexpr uint32_t hashCommandName(const char * name, uint16_t len, uint32_t seed)
+{
+  uint32_t hash = 2166136261UL ^ seed;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    char c = name[i];
+    hash ^= (uint8_t)(c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c);
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+//The top bits, the low bits of FNV only depend on the low bits of each character
+constexpr uint8_t getCommandSlot(uint32_t hash)
+{
+  return hash >> (32 - COMMAND_SLOT_BITS);
+}
+
+constexpr const char * getCommandName(const Command &command, bool route)
+{
+  return route ? command.route : command.name;
+}
+
+//Tries seeds until every name lands in its own slot. Gives back a seed of COMMAND_MAX_SEED if none does,
+//which the static_assert next to the table catches.
+template <size_t N>
+constexpr CommandIndex buildCommandIndex(const Command (&table)[N], bool route)
+{
+  static_assert(N < COMMAND_NONE, "Too many commands for the index");
+
+  for (uint32_t seed = 0; seed < COMMAND_MAX_SEED; seed++)
+  {
+    CommandIndex index = {};
+    bool collided = false;
+
+    index.seed = seed;
+
+    for (uint8_t i = 0; i < COMMAND_SLOTS; i++)
+    {
+      index.slots[i] = COMMAND_NONE;
+    }
+
+    for (uint8_t i = 0; i < N && !collided; i++)
+    {
+      const char * name = getCommandName(table[i], route);
+
+      if (name == NULL)
+      {
+        continue;
+      }
+
+      uint8_t slot = getCommandSlot(hashCommandName(name, commandNameLength(name), seed));
+      collided = index.slots[slot] != COMMAND_NONE;
+      index.slots[slot] = i;
+    }
+
+    if (!collided)
+    {
+      return index;
+    }
+  }
+
+  return { COMMAND_MAX_SEED, {} };
+}
+
+//One hash, one compare. Serial commands match in any case, routes only exactly, the way ESP8266WebServer matched them.
+//Returns NULL if there is no such command.
+template <size_t N>
+const Command * findCommand(const Command (&table)[N], const CommandIndex &index, bool route, const char * name, uint16_t len)
+{
+  uint8_t slot = index.slots[getCommandSlot(hashCommandName(name, len, index.seed))];
+
+  if (slot == COMMAND_NONE)
+  {
+    return NULL;
+  }
+
+  const char * found = getCommandName(table[slot], route);
+
+  if (strlen(found) != len || (route ? strncmp(found, name, len) : strncasecmp(found, name, len)) != 0)
+  {
+    return NULL;
+  }
+
+  return &table[slot];
+}
+
+//Returns the first required param that is missing, or CommandKeyCount if there are none
+inline CommandKey getMissingCommandKey(const Command &command, const CommandArgs &args)
+{
+  for (uint8_t i = 0; i < CommandKeyCount; i++)
+  {
+    if ((command.required & commandKeyBit((CommandKey)i)) && !args.has((CommandKey)i))
+    {
+      return (CommandKey)i;
+    }
+  }
+
+  return CommandKeyCount;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ConfigStore_h
+#define ConfigStore_h
+
+#include <inttypes.h>
+
+#define CONFIG_MAGIC 0x46434C42 //"BLCF"
+
+struct ConfigHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size; //of the data that follows
+  uint32_t sequence; //one more on every save, the highest copy is the newest
+  uint32_t crc; //CRC-32 over the header up to here, then the data
+};
+
+//Keeps one fixed size record in two SPIFFS files, each a ConfigHeader followed by the data.
+//A save goes over the older copy, so if power is lost part way through, its CRC fails and the other copy loads.
+//
+//The version is for changes the record can't survive. Fields added at the end don't need one: a shorter record
+//from older firmware loads with the new fields zeroed.
+class ConfigStore
+{
+public:
+  ConfigStore(const char * pathA, const char * pathB, uint16_t version);
+
+  //Reads the newest copy that checks out straight into data. Returns false, with data zeroed, if neither does.
+  bool load(void * data, uint16_t size);
+  bool save(const void * data, uint16_t size);
+
+  uint32_t getSequence() { return _sequence; }
+
+private:
+  const char * _paths[2];
+  uint16_t _version;
+  uint32_t _sequence;
+  uint8_t _current; //copy last loaded or saved, the next save goes to the other one
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef ControlProtocol_h
+#define ControlProtocol_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+//Binary control frames, sent over UDP for updates that can't wait for HTTP.
+//Every multi-byte field is little endian.
+//
+//  offset  size  field
+//  0       2     magic, "BL"
+//  2       1     version, CONTROL_VERSION
+//  3       1     opcode, see ControlOpcode
+//  4       4     sequence, must be newer than the last one accepted for this token
+//  8       4     boot id, the light's current one, see below
+//  12      1     token id, the User Id index 1 to CONTROL_TOKEN_COUNT
+//  13      1     zone, 1 to the zone count or 0 for every zone. Only color and effect frames use it.
+//  14      2     payload length
+//  16      n     payload
+//  16 + n  16    first 16 bytes of HMAC-SHA256 over bytes 0 to 16 + n
+//
+//The HMAC key is the first CONTROL_KEY_SIZE bytes of HMAC-SHA256("udp") keyed with the User Id's stored digest
+//(SHA-256 of the User Id, truncated the same way). Neither the User Id nor the digest shown by GETUSERIDS is the key.
+//
+//Sequences are only kept in RAM, so the light picks a random boot id every time it starts and only takes frames
+//signed with it. A frame captured before a restart can't be replayed after it. A sender that doesn't know the
+//boot id yet sends any frame, gets ControlWrongBoot back and signs again with the boot id from the ack.
+//
+//Every frame gets a CONTROL_ACK_SIZE byte ack back: magic, version, ControlResult, the frame's sequence, then the boot id.
+
+#define CONTROL_MAGIC_0 'B'
+#define CONTROL_MAGIC_1 'L'
+#define CONTROL_VERSION 2
+#define CONTROL_HEADER_SIZE 16
+#define CONTROL_MAC_SIZE 16
+#define CONTROL_KEY_SIZE 16
+#define CONTROL_MAX_PAYLOAD 256
+#define CONTROL_MAX_FRAME (CONTROL_HEADER_SIZE + CONTROL_MAX_PAYLOAD + CONTROL_MAC_SIZE)
+#define CONTROL_ACK_SIZE 12
+#define CONTROL_TOKEN_COUNT 16 //no more than 16, see _seenTokens
+
+enum ControlOpcode : uint8_t
+{
+  OpColor = 1,    //red, green, blue, int16 flash time, int16 display time
+  OpPixels = 2,   //raw pixel payload, the same bytes as /Display/Pixels with encoding=raw
+  OpEffect = 3,   //effect, flags (bit 0 eased), uint16 period, progress, brightness
+  OpMessage = 4,  //message text, not null terminated
+};
+
+#define CONTROL_COLOR_SIZE 7
+#define CONTROL_EFFECT_SIZE 6
+
+enum ControlResult : uint8_t
+{
+  ControlOk,
+  ControlBadFrame,    //wrong magic or size
+  ControlBadVersion,
+  ControlUnknownToken,
+  ControlBadMac,
+  ControlStale,       //sequence already seen or older
+  ControlWrongBoot,   //signed for another boot id, the ack has the current one
+  ControlBadPayload,  //authenticated, but the opcode or payload was wrong
+  ControlResultCount
+};
+
+//Points into the received packet, only good until the next one is read
+struct ControlFrame
+{
+  uint8_t opcode;
+  uint8_t tokenId;
+  uint8_t zone;
+  uint32_t sequence;
+  uint32_t bootId;
+  const uint8_t * payload;
+  uint16_t payloadLen;
+};
+
+//Fills in the key for a token id, returns false if there is no such token
+typedef bool (*ControlKeyLookup)(uint8_t tokenId, uint8_t key[CONTROL_KEY_SIZE]);
+
+//The key from the User Id itself, for senders
+void getControlKey(const char * token, size_t len, uint8_t key[CONTROL_KEY_SIZE]);
+//The key from the stored SHA-256 digest of the User Id, for the light
+void deriveControlKey(const uint8_t digest[CONTROL_KEY_SIZE], uint8_t key[CONTROL_KEY_SIZE]);
+void signControlFrame(uint8_t * frame, size_t len, const uint8_t key[CONTROL_KEY_SIZE]);
+uint16_t readControlUint16(const uint8_t * data);
+uint32_t readControlUint32(const uint8_t * data);
+void buildControlAck(uint32_t sequence, uint32_t bootId, uint8_t result, uint8_t ack[CONTROL_ACK_SIZE]);
+const char * getControlResultName(ControlResult result);
+
+//Checks frames and drops replays. Holds no buffers of its own.
+class ControlReceiver
+{
+public:
+  ControlReceiver(ControlKeyLookup lookup);
+
+  //Has to be random and different on every start, 0 is taken as 1
+  void begin(uint32_t bootId);
+  uint32_t getBootId() { return _bootId; }
+
+  //The sequence is only recorded once the MAC checks out, so a forged frame can't block real ones
+  ControlResult receive(const uint8_t * data, size_t len, ControlFrame &frame);
+  uint32_t getCount(ControlResult result) { return _counts[result]; }
+  //receive() leaves ok frames uncounted, the caller counts ok or bad payload once it has applied them
+  void count(ControlResult result) { _counts[result]++; }
+
+private:
+  ControlKeyLookup _lookup;
+  uint32_t _bootId;
+  uint32_t _lastSequence[CONTROL_TOKEN_COUNT];
+  uint16_t _seenTokens; //bit per token, set once a sequence has been accepted
+  uint32_t _counts[ControlResultCount];
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef HttpServer_h
+#define HttpServer_h
+
+#include <inttypes.h>
+#include <WiFiServer.h>
+#include <WiFiClient.h>
+
+//A small non-blocking HTTP/1.1 server. poll() accepts clients into a fixed pool, reads whatever bytes have
+//arrived and parses each request in place in its connection's buffer. Once a request is complete the handler
+//is called with it. Nothing is allocated per request and a slow client only holds up its own slot.
+
+#define HTTP_MAX_CONNECTIONS 4
+#define HTTP_REQUEST_SIZE 1024 //request line, headers and body together
+#define HTTP_MAX_ARGS 16
+#define HTTP_TIMEOUT 3000 //ms to receive the whole request
+#define HTTP_WRITE_BUDGET 20 //ms a whole reply may wait on a full send buffer, past it the rest is dropped
+#define HTTP_CLOSE_WAIT 1 //ms close() waits for the send buffer to drain, 0 would mean the core's default
+
+struct HttpArg
+{
+  const char * name;
+  const char * value;
+  uint16_t nameLen;
+  uint16_t valueLen;
+};
+
+//One connection and the request being read on it. Writing to it writes the reply body, after beginResponse().
+class HttpRequest : public Print
+{
+public:
+  HttpRequest();
+
+  const char * method() { return _method; }
+  //URL decoded, like the args
+  const char * path() { return _path; }
+  uint16_t pathLength() { return _pathLen; }
+  //Query args, then form args from the body. Names and values are URL decoded.
+  uint8_t argCount() { return _argCount; }
+  const HttpArg &arg(uint8_t index) { return _args[index]; }
+  //Returns NULL and a len of 0 if there is no such arg
+  const char * arg(const char * name, uint16_t &len);
+  //A body that isn't a form, like ESP8266WebServer's "plain" arg
+  const char * body() { return _bodyLen ? _body : 0; }
+  uint16_t bodyLength() { return _bodyLen; }
+
+  //Sends a complete reply
+  void send(int status, const char * contentType, const char * content, size_t len);
+  //Sends the status line and headers for a reply whose body is then printed to this request
+  //and ends when the connection closes
+  void beginResponse(int status, const char * contentType);
+
+  virtual size_t write(uint8_t value);
+  virtual size_t write(const uint8_t * data, size_t len);
+  using Print::write;
+
+private:
+  friend class HttpServer;
+
+  enum State
+  {
+    Closed,
+    ReadingHeaders,
+    ReadingBody,
+    Complete,
+  };
+
+  void open(const WiFiClient &client, uint32_t now);
+  void close();
+  //Returns a status other than 0 if the request can't be handled
+  int receive();
+  int parseHeaders();
+  bool parseArgs(char * start, uint16_t len);
+  void sendHeaders(int status, const char * contentType, int32_t contentLength);
+  size_t send(const uint8_t * data, size_t len);
+
+  WiFiClient _client;
+  State _state;
+  uint32_t _openedAt;
+  uint32_t _replyStartedAt;
+  bool _writeCut;
+  char _buffer[HTTP_REQUEST_SIZE + 1];
+  uint16_t _length;
+  uint16_t _headerEnd; //where the body starts
+  uint16_t _contentLength;
+  bool _formBody;
+  const char * _method;
+  const char * _path;
+  uint16_t _pathLen;
+  char * _body;
+  uint16_t _bodyLen;
+  HttpArg _args[HTTP_MAX_ARGS];
+  uint8_t _argCount;
+};
+
+//A ChunkWriter target for a reply that is normally sent whole, with its status and a Content-Length, once the
+//handler is done. If the reply outgrows the buffer, the first write starts a 200 reply and the rest is streamed,
+//so a long reply is never cut short.
+class HttpSpillResponse : public Print
+{
+public:
+  HttpSpillResponse(HttpRequest &request, const char * contentType);
+
+  bool isStarted() { return _started; }
+
+  virtual size_t write(uint8_t value);
+  virtual size_t write(const uint8_t * data, size_t len);
+  using Print::write;
+
+private:
+  HttpRequest &_request;
+  const char * _contentType;
+  bool _started;
+};
+
+typedef void (*HttpRequestHandler)(HttpRequest &request);
+
+class HttpServer
+{
+public:
+  HttpServer(uint16_t port);
+
+  void begin();
+  void onRequest(HttpRequestHandler handler) { _handler = handler; }
+  //Does whatever can be done without waiting. Call it from loop().
+  void poll();
+
+  uint8_t activeConnections();
+  uint32_t requestsServed() { return _served; }
+  uint32_t requestsRejected() { return _rejected; }
+  //Replies cut short by HTTP_WRITE_BUDGET
+  uint32_t repliesCut() { return _cut; }
+
+private:
+  WiFiServer _server;
+  HttpRequestHandler _handler;
+  HttpRequest _connections[HTTP_MAX_CONNECTIONS];
+  uint32_t _served;
+  uint32_t _rejected;
+  uint32_t _cut;
+};
+
+const char * getHttpStatusText(int status);
+
+#endif
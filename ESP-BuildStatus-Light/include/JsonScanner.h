@@ -0,0 +1,80 @@
+#ifndef JsonScanner_h
+#define JsonScanner_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define JSON_MAX_DEPTH 8
+#define JSON_MAX_PATH 64 //longest dotted path that can match a field
+#define JSON_MAX_FIELDS 4
+#define JSON_MAX_VALUE 48 //longer values are cut short
+
+//Pulls a few scalar fields out of a JSON document as it streams past, a byte at a time, holding only the current
+//path and the captured values. Nothing is allocated and the input never needs to be in memory all at once.
+//
+//Fields are dotted paths of object keys, with [] standing for any element of an array, e.g. "builds[].result".
+//The first value at each path wins. Strings are unescaped, other scalars are kept as written (true, 42, null).
+class JsonScanner
+{
+public:
+  JsonScanner();
+
+  //The paths are not copied and must outlive the scanner
+  void setFields(const char * const * paths, uint8_t count);
+  //Forgets the input and the captured values, keeping the fields
+  void reset();
+
+  //Returns false once the input can't be JSON, the rest is then ignored
+  bool feed(const char * data, size_t len);
+
+  //True once the whole top level value has been read
+  bool isDone() { return _state == JsonDone; }
+  bool hasError() { return _state == JsonError; }
+  bool isFound(uint8_t field) { return _found & (1 << field); }
+  //Empty if the field wasn't found
+  const char * getValue(uint8_t field) { return _values[field]; }
+
+private:
+  enum State : uint8_t
+  {
+    JsonValue,
+    JsonFirstValue, //just after [, so ] is allowed
+    JsonKey,
+    JsonFirstKey, //just after {, so } is allowed
+    JsonColon,
+    JsonNext, //after a value inside a container
+    JsonString,
+    JsonEscape,
+    JsonUnicode,
+    JsonLiteral,
+    JsonDone,
+    JsonError,
+  };
+
+  void scan(char c);
+  void addStringChar(char c);
+  void push(bool isArray);
+  void pop();
+  void startValue();
+  void endValue();
+  void appendPath(char c);
+  void capture(char c);
+
+  const char * const * _paths;
+  uint8_t _fieldCount;
+  State _state;
+  bool _inKey;
+  uint8_t _depth;
+  uint8_t _arrays; //bit per depth
+  uint8_t _pathAt[JSON_MAX_DEPTH]; //path length where each open container started
+  char _path[JSON_MAX_PATH];
+  uint8_t _pathLen; //JSON_MAX_PATH + 1 once the path is too long to match anything
+  int8_t _capture; //field being captured, or -1
+  uint8_t _valueLen;
+  uint16_t _unicode;
+  uint8_t _unicodeDigits;
+  uint8_t _found; //bit per field
+  char _values[JSON_MAX_FIELDS][JSON_MAX_VALUE];
+};
+
+#endif
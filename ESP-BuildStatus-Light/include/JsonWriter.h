@@ -0,0 +1,45 @@
+#ifndef JsonWriter_h
+#define JsonWriter_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <Print.h>
+
+#define JSON_WRITER_MAX_DEPTH 8
+
+//Writes JSON straight to a Print as values are added, with nothing allocated and no buffer of its own.
+//Pair it with a ChunkWriter to fill a fixed buffer or to send a reply in chunks.
+//
+//Keys are NULL for the top level value and inside arrays. They are written as given, so they must not need escaping.
+//String values are escaped. Control characters become \u00XX, UTF-8 is written as it is and any byte that
+//isn't part of a well formed UTF-8 sequence becomes '?'.
+class JsonWriter
+{
+public:
+  JsonWriter(Print & out);
+
+  void beginObject(const char * key = NULL);
+  void endObject();
+  void beginArray(const char * key = NULL);
+  void endArray();
+
+  void addString(const char * key, const char * value);
+  void addString(const char * key, const char * value, size_t len);
+  void addInt(const char * key, int32_t value);
+  void addUint(const char * key, uint32_t value);
+  void addBool(const char * key, bool value);
+  //"a.b.c.d" from an IPAddress's uint32_t, first octet in the low byte
+  void addIp(const char * key, uint32_t address);
+
+private:
+  void begin(const char * key, char bracket);
+  void end(char bracket);
+  void writeKey(const char * key);
+  void writeUint(uint32_t value);
+
+  Print & _out;
+  uint8_t _depth;
+  uint8_t _hasValues; //bit per depth, set once a container has a value so the next one needs a comma
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef LcdGpio_h
+#define LcdGpio_h
+
+#include <inttypes.h>
+
+// Whole-port access to GPIO 0-15, so LiquidCrystal can put a nibble on the
+// bus with one set and one clear register write instead of a digitalWrite()
+// per pin. Only wired up for the ESP8266; the native test env defines
+// LCD_GPIO_FAKE to record the register writes instead (test/host/LcdGpioFake.h).
+// Without either the driver keeps using digitalWrite().
+#define LCD_GPIO_MASK_PINS 16
+
+#if defined(LCD_GPIO_FAKE)
+
+#include "LcdGpioFake.h"
+
+#define LCD_GPIO_MASKS
+
+#elif defined(ESP8266)
+
+#include "Arduino.h"
+
+#define LCD_GPIO_MASKS
+inline void lcdGpioSet(uint32_t mask) { GPOS = mask; }
+inline void lcdGpioClear(uint32_t mask) { GPOC = mask; }
+inline void lcdGpioOutput(uint32_t mask) { GPES = mask; }
+inline void lcdGpioInput(uint32_t mask) { GPEC = mask; }
+inline uint32_t lcdGpioRead() { return GPI; }
+
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef LedEffects_h
+#define LedEffects_h
+
+#include <inttypes.h>
+#include "LedFrame.h"
+
+#define DEFAULT_EFFECT_PERIOD 2000 //ms
+#define MIN_EFFECT_PERIOD 100 //ms
+
+enum LedEffect
+{
+  EffectNone,
+  EffectFade, //crossfade from the previous color, once
+  EffectBreathe,
+  EffectChase,
+  EffectComet,
+  EffectProgress, //bar grows to progress percent, once
+  EffectCount,
+};
+
+struct LedEffectParams
+{
+  LedEffect effect;
+  uint16_t period; //ms for one cycle, or for the whole fade/fill
+  bool eased; //smoothstep instead of linear
+  uint8_t progress; //percent, for EffectProgress
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+  uint8_t brightness;
+  uint8_t fromRed; //where EffectFade starts
+  uint8_t fromGreen;
+  uint8_t fromBlue;
+};
+
+//Returns EffectCount if the name isn't known. Names are case-insensitive.
+LedEffect getLedEffect(const char * name, uint16_t len);
+const char * getLedEffectName(LedEffect effect);
+
+//Draws the effect as it looks elapsed ms after it started into count LEDs starting at first.
+//All integer math and nothing allocated, so it can run every tick.
+void renderLedEffect(const LedEffectParams &params, uint32_t elapsed, LedFrame &frame, uint8_t first, uint8_t count);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef LedFrame_h
+#define LedFrame_h
+
+#include <inttypes.h>
+
+#define LED_COUNT   24
+#define LED_START_BYTE 0xE0 //first byte of the 32 bits for each APA102c LED. Needs to start with 0b111xxxxx where xxxxx is the brightness
+#define LED_SOF_LEN 4 //APA 102c start of frame: 0x00000000
+#define LED_EOF_LEN 2 //APA 102c end of frame: 0xFF00
+#define LED_FRAME_LEN (LED_SOF_LEN + LED_COUNT * 4 + LED_EOF_LEN)
+#define LED_FULL_BRIGHTNESS 255
+
+//Holds the color of every LED plus the complete APA102c byte stream for them (start frame, one
+//brightness/blue/green/red word per LED, end frame). The stream is only rebuilt when a pixel has
+//changed and goes out in a single SPI burst.
+//
+//Colors and brightness are 0-255 and perceptual. When the stream is rebuilt they are gamma corrected
+//and split between the 5-bit global current and the 8-bit PWM of each LED, keeping the PWM as high
+//as possible so dim colors still get fine steps.
+class LedFrame
+{
+  public:
+    LedFrame();
+
+    void setPixel(uint8_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t brightness = LED_FULL_BRIGHTNESS);
+    void getPixel(uint8_t index, uint8_t &red, uint8_t &green, uint8_t &blue);
+    //Sets the first count LEDs to the color and turns the rest off
+    void fill(uint8_t red, uint8_t green, uint8_t blue, uint8_t brightness, uint8_t count = LED_COUNT);
+    void clear();
+
+    //Scales every pixel's brightness
+    void setBrightness(uint8_t brightness);
+    uint8_t getBrightness() { return _brightness; }
+
+    //Sends the frame, as one SPI transfer, if anything changed since the last show (or always when forced).
+    //Returns true if it was sent.
+    bool show(bool force = false);
+
+    bool isDirty() { return _dirty; }
+    const uint8_t * data() { return _stream; }
+    uint32_t framesSent() { return _framesSent; }
+
+  private:
+    void rebuild();
+
+    uint8_t _pixels[LED_COUNT][4]; //brightness, blue, green, red in wire order
+    uint8_t _stream[LED_FRAME_LEN];
+    uint8_t _brightness;
+    bool _dirty;
+    uint32_t _framesSent;
+};
+
+#endif
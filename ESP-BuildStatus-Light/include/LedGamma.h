@@ -0,0 +1,66 @@
+#ifndef LedGamma_h
+#define LedGamma_h
+
+#include <inttypes.h>
+
+//Lookup tables for LedFrame, generated by the compiler so there is nothing to build at boot.
+//
+//kLedGamma maps an 8-bit color value to linear light on a 0-65535 scale using a gamma of 2.5
+//(x^2 * sqrt(x), all integer so it stays constexpr).
+//
+//kLedPwmScale takes that linear light to an 8-bit PWM value once the APA102c's 5-bit global
+//current is known: 65535 is full current (31) times full PWM (255), so
+//pwm = light * 31 / (global * 257), stored as a 16.16 multiplier per global level.
+
+#define LED_GLOBAL_MAX 31
+
+constexpr uint32_t ledIsqrt(uint32_t n, uint32_t lo, uint32_t hi)
+{
+  return lo == hi ? lo
+    : ((uint64_t)((lo + hi + 1) / 2) * ((lo + hi + 1) / 2) <= n ? ledIsqrt(n, (lo + hi + 1) / 2, hi) : ledIsqrt(n, lo, (lo + hi + 1) / 2 - 1));
+}
+
+//x^2.5 scaled by 256 (the sqrt is taken in 8.8 fixed point)
+constexpr uint64_t ledGammaRaw(uint32_t x)
+{
+  return (uint64_t)x * x * ledIsqrt(x << 16, 0, 1 << 12);
+}
+
+constexpr uint16_t ledGamma16(uint32_t x)
+{
+  return (ledGammaRaw(x) * 65535 + ledGammaRaw(255) / 2) / ledGammaRaw(255);
+}
+
+struct LedGammaTable
+{
+  uint16_t values[256];
+
+  constexpr LedGammaTable() : values()
+  {
+    for (uint16_t i = 0; i < 256; i++)
+    {
+      values[i] = ledGamma16(i);
+    }
+  }
+};
+
+struct LedPwmScaleTable
+{
+  uint16_t values[LED_GLOBAL_MAX + 1];
+
+  constexpr LedPwmScaleTable() : values()
+  {
+    for (uint32_t global = 1; global <= LED_GLOBAL_MAX; global++)
+    {
+      values[global] = (LED_GLOBAL_MAX * 65536UL + global * 257 / 2) / (global * 257);
+    }
+  }
+};
+
+static constexpr LedGammaTable kLedGamma;
+static constexpr LedPwmScaleTable kLedPwmScale;
+
+static_assert(kLedGamma.values[0] == 0 && kLedGamma.values[255] == 65535, "gamma table must span the full range");
+static_assert(kLedPwmScale.values[LED_GLOBAL_MAX] == 255, "full current must map straight to 8-bit PWM");
+
+#endif
@@ -42,6 +42,16 @@
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS 0x00
 
+// display data RAM size and shadow bookkeeping
+#define LCD_DDRAM_SIZE 80
+#define LCD_ADDRESS_CGRAM 0xFE
+#define LCD_ADDRESS_UNKNOWN 0xFF
+
+// async command queue and settle times
+#define LCD_QUEUE_SIZE 128 // a power of two, no more than 128
+#define LCD_SETTLE_US 100 // commands need > 37us to settle
+#define LCD_SLOW_SETTLE_US 2000 // clear and home take a long time
+
 class LiquidCrystal : public Print {
 public:
   LiquidCrystal(uint8_t rs, uint8_t enable,
@@ -82,10 +92,47 @@ public:
   void setCursor(uint8_t, uint8_t); 
   virtual size_t write(uint8_t);
   void command(uint8_t);
+
+  // When buffered, clear/home/setCursor/write draw into a RAM shadow of
+  // DDRAM and flush() sends only the cells that differ from the panel.
+  void setBuffered(bool);
+  virtual void flush();
+
+  // Every byte sent to the controller counts as one bus transaction.
+  uint32_t busTransactions() { return _busTransactions; }
+  uint16_t lastFlushTransactions() { return _lastFlushTransactions; }
+
+  // When async, bytes are queued instead of sent and pump() puts at most
+  // one of them on the bus per call, once the previous one has settled.
+  void setAsync(bool);
+  bool pump();
+  uint8_t queued() { return _queueCount; }
+
+  // With an RW pin wired the busy flag is polled after begin() so a byte
+  // goes out as soon as the controller is done with the last one. The
+  // timed settle delays remain as the upper bound either way.
+  void setBusyPolling(bool);
+  uint8_t readStatus();
+
+  // Draws a whole page of rows x cols characters stored row after row.
+  // Returns false and draws nothing when the panel already shows that
+  // page, going by the _ddram mirror, and the shadow matches it, unless
+  // forced.
+  bool drawPage(const char *page, uint8_t cols, uint8_t rows, bool force = false);
   
   using Print::write;
 private:
   void send(uint8_t, uint8_t);
+  void transmit(uint16_t);
+  void waitReady();
+  bool isReady();
+  uint8_t readBus();
+  void buildNibbleMasks();
+  void trackCommand(uint8_t);
+  void trackData(uint8_t);
+  uint8_t stepAddress(uint8_t);
+  uint8_t addressToIndex(uint8_t);
+  uint8_t indexToAddress(uint8_t);
   void write4bits(uint8_t);
   void write8bits(uint8_t);
   void pulseEnable();
@@ -103,6 +150,31 @@ private:
 
   uint8_t _numlines;
   uint8_t _row_offsets[4];
+
+  uint8_t _buffered;
+  uint8_t _shadow[LCD_DDRAM_SIZE]; // what has been drawn, indexed like DDRAM
+  uint8_t _ddram[LCD_DDRAM_SIZE];  // what the panel is known to show
+  uint8_t _ddramValid;
+  uint8_t _shadowAddress; // draw position inside _shadow
+  uint8_t _address; // the controller's address counter as far as we know
+
+  uint8_t _async;
+  uint16_t _queue[LCD_QUEUE_SIZE]; // value in the low byte, RS level in bit 8
+  uint8_t _queueHead;
+  uint8_t _queueCount;
+  uint32_t _readyAt; // micros() when the controller can take the next byte
+  uint8_t _busyPolling;
+
+  // GPIO masks for each 4-bit value, set up once in init()
+  uint8_t _maskedBus;
+  uint32_t _nibbleSet[16];
+  uint32_t _nibbleClear[16];
+  uint32_t _dataMask;
+  uint32_t _enableMask;
+  uint8_t _rsLevel; // last level written to RS, 255 when unknown
+
+  uint32_t _busTransactions;
+  uint16_t _lastFlushTransactions;
 };
 
 #endif
\ No newline at end of file
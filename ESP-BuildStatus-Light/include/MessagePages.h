@@ -0,0 +1,52 @@
+#ifndef MessagePages_h
+#define MessagePages_h
+
+#include <inttypes.h>
+
+#define MESSAGE_COLS 20 //the LCD's size
+#define MESSAGE_PAGE_ROWS 4
+#define MAX_MESSAGE_LEN 240 //characters
+#define MAX_MESSAGE_LINES 40 //wrapping a full message takes about 22 lines at most
+#define MESSAGE_ROWS (MAX_MESSAGE_LINES + MESSAGE_PAGE_ROWS - 1) //blank rows after the last line so every page is a full MESSAGE_PAGE_ROWS
+
+//A wrapped line of the message, as a span of the text
+struct MessageLine
+{
+  uint8_t offset;
+  uint8_t len;
+};
+
+//Keeps the LCD message in one fixed buffer, word wrapped into lines that are spans of it, and renders every line
+//padded to MESSAGE_COLS once, so page n is just the MESSAGE_PAGE_ROWS rows starting at row n. Setting a new
+//message rewraps in place and never allocates.
+class MessagePages
+{
+public:
+  MessagePages();
+
+  //Copies the message, capped at MAX_MESSAGE_LEN, and rewraps it
+  void set(const char * message, uint16_t len);
+
+  const char * text() { return _text; }
+  uint16_t length() { return _length; }
+  uint8_t lineCount() { return _lineCount; }
+  const MessageLine & line(uint8_t index) { return _lines[index]; }
+
+  //Longer messages scroll a line at a time until the last line reaches the top. Shorter ones are a single page,
+  //an empty message has none.
+  uint8_t pageCount() { return _pageCount; }
+  const char * page(uint8_t index) { return _rows[index]; }
+
+private:
+  void wrap();
+  void render();
+
+  char _text[MAX_MESSAGE_LEN + 1];
+  uint16_t _length;
+  MessageLine _lines[MAX_MESSAGE_LINES];
+  uint8_t _lineCount;
+  char _rows[MESSAGE_ROWS][MESSAGE_COLS];
+  uint8_t _pageCount;
+};
+
+#endif
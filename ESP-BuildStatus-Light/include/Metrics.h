@@ -0,0 +1,32 @@
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <inttypes.h>
+#include <Print.h>
+
+//Prometheus text format helpers. Every metric is a fixed counter somewhere, these only print them.
+
+#define METRICS_PREFIX "buildlight_"
+#define DURATION_BUCKETS 8
+
+//Upper bounds of the duration buckets in uS, the last bucket is everything above
+static const uint32_t kDurationBuckets[DURATION_BUCKETS - 1] = { 100, 250, 500, 1000, 2500, 5000, 10000 };
+
+struct DurationHistogram
+{
+  uint32_t counts[DURATION_BUCKETS]; //not cumulative, printHistogram adds them up
+  uint32_t count;
+  uint64_t sum; //uS
+};
+
+void recordDuration(DurationHistogram &histogram, uint32_t duration);
+
+//Prints the # TYPE line for a metric, type is "gauge", "counter" or "histogram"
+void printMetricType(Print &out, const char * name, const char * type);
+void printMetric(Print &out, const char * name, const char * type, int32_t value);
+void printMetric(Print &out, const char * name, const char * type, uint32_t value);
+//One sample of a labelled metric, without the # TYPE line
+void printLabelledMetric(Print &out, const char * name, const char * label, const char * labelValue, uint32_t value);
+void printHistogram(Print &out, const char * name, const DurationHistogram &histogram);
+
+#endif
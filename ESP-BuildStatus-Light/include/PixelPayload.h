@@ -0,0 +1,19 @@
+#ifndef PixelPayload_h
+#define PixelPayload_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "LedFrame.h"
+
+#define PIXEL_PAYLOAD_RGB_LEN (LED_COUNT * 3)
+#define PIXEL_PAYLOAD_RGBB_LEN (LED_COUNT * 4) //RGB + brightness
+
+//A pixel payload is LED_COUNT pixels of red, green, blue and optionally a brightness byte, sent raw or base64
+//encoded. Either base64 alphabet is accepted, '=' padding and line breaks are skipped and a space is taken as '+'
+//since that is what an unescaped '+' turns into in a query string. Base64 must decode to whole bytes: a lone
+//trailing character or non-zero leftover bits mean the payload was cut or mangled and it is rejected.
+
+//Decodes the payload into the frame. Nothing is changed if the payload is the wrong size or not valid base64.
+bool setPixelsFromPayload(LedFrame &frame, const char * data, size_t len, bool base64);
+
+#endif
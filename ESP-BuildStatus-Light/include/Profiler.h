@@ -0,0 +1,100 @@
+#ifndef Profiler_h
+#define Profiler_h
+
+#include <inttypes.h>
+#include <Print.h>
+
+//Span profiler for the hot paths. Build with -DPROFILING to turn it on. Without it every PROFILE_ macro
+//is empty and none of the profiler is compiled in, so the macros can stay in production code.
+
+#define PROFILE_SPAN_COUNT 48
+#define PROFILE_RING_SIZE 256 //samples kept for the p99, must be a power of two
+
+enum ProfileSpan
+{
+  SpanTick,
+  SpanScroll,
+  SpanShowColor,
+  SpanWrapMessage,
+  SpanLcdFlush,
+  SpanCommands, //first of one span per command table row
+};
+
+#ifdef PROFILING
+
+#if defined(ESP8266)
+
+#include "Arduino.h"
+
+inline uint32_t profileCycles() { return ESP.getCycleCount(); }
+inline uint32_t profileCyclesPerMicro() { return ESP.getCpuFreqMHz(); }
+
+#else
+
+#include <chrono>
+
+//Host builds count nanoseconds instead of cycles
+inline uint32_t profileCycles() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+inline uint32_t profileCyclesPerMicro() { return 1000; }
+
+#endif
+
+struct ProfileSample
+{
+  uint32_t cycles;
+  uint8_t span;
+};
+
+class Profiler
+{
+public:
+  Profiler();
+
+  //Only one writer, the loop, so the ring needs no locking. The head moves after the sample is written.
+  void record(uint8_t span, const char * name, uint32_t cycles);
+  void reset();
+  //count, min, avg, p99 and max per span in uS. The p99 only covers the samples still in the ring.
+  void print(Print &out);
+
+private:
+  ProfileSample _ring[PROFILE_RING_SIZE];
+  uint16_t _head; //next sample to write, wraps at PROFILE_RING_SIZE
+  uint16_t _ringCount; //samples in the ring, stops at PROFILE_RING_SIZE
+  const char * _names[PROFILE_SPAN_COUNT];
+  uint32_t _counts[PROFILE_SPAN_COUNT];
+  uint32_t _min[PROFILE_SPAN_COUNT];
+  uint32_t _max[PROFILE_SPAN_COUNT];
+  uint64_t _total[PROFILE_SPAN_COUNT];
+  uint32_t _scratch[PROFILE_RING_SIZE];
+};
+
+extern Profiler _profiler;
+
+//Records the cycles from construction to the end of the scope
+class ProfileScope
+{
+public:
+  ProfileScope(uint8_t span, const char * name) : _span(span), _name(name), _start(profileCycles()) {}
+  ~ProfileScope() { _profiler.record(_span, _name, profileCycles() - _start); }
+
+private:
+  uint8_t _span;
+  const char * _name;
+  uint32_t _start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(span, name) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(span, name)
+#define PROFILE_PRINT(out) _profiler.print(out)
+#define PROFILE_RESET() _profiler.reset()
+
+#else
+
+#define PROFILE_SCOPE(span, name)
+#define PROFILE_PRINT(out) (out).println("Profiling is not compiled in, build with -DPROFILING.")
+#define PROFILE_RESET()
+
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <inttypes.h>
+
+#define MAX_SCHEDULER_TASKS 8
+
+typedef void (*TaskFunction)();
+typedef unsigned long (*SchedulerClock)(); //micros() on the device, anything monotonic on a host
+
+struct SchedulerTask
+{
+  const char * name;
+  TaskFunction function;
+  uint32_t period; //us between deadlines
+  uint32_t budget; //us a run may take before it counts as an overrun
+  uint32_t deadline; //clock time the next run is due
+
+  uint32_t runs;
+  uint32_t overruns; //runs that went over budget
+  uint32_t skipped; //deadlines dropped because the task fell a whole period behind
+  uint32_t maxDuration;
+  uint32_t minLatency;
+  uint32_t maxLatency; //how late after its deadline a run started
+  uint64_t totalLatency;
+
+  //How much the start latency moves about, max - min since the stats were reset
+  uint32_t jitter() const { return runs ? maxLatency - minLatency : 0; }
+};
+
+//Cooperative earliest-deadline-first scheduler driven from loop(). Each call to run() starts at most
+//one task, so the network stack gets serviced between tasks. Time is always passed in (or read
+//through the clock given to the constructor) so the same code can be replayed against virtual time.
+class Scheduler
+{
+  public:
+    Scheduler(SchedulerClock clock);
+
+    //Returns the task's index or -1 if the table is full
+    int8_t addTask(const char * name, TaskFunction function, uint32_t period, uint32_t budget);
+
+    //Runs the most overdue task, if any are due. Returns true if one ran.
+    bool run(uint32_t now);
+
+    uint8_t getTaskCount() { return _taskCount; }
+    const SchedulerTask & getTask(uint8_t index) { return _tasks[index]; }
+    void resetStats();
+
+  private:
+    SchedulerClock _clock;
+    SchedulerTask _tasks[MAX_SCHEDULER_TASKS];
+    uint8_t _taskCount;
+};
+
+#endif
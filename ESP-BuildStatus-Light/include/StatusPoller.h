@@ -0,0 +1,117 @@
+#ifndef StatusPoller_h
+#define StatusPoller_h
+
+#include <inttypes.h>
+#include <WiFiClient.h>
+#include <lwip/dns.h>
+#include "JsonScanner.h"
+
+#define POLL_URL_SIZE 128
+#define POLL_HOST_SIZE 64
+#define POLL_FIELD_SIZE 40 //longest field path
+#define POLL_ETAG_SIZE 72
+#define POLL_LINE_SIZE 96 //longer header lines are cut short, which only matters for ETag
+#define POLL_READ_SIZE 128 //bytes handled per poll() call
+#define POLL_CONNECT_TIMEOUT 250 //ms, the one wait in poll(). Only an unreachable server takes it all.
+#define POLL_TIMEOUT 5000 //ms for the lookup, and again for the whole response
+#define POLL_MIN_INTERVAL 5 //seconds
+#define POLL_MAX_INTERVAL 86400 //seconds, longer ones are cut to this
+
+enum PollField
+{
+  PollStatus,
+  PollBranch,
+  PollAuthor,
+  PollFieldCount
+};
+
+enum PollResult
+{
+  PollChanged,
+  PollNotModified,
+  PollFailed,
+  PollResultCount
+};
+
+//Called with the scanner once a changed document with a status has been read, the values are only good until the next poll
+typedef void (*PollHandler)(JsonScanner &scanner);
+
+//Fetches a JSON status document over plain HTTP every interval and hands the configured fields to the handler.
+//Sends If-None-Match with the last ETag, so an unchanged document costs one short 304. The body is scanned as it
+//arrives and is never held in memory. Everything is fixed size and poll() only handles what has already arrived.
+//
+//The host is looked up once, without waiting, and again only after a connect to it fails. WiFiClient can only
+//connect by waiting for it, so that is the one wait left: a round trip to the server, at most POLL_CONNECT_TIMEOUT.
+//It happens once per interval, in the poll() that starts the request. That call goes over the poll task's budget
+//and the scheduler counts it as one of the task's overruns, getMaxConnectWait() has the longest wait.
+//
+//Requests are HTTP/1.0 so servers reply with a plain body ending when the connection closes, never chunked.
+class StatusPoller
+{
+public:
+  StatusPoller(PollHandler handler);
+
+  //http://host[:port]/path, returns false if it isn't one. An interval of 0 stops polling, others are kept
+  //between POLL_MIN_INTERVAL and POLL_MAX_INTERVAL.
+  bool configure(const char * url, uint16_t urlLen, uint32_t interval);
+  //Dotted JSON paths, see JsonScanner. Returns false if it's too long.
+  bool setField(PollField field, const char * path, uint16_t len);
+
+  //Call often, it starts a poll when one is due and otherwise reads whatever has arrived
+  void poll(uint32_t now);
+
+  const char * getUrl() { return _url; }
+  uint32_t getInterval() { return _interval; }
+  const char * getField(PollField field) { return _fields[field]; }
+  uint32_t getCount(PollResult result) { return _counts[result]; }
+  int getLastStatusCode() { return _lastStatusCode; }
+  //ms, the longest a connect has held up poll()
+  uint32_t getMaxConnectWait() { return _maxConnectWait; }
+
+private:
+  enum State
+  {
+    PollIdle,
+    PollResolving,
+    PollStatusLine,
+    PollHeaders,
+    PollBody,
+  };
+
+  void start(uint32_t now);
+  void connect(uint32_t now);
+  void fail();
+  void complete();
+  void finish(PollResult result);
+  void handleLine();
+  static void onResolved(const char * name, const ip_addr_t * address, void * arg);
+
+  PollHandler _handler;
+  WiFiClient _client;
+  JsonScanner _scanner;
+  State _state;
+  char _url[POLL_URL_SIZE];
+  char _host[POLL_HOST_SIZE];
+  const char * _path; //points into _url
+  uint16_t _port;
+  uint32_t _address; //of _host once it's been looked up, 0 until then
+  volatile bool _resolved; //set from lwIP's callback, with _address 0 if the lookup failed
+  uint32_t _interval; //seconds
+  uint32_t _lastPoll;
+  uint32_t _startedAt;
+  bool _due;
+  char _fields[PollFieldCount][POLL_FIELD_SIZE];
+  const char * _fieldPaths[PollFieldCount];
+  char _etag[POLL_ETAG_SIZE];
+  char _newEtag[POLL_ETAG_SIZE];
+  char _line[POLL_LINE_SIZE];
+  uint8_t _lineLen;
+  int _statusCode;
+  int _lastStatusCode;
+  uint32_t _maxConnectWait;
+  uint32_t _counts[PollResultCount];
+};
+
+const char * getPollResultName(PollResult result);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TokenTable_h
+#define TokenTable_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define TOKEN_CAPACITY 256
+#define TOKEN_DIGEST_SIZE 16 //first 16 bytes of SHA-256, the same as a control key
+#define TOKEN_SLOTS 512 //a power of two, twice TOKEN_CAPACITY so probes stay short
+
+//Entries are numbered 0 to TOKEN_CAPACITY - 1. Plain data, so it can be kept in flash as is.
+struct TokenEntries
+{
+  uint8_t used[TOKEN_CAPACITY / 8]; //bit per entry
+  uint8_t digests[TOKEN_CAPACITY][TOKEN_DIGEST_SIZE];
+};
+
+//User Ids kept as fixed size digests in numbered entries, with an open addressed hash table over them so a lookup
+//is one SHA-256 and usually a single compare however many are set. The plain User Id is never stored.
+//The entries belong to the caller, the table only adds the slots.
+//
+//Digests are compared in constant time, the slot a digest lands in only depends on the digest, so timing can't be used
+//to guess a User Id a byte at a time.
+class TokenTable
+{
+public:
+  TokenTable(TokenEntries &entries);
+
+  static void hashToken(const char * token, size_t len, uint8_t digest[TOKEN_DIGEST_SIZE]);
+
+  void clear();
+  //Lays out the slots again after the entries were filled in directly, like when loaded from flash
+  void load();
+  //Replaces whatever the entry held, returns false if the index is out of range
+  bool set(uint16_t index, const uint8_t digest[TOKEN_DIGEST_SIZE]);
+  void remove(uint16_t index);
+
+  //Returns the entry index, or -1 if the User Id isn't set
+  int find(const char * token, size_t len);
+  int findDigest(const uint8_t digest[TOKEN_DIGEST_SIZE]);
+
+  bool has(uint16_t index) { return index < TOKEN_CAPACITY && (_entries.used[index / 8] & (1 << (index % 8))); }
+  //Only meaningful if has(index)
+  const uint8_t * getDigest(uint16_t index) { return _entries.digests[index]; }
+  uint16_t getCount() { return _count; }
+
+private:
+  uint16_t getHome(const uint8_t digest[TOKEN_DIGEST_SIZE]);
+  void insert(uint16_t index);
+  void rebuild();
+
+  TokenEntries &_entries;
+  uint16_t _slots[TOKEN_SLOTS]; //entry index + 1, 0 for an empty slot
+  uint16_t _count;
+};
+
+#endif
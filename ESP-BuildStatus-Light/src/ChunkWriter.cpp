@@ -0,0 +1,49 @@
+#include "ChunkWriter.h"
+
+#include <string.h>
+
+ChunkWriter::ChunkWriter(char * buffer, size_t size, Print * target)
+{
+  _buffer = buffer;
+  _size = size;
+  _used = 0;
+  _total = 0;
+  _target = target;
+}
+
+size_t ChunkWriter::write(uint8_t value)
+{
+  return write(&value, 1);
+}
+
+size_t ChunkWriter::write(const uint8_t * data, size_t len)
+{
+  size_t left = len;
+
+  while (left && _used < _size)
+  {
+    size_t count = _size - _used < left ? _size - _used : left;
+
+    memcpy(_buffer + _used, data, count);
+    _used += count;
+    data += count;
+    left -= count;
+
+    if (_used == _size && _target)
+    {
+      flush();
+    }
+  }
+
+  _total += len;
+  return len;
+}
+
+void ChunkWriter::flush()
+{
+  if (_used && _target)
+  {
+    _target->write((const uint8_t *)_buffer, _used);
+    _used = 0;
+  }
+}
@@ -0,0 +1,164 @@
+#include "CommandArgs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char * const _keyNames[CommandKeyCount] = { "SSID", "PW", "USEDHCP", "IP", "SUBNET", "GATEWAY", "INDEX", "ID",
+  "RED", "GREEN", "BLUE", "FLASHTIME", "DISPLAYTIME", "EFFECT", "PERIOD", "EASE", "PROGRESS", "BRIGHTNESS", "MESSAGE", "LEVEL",
+  "USERID", "DATA", "ENCODING", "PLAIN", "RESET", "ZONE", "ZONES",
+  "URL", "INTERVAL", "STATUSFIELD", "BRANCHFIELD", "AUTHORFIELD" };
+
+#define MAX_INT_DIGITS 11 //sign and 10 digits
+
+CommandKey getCommandKey(const char * name, uint16_t len)
+{
+  for (uint8_t i = 0; i < CommandKeyCount; i++)
+  {
+    if (strlen(_keyNames[i]) == len && strncasecmp(_keyNames[i], name, len) == 0)
+    {
+      return (CommandKey)i;
+    }
+  }
+
+  return CommandKeyCount;
+}
+
+const char * getCommandKeyName(CommandKey key)
+{
+  return key < CommandKeyCount ? _keyNames[key] : "unknown";
+}
+
+CommandArgs::CommandArgs()
+{
+  clear();
+}
+
+void CommandArgs::clear()
+{
+  memset(_values, 0, sizeof(_values));
+  memset(_lengths, 0, sizeof(_lengths));
+}
+
+uint8_t CommandArgs::parse(const char * input, uint16_t len)
+{
+  const char * end = input + len;
+  const char * p = input;
+  const char * key;
+  const char * value;
+  const char * valueEnd;
+  CommandKey id;
+  uint8_t found = 0;
+
+  clear();
+
+  while (p < end)
+  {
+    //Skip separators, then the key runs up to the =
+    while (p < end && (*p == ' ' || *p == ';'))
+    {
+      p++;
+    }
+
+    key = p;
+
+    while (p < end && *p != '=' && *p != ';' && *p != ' ')
+    {
+      p++;
+    }
+
+    //Not a key, most likely the command itself
+    if (p == end || *p != '=')
+    {
+      continue;
+    }
+
+    //The value runs up to the next ;, which means values can hold spaces and = but never ;
+    value = p + 1;
+    valueEnd = (const char *)memchr(value, ';', end - value);
+
+    if (valueEnd == NULL)
+    {
+      break;
+    }
+
+    id = getCommandKey(key, p - key);
+
+    if (set(id, value, valueEnd - value))
+    {
+      found++;
+    }
+
+    p = valueEnd + 1;
+  }
+
+  return found;
+}
+
+bool CommandArgs::set(CommandKey key, const char * value, uint16_t len)
+{
+  if (key >= CommandKeyCount || _values[key] != NULL || len == 0)
+  {
+    return false;
+  }
+
+  _values[key] = value;
+  _lengths[key] = len;
+  return true;
+}
+
+bool CommandArgs::has(CommandKey key) const
+{
+  return key < CommandKeyCount && _values[key] != NULL;
+}
+
+const char * CommandArgs::get(CommandKey key, uint16_t &len) const
+{
+  if (!has(key))
+  {
+    len = 0;
+    return NULL;
+  }
+
+  len = _lengths[key];
+  return _values[key];
+}
+
+long CommandArgs::getInt(CommandKey key) const
+{
+  char number[MAX_INT_DIGITS + 1];
+  uint16_t len;
+  const char * value = get(key, len);
+
+  if (value == NULL || len > MAX_INT_DIGITS)
+  {
+    return 0;
+  }
+
+  memcpy(number, value, len);
+  number[len] = '\0';
+
+  return strtol(number, NULL, 10);
+}
+
+bool CommandArgs::equalsIgnoreCase(CommandKey key, const char * expected) const
+{
+  uint16_t len;
+  const char * value = get(key, len);
+
+  return value != NULL && strlen(expected) == len && strncasecmp(value, expected, len) == 0;
+}
+
+String CommandArgs::getString(CommandKey key) const
+{
+  String result;
+  uint16_t len;
+  const char * value = get(key, len);
+
+  if (value != NULL)
+  {
+    result.concat(value, len);
+  }
+
+  return result;
+}
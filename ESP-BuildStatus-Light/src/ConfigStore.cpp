@@ -0,0 +1,100 @@
+#include "ConfigStore.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <coredecls.h>
+#include <FS.h>
+
+static uint32_t getCrc(const ConfigHeader &header, const void * data, uint16_t size)
+{
+  return crc32(data, size, crc32(&header, offsetof(ConfigHeader, crc)));
+}
+
+ConfigStore::ConfigStore(const char * pathA, const char * pathB, uint16_t version)
+{
+  _paths[0] = pathA;
+  _paths[1] = pathB;
+  _version = version;
+  _sequence = 0;
+  //Nothing loaded yet, so the first save goes to A
+  _current = 1;
+}
+
+bool ConfigStore::load(void * data, uint16_t size)
+{
+  File files[2];
+  ConfigHeader headers[2];
+  bool usable[2];
+  uint8_t newest;
+  bool loaded = false;
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    files[i] = SPIFFS.open(_paths[i], "r");
+    //A longer record is from newer firmware and can't be trusted to mean the same thing
+    usable[i] = files[i] && files[i].read((uint8_t *)&headers[i], sizeof(ConfigHeader)) == sizeof(ConfigHeader) &&
+      headers[i].magic == CONFIG_MAGIC && headers[i].version == _version && headers[i].size <= size;
+  }
+
+  //Sequences can wrap, what counts is which one is ahead
+  newest = usable[1] && (!usable[0] || (int32_t)(headers[1].sequence - headers[0].sequence) > 0);
+
+  for (uint8_t i = 0; i < 2 && !loaded; i++)
+  {
+    uint8_t copy = newest ^ i;
+
+    if (usable[copy] && files[copy].read((uint8_t *)data, headers[copy].size) == headers[copy].size &&
+      getCrc(headers[copy], data, headers[copy].size) == headers[copy].crc)
+    {
+      memset((uint8_t *)data + headers[copy].size, 0, size - headers[copy].size);
+      _current = copy;
+      _sequence = headers[copy].sequence;
+      loaded = true;
+    }
+  }
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    if (files[i])
+    {
+      files[i].close();
+    }
+  }
+
+  if (!loaded)
+  {
+    memset(data, 0, size);
+  }
+
+  return loaded;
+}
+
+bool ConfigStore::save(const void * data, uint16_t size)
+{
+  uint8_t copy = _current ^ 1;
+  ConfigHeader header = { CONFIG_MAGIC, _version, size, _sequence + 1, 0 };
+  File f;
+  bool written;
+
+  header.crc = getCrc(header, data, size);
+  f = SPIFFS.open(_paths[copy], "w+");
+
+  if (!f)
+  {
+    return false;
+  }
+
+  written = f.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+    f.write((const uint8_t *)data, size) == size;
+  f.close();
+
+  if (!written)
+  {
+    return false;
+  }
+
+  _current = copy;
+  _sequence = header.sequence;
+
+  return true;
+}
@@ -0,0 +1,173 @@
+#include "ControlProtocol.h"
+
+#include <string.h>
+#include <bearssl/bearssl.h>
+
+static const char _keyLabel[] = "udp";
+
+static void writeUint32(uint8_t * data, uint32_t value)
+{
+  data[0] = value;
+  data[1] = value >> 8;
+  data[2] = value >> 16;
+  data[3] = value >> 24;
+}
+
+uint32_t readControlUint32(const uint8_t * data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+uint16_t readControlUint16(const uint8_t * data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+static void getControlMac(const uint8_t * data, size_t len, const uint8_t key[CONTROL_KEY_SIZE], uint8_t mac[32])
+{
+  br_hmac_key_context keyContext;
+  br_hmac_context context;
+
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, CONTROL_KEY_SIZE);
+  br_hmac_init(&context, &keyContext, 0);
+  br_hmac_update(&context, data, len);
+  br_hmac_out(&context, mac);
+}
+
+void getControlKey(const char * token, size_t len, uint8_t key[CONTROL_KEY_SIZE])
+{
+  br_sha256_context context;
+  uint8_t hash[32];
+
+  br_sha256_init(&context);
+  br_sha256_update(&context, token, len);
+  br_sha256_out(&context, hash);
+  deriveControlKey(hash, key);
+}
+
+//A separate key for frames, so the digest that checks HTTP User Ids never keys a MAC that goes on the wire
+void deriveControlKey(const uint8_t digest[CONTROL_KEY_SIZE], uint8_t key[CONTROL_KEY_SIZE])
+{
+  uint8_t mac[32];
+
+  getControlMac((const uint8_t *)_keyLabel, sizeof(_keyLabel) - 1, digest, mac);
+  memcpy(key, mac, CONTROL_KEY_SIZE);
+}
+
+//len is the whole frame, MAC included. Used by senders, the light only checks.
+void signControlFrame(uint8_t * frame, size_t len, const uint8_t key[CONTROL_KEY_SIZE])
+{
+  uint8_t mac[32];
+
+  getControlMac(frame, len - CONTROL_MAC_SIZE, key, mac);
+  memcpy(frame + len - CONTROL_MAC_SIZE, mac, CONTROL_MAC_SIZE);
+}
+
+void buildControlAck(uint32_t sequence, uint32_t bootId, uint8_t result, uint8_t ack[CONTROL_ACK_SIZE])
+{
+  ack[0] = CONTROL_MAGIC_0;
+  ack[1] = CONTROL_MAGIC_1;
+  ack[2] = CONTROL_VERSION;
+  ack[3] = result;
+  writeUint32(ack + 4, sequence);
+  writeUint32(ack + 8, bootId);
+}
+
+const char * getControlResultName(ControlResult result)
+{
+  static const char * const names[ControlResultCount] = { "ok", "bad_frame", "bad_version", "unknown_token", "bad_mac", "stale", "wrong_boot", "bad_payload" };
+
+  return result < ControlResultCount ? names[result] : "";
+}
+
+ControlReceiver::ControlReceiver(ControlKeyLookup lookup)
+{
+  _lookup = lookup;
+  _bootId = 1;
+  _seenTokens = 0;
+  memset(_lastSequence, 0, sizeof(_lastSequence));
+  memset(_counts, 0, sizeof(_counts));
+}
+
+void ControlReceiver::begin(uint32_t bootId)
+{
+  _bootId = bootId ? bootId : 1;
+  _seenTokens = 0;
+}
+
+ControlResult ControlReceiver::receive(const uint8_t * data, size_t len, ControlFrame &frame)
+{
+  uint8_t key[CONTROL_KEY_SIZE];
+  uint8_t mac[32];
+  uint8_t diff = 0;
+  uint8_t bit;
+
+  memset(&frame, 0, sizeof(frame));
+
+  if (len < CONTROL_HEADER_SIZE + CONTROL_MAC_SIZE || data[0] != CONTROL_MAGIC_0 || data[1] != CONTROL_MAGIC_1)
+  {
+    _counts[ControlBadFrame]++;
+    return ControlBadFrame;
+  }
+
+  frame.opcode = data[3];
+  frame.sequence = readControlUint32(data + 4);
+  frame.bootId = readControlUint32(data + 8);
+  frame.tokenId = data[12];
+  frame.zone = data[13];
+  frame.payloadLen = readControlUint16(data + 14);
+  frame.payload = data + CONTROL_HEADER_SIZE;
+
+  if (data[2] != CONTROL_VERSION)
+  {
+    _counts[ControlBadVersion]++;
+    return ControlBadVersion;
+  }
+
+  if (len != (size_t)CONTROL_HEADER_SIZE + frame.payloadLen + CONTROL_MAC_SIZE)
+  {
+    _counts[ControlBadFrame]++;
+    return ControlBadFrame;
+  }
+
+  if (frame.tokenId < 1 || frame.tokenId > CONTROL_TOKEN_COUNT || !_lookup(frame.tokenId, key))
+  {
+    _counts[ControlUnknownToken]++;
+    return ControlUnknownToken;
+  }
+
+  //The boot id isn't secret, the MAC over it is what stops old frames
+  if (frame.bootId != _bootId)
+  {
+    _counts[ControlWrongBoot]++;
+    return ControlWrongBoot;
+  }
+
+  getControlMac(data, CONTROL_HEADER_SIZE + frame.payloadLen, key, mac);
+
+  //Constant time, so the MAC can't be guessed a byte at a time
+  for (uint8_t i = 0; i < CONTROL_MAC_SIZE; i++)
+  {
+    diff |= mac[i] ^ frame.payload[frame.payloadLen + i];
+  }
+
+  if (diff)
+  {
+    _counts[ControlBadMac]++;
+    return ControlBadMac;
+  }
+
+  //Serial number arithmetic, so the sequence can wrap
+  bit = frame.tokenId - 1;
+
+  if ((_seenTokens & (1 << bit)) && (int32_t)(frame.sequence - _lastSequence[bit]) <= 0)
+  {
+    _counts[ControlStale]++;
+    return ControlStale;
+  }
+
+  _seenTokens |= 1 << bit;
+  _lastSequence[bit] = frame.sequence;
+
+  return ControlOk;
+}
@@ -0,0 +1,551 @@
+#include "HttpServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "Arduino.h"
+
+#define FORM_CONTENT_TYPE "application/x-www-form-urlencoded"
+
+static int8_t hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+
+  c |= 0x20;
+
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+
+  return -1;
+}
+
+//Decodes + and %XX in place, returns the decoded length
+static uint16_t urlDecode(char * text, uint16_t len)
+{
+  uint16_t decoded = 0;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    char c = text[i];
+
+    if (c == '+')
+    {
+      c = ' ';
+    }
+    else if (c == '%' && i + 2 < len && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0)
+    {
+      c = (hexValue(text[i + 1]) << 4) | hexValue(text[i + 2]);
+      i += 2;
+    }
+
+    text[decoded++] = c;
+  }
+
+  return decoded;
+}
+
+//Returns the \r of the \r\n that ends the line, or NULL if a stray \r comes first. end points at the blank
+//line's \r\n, so the byte after any \r before it is still in the buffer.
+static char * findLineEnd(char * line, char * end)
+{
+  char * lineEnd = (char *)memchr(line, '\r', end - line);
+
+  if (lineEnd == NULL || lineEnd[1] != '\n' || lineEnd + 2 > end)
+  {
+    return NULL;
+  }
+
+  return lineEnd;
+}
+
+const char * getHttpStatusText(int status)
+{
+  switch (status)
+  {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 501: return "Not Implemented";
+    default: return "Error";
+  }
+}
+
+/********HttpRequest*/
+
+HttpRequest::HttpRequest()
+{
+  _state = Closed;
+  _length = 0;
+  _argCount = 0;
+}
+
+void HttpRequest::open(const WiFiClient &client, uint32_t now)
+{
+  _client = client;
+  _client.setNoDelay(true);
+  //send() only ever writes what there is room for, so the client's own wait should never come into it
+  _client.setTimeout(HTTP_WRITE_BUDGET);
+  _state = ReadingHeaders;
+  _openedAt = now;
+  _replyStartedAt = now;
+  _writeCut = false;
+  _length = 0;
+  _headerEnd = 0;
+  _contentLength = 0;
+  _formBody = false;
+  _method = "";
+  _path = "";
+  _pathLen = 0;
+  _body = 0;
+  _bodyLen = 0;
+  _argCount = 0;
+}
+
+//stop() with no argument waits up to WIFICLIENT_MAX_FLUSH_WAIT_MS (300ms in core 3.x) for the reply to drain.
+//lwIP still sends whatever is queued after the close, so only wait HTTP_CLOSE_WAIT.
+void HttpRequest::close()
+{
+  _client.stop(HTTP_CLOSE_WAIT);
+  _state = Closed;
+}
+
+int HttpRequest::receive()
+{
+  uint16_t scanFrom = _length > 3 ? _length - 3 : 0;
+  int available = _client.available();
+
+  while (available > 0 && _length < HTTP_REQUEST_SIZE)
+  {
+    int count = _client.read((uint8_t *)_buffer + _length, min(available, HTTP_REQUEST_SIZE - _length));
+
+    if (count <= 0)
+    {
+      break;
+    }
+
+    _length += count;
+    available -= count;
+  }
+
+  if (_state == ReadingHeaders)
+  {
+    //Only the new bytes and the 3 before them can hold a blank line we haven't seen
+    for (uint16_t i = scanFrom; i + 3 < _length && !_headerEnd; i++)
+    {
+      if (_buffer[i] == '\r' && _buffer[i + 1] == '\n' && _buffer[i + 2] == '\r' && _buffer[i + 3] == '\n')
+      {
+        _headerEnd = i + 4;
+      }
+    }
+
+    if (!_headerEnd)
+    {
+      return _length == HTTP_REQUEST_SIZE ? 413 : 0;
+    }
+
+    int status = parseHeaders();
+
+    if (status)
+    {
+      return status;
+    }
+
+    if (_contentLength > HTTP_REQUEST_SIZE - _headerEnd)
+    {
+      return 413;
+    }
+
+    _state = ReadingBody;
+  }
+
+  if (_state == ReadingBody && _length - _headerEnd >= _contentLength)
+  {
+    _body = _buffer + _headerEnd;
+    _bodyLen = _contentLength;
+
+    if (_formBody)
+    {
+      parseArgs(_body, _bodyLen);
+      _bodyLen = 0;
+    }
+
+    _state = Complete;
+  }
+
+  return 0;
+}
+
+int HttpRequest::parseHeaders()
+{
+  char * line = _buffer;
+  char * end = _buffer + _headerEnd - 2; //the last header's \r\n is the first half of the blank line
+  char * lineEnd;
+  char * space;
+  char * query;
+
+  //Request line: METHOD target HTTP/1.x
+  lineEnd = findLineEnd(line, end);
+
+  if (lineEnd == NULL)
+  {
+    return 400;
+  }
+
+  space = (char *)memchr(line, ' ', lineEnd - line);
+
+  if (space == NULL)
+  {
+    return 400;
+  }
+
+  *space = '\0';
+  _method = line;
+  line = space + 1;
+  space = (char *)memchr(line, ' ', lineEnd - line);
+
+  if (space == NULL || strncmp(space + 1, "HTTP/1.", 7) != 0)
+  {
+    return 400;
+  }
+
+  *space = '\0';
+  _path = line;
+  query = (char *)memchr(line, '?', space - line);
+
+  if (query)
+  {
+    *query = '\0';
+    parseArgs(query + 1, space - query - 1);
+  }
+
+  _pathLen = urlDecode(line, strlen(line));
+  line[_pathLen] = '\0';
+
+  //Headers, only the body's length and type matter
+  for (line = lineEnd + 2; line < end; line = lineEnd + 2)
+  {
+    lineEnd = findLineEnd(line, end);
+
+    if (lineEnd == NULL)
+    {
+      return 400;
+    }
+
+    *lineEnd = '\0';
+
+    char * colon = strchr(line, ':');
+
+    if (colon == NULL)
+    {
+      continue;
+    }
+
+    char * value = colon + 1;
+
+    while (*value == ' ')
+    {
+      value++;
+    }
+
+    if (colon - line == 14 && strncasecmp(line, "Content-Length", 14) == 0)
+    {
+      _contentLength = min(strtoul(value, NULL, 10), (unsigned long)HTTP_REQUEST_SIZE + 1);
+    }
+    else if (colon - line == 12 && strncasecmp(line, "Content-Type", 12) == 0)
+    {
+      _formBody = strncasecmp(value, FORM_CONTENT_TYPE, strlen(FORM_CONTENT_TYPE)) == 0;
+    }
+    else if (colon - line == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0)
+    {
+      //Chunked bodies aren't supported, clients send a Content-Length for bodies this small
+      return 501;
+    }
+  }
+
+  return 0;
+}
+
+//Splits a=b&c=d into args, decoding and null terminating each name and value in place
+bool HttpRequest::parseArgs(char * start, uint16_t len)
+{
+  char * end = start + len;
+
+  while (start < end)
+  {
+    char * pairEnd = (char *)memchr(start, '&', end - start);
+    char * equals;
+    HttpArg * arg;
+
+    if (pairEnd == NULL)
+    {
+      pairEnd = end;
+    }
+
+    if (pairEnd == start)
+    {
+      start++;
+      continue;
+    }
+
+    if (_argCount == HTTP_MAX_ARGS)
+    {
+      return false;
+    }
+
+    arg = &_args[_argCount++];
+    equals = (char *)memchr(start, '=', pairEnd - start);
+
+    arg->name = start;
+    arg->nameLen = urlDecode(start, (equals ? equals : pairEnd) - start);
+    start[arg->nameLen] = '\0';
+
+    if (equals)
+    {
+      arg->value = equals + 1;
+      arg->valueLen = urlDecode(equals + 1, pairEnd - equals - 1);
+    }
+    else
+    {
+      arg->value = pairEnd;
+      arg->valueLen = 0;
+    }
+
+    ((char *)arg->value)[arg->valueLen] = '\0';
+    start = pairEnd + 1;
+  }
+
+  return true;
+}
+
+const char * HttpRequest::arg(const char * name, uint16_t &len)
+{
+  uint16_t nameLen = strlen(name);
+
+  for (uint8_t i = 0; i < _argCount; i++)
+  {
+    if (_args[i].nameLen == nameLen && memcmp(_args[i].name, name, nameLen) == 0)
+    {
+      len = _args[i].valueLen;
+      return _args[i].value;
+    }
+  }
+
+  len = 0;
+  return NULL;
+}
+
+void HttpRequest::sendHeaders(int status, const char * contentType, int32_t contentLength)
+{
+  char headers[160];
+  size_t len = snprintf(headers, sizeof(headers), "HTTP/1.1 %d %s\r\n", status, getHttpStatusText(status));
+
+  if (contentType && len < sizeof(headers))
+  {
+    len += snprintf(headers + len, sizeof(headers) - len, "Content-Type: %s\r\n", contentType);
+  }
+
+  if (contentLength >= 0 && len < sizeof(headers))
+  {
+    len += snprintf(headers + len, sizeof(headers) - len, "Content-Length: %d\r\n", (int)contentLength);
+  }
+
+  if (len < sizeof(headers))
+  {
+    len += snprintf(headers + len, sizeof(headers) - len, "Connection: close\r\n\r\n");
+  }
+
+  _replyStartedAt = millis();
+  send((const uint8_t *)headers, min(len, sizeof(headers) - 1));
+}
+
+//Only writes what the send buffer has room for. The client's acks are only taken in while loop() yields, so a
+//full buffer is waited on with yield(), but only until the reply has used up HTTP_WRITE_BUDGET. After that
+//the rest of the reply is dropped, so a slow client can't hold everything else up.
+size_t HttpRequest::send(const uint8_t * data, size_t len)
+{
+  size_t written = 0;
+
+  while (written < len && !_writeCut)
+  {
+    size_t room = _client.availableForWrite();
+
+    if (room == 0)
+    {
+      if (millis() - _replyStartedAt >= HTTP_WRITE_BUDGET || !_client.connected())
+      {
+        _writeCut = true;
+      }
+      else
+      {
+        yield();
+      }
+      continue;
+    }
+
+    size_t count = _client.write(data + written, min(room, len - written));
+
+    //Only a connection that has gone away takes nothing when there is room
+    _writeCut = count == 0;
+    written += count;
+  }
+
+  return written;
+}
+
+void HttpRequest::send(int status, const char * contentType, const char * content, size_t len)
+{
+  if (status == 204)
+  {
+    sendHeaders(status, NULL, -1);
+    return;
+  }
+
+  sendHeaders(status, contentType, len);
+
+  if (len)
+  {
+    send((const uint8_t *)content, len);
+  }
+}
+
+void HttpRequest::beginResponse(int status, const char * contentType)
+{
+  sendHeaders(status, contentType, -1);
+}
+
+size_t HttpRequest::write(uint8_t value)
+{
+  return send(&value, 1);
+}
+
+size_t HttpRequest::write(const uint8_t * data, size_t len)
+{
+  return send(data, len);
+}
+
+/********HttpSpillResponse*/
+
+HttpSpillResponse::HttpSpillResponse(HttpRequest &request, const char * contentType) : _request(request)
+{
+  _contentType = contentType;
+  _started = false;
+}
+
+size_t HttpSpillResponse::write(uint8_t value)
+{
+  return write(&value, 1);
+}
+
+size_t HttpSpillResponse::write(const uint8_t * data, size_t len)
+{
+  if (!_started)
+  {
+    _request.beginResponse(200, _contentType);
+    _started = true;
+  }
+
+  return _request.write(data, len);
+}
+
+/********HttpServer*/
+
+HttpServer::HttpServer(uint16_t port) : _server(port)
+{
+  _handler = 0;
+  _served = 0;
+  _rejected = 0;
+  _cut = 0;
+}
+
+void HttpServer::begin()
+{
+  _server.begin();
+  _server.setNoDelay(true);
+}
+
+void HttpServer::poll()
+{
+  uint32_t now = millis();
+
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+  {
+    HttpRequest &request = _connections[i];
+    int status;
+
+    if (request._state == HttpRequest::Closed)
+    {
+      //Clients are only accepted into a free slot, the rest wait in the listen backlog
+      WiFiClient client = _server.available();
+
+      if (!client)
+      {
+        continue;
+      }
+
+      request.open(client, now);
+    }
+
+    status = request.receive();
+
+    if (!status && request._state != HttpRequest::Complete)
+    {
+      if (!request._client.connected())
+      {
+        //Gave up before sending the whole request
+        request.close();
+        continue;
+      }
+
+      if (now - request._openedAt < HTTP_TIMEOUT)
+      {
+        continue;
+      }
+
+      status = 408;
+    }
+
+    if (status)
+    {
+      const char * text = getHttpStatusText(status);
+      _rejected++;
+      request.send(status, "text/plain", text, strlen(text));
+    }
+    else if (_handler)
+    {
+      _served++;
+      _handler(request);
+    }
+
+    if (request._writeCut)
+    {
+      _cut++;
+    }
+
+    request.close();
+  }
+}
+
+uint8_t HttpServer::activeConnections()
+{
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+  {
+    if (_connections[i]._state != HttpRequest::Closed)
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,345 @@
+#include "JsonScanner.h"
+
+#include <string.h>
+
+#define PATH_OVERFLOW (JSON_MAX_PATH + 1)
+
+static bool isJsonSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+//Numbers, true, false and null are all made of these
+static bool isLiteralChar(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static int8_t hexDigit(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+
+  c |= 0x20;
+
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+JsonScanner::JsonScanner()
+{
+  _paths = 0;
+  _fieldCount = 0;
+  reset();
+}
+
+void JsonScanner::setFields(const char * const * paths, uint8_t count)
+{
+  _paths = paths;
+  _fieldCount = count < JSON_MAX_FIELDS ? count : JSON_MAX_FIELDS;
+  reset();
+}
+
+void JsonScanner::reset()
+{
+  _state = JsonValue;
+  _inKey = false;
+  _depth = 0;
+  _arrays = 0;
+  _pathLen = 0;
+  _capture = -1;
+  _valueLen = 0;
+  _found = 0;
+  memset(_values, 0, sizeof(_values));
+}
+
+bool JsonScanner::feed(const char * data, size_t len)
+{
+  for (size_t i = 0; i < len && _state != JsonError; i++)
+  {
+    scan(data[i]);
+  }
+
+  return _state != JsonError;
+}
+
+void JsonScanner::scan(char c)
+{
+  switch (_state)
+  {
+    case JsonString:
+      if (c == '\\')
+      {
+        _state = JsonEscape;
+      }
+      else if (c == '"')
+      {
+        if (_inKey)
+        {
+          _state = JsonColon;
+        }
+        else
+        {
+          endValue();
+        }
+      }
+      else
+      {
+        addStringChar(c);
+      }
+      return;
+
+    case JsonEscape:
+    {
+      static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+      const char * escape = c ? strchr(escapes, c) : NULL;
+
+      if (c == 'u')
+      {
+        _unicode = 0;
+        _unicodeDigits = 0;
+        _state = JsonUnicode;
+      }
+      else if (escape && (escape - escapes) % 2 == 0)
+      {
+        _state = JsonString;
+        addStringChar(escape[1]);
+      }
+      else
+      {
+        _state = JsonError;
+      }
+      return;
+    }
+
+    case JsonUnicode:
+      if (hexDigit(c) < 0)
+      {
+        _state = JsonError;
+        return;
+      }
+
+      _unicode = (_unicode << 4) | hexDigit(c);
+
+      if (++_unicodeDigits == 4)
+      {
+        //Only ASCII is kept, the LCD can't show anything else anyway
+        _state = JsonString;
+        addStringChar(_unicode < 0x80 && _unicode ? _unicode : '?');
+      }
+      return;
+
+    case JsonLiteral:
+      if (isLiteralChar(c))
+      {
+        capture(c);
+        return;
+      }
+
+      //Whatever ended the literal still needs handling below
+      endValue();
+      break;
+
+    default:
+      break;
+  }
+
+  if (isJsonSpace(c))
+  {
+    return;
+  }
+
+  switch (_state)
+  {
+    case JsonValue:
+    case JsonFirstValue:
+      if (c == '{')
+      {
+        push(false);
+      }
+      else if (c == '[')
+      {
+        push(true);
+      }
+      else if (c == '"')
+      {
+        startValue();
+        _inKey = false;
+        _state = JsonString;
+      }
+      else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')
+      {
+        startValue();
+        capture(c);
+        _state = JsonLiteral;
+      }
+      else if (c == ']' && _state == JsonFirstValue)
+      {
+        pop();
+      }
+      else
+      {
+        _state = JsonError;
+      }
+      break;
+
+    case JsonKey:
+    case JsonFirstKey:
+      if (c == '"')
+      {
+        _pathLen = _pathAt[_depth - 1];
+
+        if (_pathLen)
+        {
+          appendPath('.');
+        }
+
+        _inKey = true;
+        _state = JsonString;
+      }
+      else if (c == '}' && _state == JsonFirstKey)
+      {
+        pop();
+      }
+      else
+      {
+        _state = JsonError;
+      }
+      break;
+
+    case JsonColon:
+      _state = c == ':' ? JsonValue : JsonError;
+      break;
+
+    case JsonNext:
+    {
+      bool isArray = _arrays & (1 << (_depth - 1));
+
+      if (c == ',')
+      {
+        _state = isArray ? JsonValue : JsonKey;
+      }
+      else if (c == (isArray ? ']' : '}'))
+      {
+        pop();
+      }
+      else
+      {
+        _state = JsonError;
+      }
+      break;
+    }
+
+    case JsonDone:
+      //Anything after the document is ignored
+      break;
+
+    default:
+      _state = JsonError;
+      break;
+  }
+}
+
+//Keys build up the path, values are captured
+void JsonScanner::addStringChar(char c)
+{
+  if (_inKey)
+  {
+    appendPath(c);
+    return;
+  }
+
+  //Like \u escapes, a UTF-8 character outside ASCII becomes one ?
+  if (c & 0x80)
+  {
+    if ((c & 0xC0) == 0x80)
+    {
+      return;
+    }
+
+    c = '?';
+  }
+
+  capture(c);
+}
+
+void JsonScanner::push(bool isArray)
+{
+  if (_depth == JSON_MAX_DEPTH)
+  {
+    _state = JsonError;
+    return;
+  }
+
+  _pathAt[_depth] = _pathLen;
+  _arrays = isArray ? _arrays | (1 << _depth) : _arrays & ~(1 << _depth);
+  _depth++;
+
+  if (isArray)
+  {
+    appendPath('[');
+    appendPath(']');
+  }
+
+  _state = isArray ? JsonFirstValue : JsonFirstKey;
+}
+
+void JsonScanner::pop()
+{
+  _depth--;
+  _pathLen = _pathAt[_depth];
+  endValue();
+}
+
+//Starts capturing if the value's path is one of the fields and that field hasn't been found yet
+void JsonScanner::startValue()
+{
+  _capture = -1;
+  _valueLen = 0;
+
+  if (_pathLen > JSON_MAX_PATH)
+  {
+    return;
+  }
+
+  for (uint8_t i = 0; i < _fieldCount; i++)
+  {
+    if (!isFound(i) && strlen(_paths[i]) == _pathLen && memcmp(_paths[i], _path, _pathLen) == 0)
+    {
+      _capture = i;
+      return;
+    }
+  }
+}
+
+void JsonScanner::endValue()
+{
+  if (_capture >= 0)
+  {
+    _values[_capture][_valueLen] = '\0';
+    _found |= 1 << _capture;
+    _capture = -1;
+  }
+
+  _state = _depth ? JsonNext : JsonDone;
+}
+
+void JsonScanner::appendPath(char c)
+{
+  if (_pathLen >= JSON_MAX_PATH)
+  {
+    _pathLen = PATH_OVERFLOW;
+    return;
+  }
+
+  _path[_pathLen++] = c;
+}
+
+void JsonScanner::capture(char c)
+{
+  if (_capture >= 0 && _valueLen < JSON_MAX_VALUE - 1)
+  {
+    _values[_capture][_valueLen++] = c;
+  }
+}
@@ -0,0 +1,249 @@
+#include "JsonWriter.h"
+
+#include <string.h>
+
+static const char _hexDigits[] = "0123456789abcdef";
+
+//Returns the length of the well formed UTF-8 sequence at value, or 0 if it isn't one. Overlong forms,
+//surrogates and anything past U+10FFFF are not well formed.
+static size_t getUtf8Length(const uint8_t * value, size_t len)
+{
+  uint8_t c = value[0];
+  size_t count;
+  uint8_t low = 0x80;
+  uint8_t high = 0xBF;
+
+  if (c >= 0xC2 && c <= 0xDF)
+  {
+    count = 2;
+  }
+  else if (c >= 0xE0 && c <= 0xEF)
+  {
+    count = 3;
+    low = c == 0xE0 ? 0xA0 : 0x80;
+    high = c == 0xED ? 0x9F : 0xBF;
+  }
+  else if (c >= 0xF0 && c <= 0xF4)
+  {
+    count = 4;
+    low = c == 0xF0 ? 0x90 : 0x80;
+    high = c == 0xF4 ? 0x8F : 0xBF;
+  }
+  else
+  {
+    return 0;
+  }
+
+  if (len < count || value[1] < low || value[1] > high)
+  {
+    return 0;
+  }
+
+  for (size_t i = 2; i < count; i++)
+  {
+    if ((value[i] & 0xC0) != 0x80)
+    {
+      return 0;
+    }
+  }
+
+  return count;
+}
+
+JsonWriter::JsonWriter(Print & out) : _out(out)
+{
+  _depth = 0;
+  _hasValues = 0;
+}
+
+void JsonWriter::beginObject(const char * key)
+{
+  begin(key, '{');
+}
+
+void JsonWriter::endObject()
+{
+  end('}');
+}
+
+void JsonWriter::beginArray(const char * key)
+{
+  begin(key, '[');
+}
+
+void JsonWriter::endArray()
+{
+  end(']');
+}
+
+void JsonWriter::addString(const char * key, const char * value)
+{
+  addString(key, value, strlen(value));
+}
+
+//Runs of characters that need no escaping go out in one write. JSON takes UTF-8 as is, so well formed
+//sequences pass straight through, but a byte from 0x80 up that isn't part of one would make the whole reply
+//invalid and is written as '?'.
+void JsonWriter::addString(const char * key, const char * value, size_t len)
+{
+  size_t start = 0;
+
+  writeKey(key);
+  _out.write('"');
+
+  for (size_t i = 0; i < len; i++)
+  {
+    uint8_t c = value[i];
+    char escape[6] = { '\\', 0, '0', '0', 0, 0 };
+    size_t escapeLen = 2;
+
+    if (c == '"' || c == '\\')
+    {
+      escape[1] = c;
+    }
+    else if (c == '\n')
+    {
+      escape[1] = 'n';
+    }
+    else if (c == '\r')
+    {
+      escape[1] = 'r';
+    }
+    else if (c == '\t')
+    {
+      escape[1] = 't';
+    }
+    else if (c < 0x20 || c == 0x7F)
+    {
+      escape[1] = 'u';
+      escape[4] = _hexDigits[c >> 4];
+      escape[5] = _hexDigits[c & 0xF];
+      escapeLen = 6;
+    }
+    else if (c < 0x80)
+    {
+      continue;
+    }
+    else
+    {
+      size_t utf8Len = getUtf8Length((const uint8_t *)value + i, len - i);
+
+      if (utf8Len)
+      {
+        i += utf8Len - 1;
+        continue;
+      }
+
+      escape[0] = '?';
+      escapeLen = 1;
+    }
+
+    _out.write(value + start, i - start);
+    _out.write(escape, escapeLen);
+    start = i + 1;
+  }
+
+  _out.write(value + start, len - start);
+  _out.write('"');
+}
+
+void JsonWriter::addInt(const char * key, int32_t value)
+{
+  writeKey(key);
+
+  if (value < 0)
+  {
+    _out.write('-');
+  }
+
+  //Negating as unsigned also works for INT32_MIN
+  writeUint(value < 0 ? 0 - (uint32_t)value : value);
+}
+
+void JsonWriter::addUint(const char * key, uint32_t value)
+{
+  writeKey(key);
+  writeUint(value);
+}
+
+void JsonWriter::addBool(const char * key, bool value)
+{
+  writeKey(key);
+  _out.write(value ? "true" : "false");
+}
+
+void JsonWriter::addIp(const char * key, uint32_t address)
+{
+  writeKey(key);
+  _out.write('"');
+
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    if (i)
+    {
+      _out.write('.');
+    }
+
+    writeUint((address >> (i * 8)) & 0xFF);
+  }
+
+  _out.write('"');
+}
+
+//Deeper than JSON_WRITER_MAX_DEPTH, commas are no longer written
+void JsonWriter::begin(const char * key, char bracket)
+{
+  writeKey(key);
+  _out.write(bracket);
+
+  if (_depth < JSON_WRITER_MAX_DEPTH)
+  {
+    _hasValues &= ~(1 << _depth);
+  }
+
+  _depth++;
+}
+
+void JsonWriter::end(char bracket)
+{
+  _out.write(bracket);
+  _depth--;
+}
+
+//Also writes the comma before every value but the first in its container
+void JsonWriter::writeKey(const char * key)
+{
+  if (_depth && _depth <= JSON_WRITER_MAX_DEPTH)
+  {
+    uint8_t bit = 1 << (_depth - 1);
+
+    if (_hasValues & bit)
+    {
+      _out.write(',');
+    }
+
+    _hasValues |= bit;
+  }
+
+  if (key)
+  {
+    _out.write('"');
+    _out.write(key);
+    _out.write("\":", 2);
+  }
+}
+
+void JsonWriter::writeUint(uint32_t value)
+{
+  char digits[10];
+  uint8_t count = 0;
+
+  do
+  {
+    digits[sizeof(digits) - 1 - count++] = '0' + value % 10;
+    value /= 10;
+  }
+  while (value);
+
+  _out.write(digits + sizeof(digits) - count, count);
+}
@@ -0,0 +1,151 @@
+#include "LedEffects.h"
+
+#include <string.h>
+#include <strings.h>
+
+static const char * const _effectNames[EffectCount] = { "none", "fade", "breathe", "chase", "comet", "progress" };
+
+#define CHASE_SPACING 4 //every 4th LED is lit
+
+LedEffect getLedEffect(const char * name, uint16_t len)
+{
+  for (uint8_t i = 0; i < EffectCount; i++)
+  {
+    if (strlen(_effectNames[i]) == len && strncasecmp(_effectNames[i], name, len) == 0)
+    {
+      return (LedEffect)i;
+    }
+  }
+
+  return EffectCount;
+}
+
+const char * getLedEffectName(LedEffect effect)
+{
+  return effect < EffectCount ? _effectNames[effect] : "unknown";
+}
+
+/********Fixed Point Helpers
+ * Levels and positions are 0-255, 255 meaning fully on / all the way through.
+ */
+
+//value * level / 255 without the divide
+static inline uint8_t scale8(uint8_t value, uint8_t level)
+{
+  return ((uint16_t)value * (level + 1)) >> 8;
+}
+
+//Smoothstep, 3t^2 - 2t^3
+static inline uint8_t ease8(uint8_t t)
+{
+  return ((uint32_t)t * t * (3 * 255 - 2 * t)) / (255UL * 255UL);
+}
+
+static inline uint8_t lerp8(uint8_t from, uint8_t to, uint8_t t)
+{
+  return from + (((int16_t)to - from) * t) / 255;
+}
+
+//Where we are in the current cycle
+static inline uint8_t cyclePhase8(uint32_t elapsed, uint16_t period)
+{
+  return ((elapsed % period) << 8) / period;
+}
+
+//How far through a one shot effect we are, holding at 255 once done
+static inline uint8_t onceProgress8(uint32_t elapsed, uint16_t period)
+{
+  return elapsed >= period ? 255 : (elapsed * 255) / period;
+}
+
+static inline void setScaledPixel(LedFrame &frame, uint8_t index, const LedEffectParams &params, uint8_t level)
+{
+  frame.setPixel(index, scale8(params.red, level), scale8(params.green, level), scale8(params.blue, level), params.brightness);
+}
+
+/********End Fixed Point Helpers*/
+
+void renderLedEffect(const LedEffectParams &params, uint32_t elapsed, LedFrame &frame, uint8_t first, uint8_t count)
+{
+  uint16_t period = params.period < MIN_EFFECT_PERIOD ? MIN_EFFECT_PERIOD : params.period;
+  uint8_t t;
+
+  switch (params.effect)
+  {
+    case EffectFade:
+    {
+      t = onceProgress8(elapsed, period);
+      t = params.eased ? ease8(t) : t;
+
+      uint8_t red = lerp8(params.fromRed, params.red, t);
+      uint8_t green = lerp8(params.fromGreen, params.green, t);
+      uint8_t blue = lerp8(params.fromBlue, params.blue, t);
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+        frame.setPixel(first + i, red, green, blue, params.brightness);
+      }
+      break;
+    }
+    case EffectBreathe:
+    {
+      //Triangle wave up and back down once per period
+      t = cyclePhase8(elapsed, period);
+      t = t < 128 ? t * 2 : (255 - t) * 2;
+      t = params.eased ? ease8(t) : t;
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+        setScaledPixel(frame, first + i, params, t);
+      }
+      break;
+    }
+    case EffectChase:
+    {
+      uint8_t offset = ((uint16_t)cyclePhase8(elapsed, period) * CHASE_SPACING) >> 8;
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+        setScaledPixel(frame, first + i, params, (i + CHASE_SPACING - offset) % CHASE_SPACING == 0 ? 255 : 0);
+      }
+      break;
+    }
+    case EffectComet:
+    {
+      //Head goes round once per period with a tail a third of the strip long fading out behind it
+      uint16_t head = ((uint32_t)cyclePhase8(elapsed, period) * count) >> 8;
+      uint8_t tail = count / 3 ? count / 3 : 1;
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+        uint8_t distance = (head + count - i) % count;
+        uint8_t level = distance < tail ? 255 - (distance * 255) / tail : 0;
+        setScaledPixel(frame, first + i, params, params.eased ? scale8(level, level) : level);
+      }
+      break;
+    }
+    case EffectProgress:
+    {
+      t = onceProgress8(elapsed, period);
+      t = params.eased ? ease8(t) : t;
+
+      //Fill level in 1/256ths of an LED so the leading LED can be partly lit
+      uint32_t fill = (uint32_t)count * 256 * (params.progress > 100 ? 100 : params.progress) / 100;
+      fill = (fill * t) / 255;
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+        uint32_t start = (uint32_t)i * 256;
+        uint8_t level = fill >= start + 256 ? 255 : (fill > start ? fill - start : 0);
+        setScaledPixel(frame, first + i, params, level);
+      }
+      break;
+    }
+    default:
+      for (uint8_t i = 0; i < count; i++)
+      {
+        setScaledPixel(frame, first + i, params, 255);
+      }
+      break;
+  }
+}
@@ -0,0 +1,139 @@
+#include "LedFrame.h"
+
+#include <string.h>
+#include <SPI.h>
+#include "LedGamma.h"
+
+LedFrame::LedFrame()
+{
+  memset(_pixels, 0, sizeof(_pixels));
+
+  //Start and end frames never change so they are written once here
+  memset(_stream, 0, LED_SOF_LEN);
+  _stream[LED_FRAME_LEN - 2] = 0xFF;
+  _stream[LED_FRAME_LEN - 1] = 0x00;
+
+  _brightness = LED_FULL_BRIGHTNESS;
+  _dirty = true;
+  _framesSent = 0;
+}
+
+void LedFrame::setPixel(uint8_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t brightness)
+{
+  if (index >= LED_COUNT)
+  {
+    return;
+  }
+
+  uint8_t *pixel = _pixels[index];
+
+  if (pixel[0] != brightness || pixel[1] != blue || pixel[2] != green || pixel[3] != red)
+  {
+    pixel[0] = brightness;
+    pixel[1] = blue;
+    pixel[2] = green;
+    pixel[3] = red;
+    _dirty = true;
+  }
+}
+
+void LedFrame::getPixel(uint8_t index, uint8_t &red, uint8_t &green, uint8_t &blue)
+{
+  if (index >= LED_COUNT)
+  {
+    red = green = blue = 0;
+    return;
+  }
+
+  blue = _pixels[index][1];
+  green = _pixels[index][2];
+  red = _pixels[index][3];
+}
+
+void LedFrame::fill(uint8_t red, uint8_t green, uint8_t blue, uint8_t brightness, uint8_t count)
+{
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    if (i < count)
+    {
+      setPixel(i, red, green, blue, brightness);
+    }
+    else
+    {
+      setPixel(i, 0, 0, 0, 0);
+    }
+  }
+}
+
+void LedFrame::clear()
+{
+  fill(0, 0, 0, 0, 0);
+}
+
+void LedFrame::setBrightness(uint8_t brightness)
+{
+  if (brightness != _brightness)
+  {
+    _brightness = brightness;
+    _dirty = true;
+  }
+}
+
+bool LedFrame::show(bool force)
+{
+  if (!_dirty && !force)
+  {
+    return false;
+  }
+
+  if (_dirty)
+  {
+    rebuild();
+  }
+
+  SPI.writeBytes(_stream, LED_FRAME_LEN);
+  _framesSent++;
+
+  return true;
+}
+
+static inline uint8_t scalePwm(uint32_t light, uint32_t scale)
+{
+  uint32_t pwm = (light * scale + 32768) >> 16;
+  return pwm > 255 ? 255 : pwm;
+}
+
+void LedFrame::rebuild()
+{
+  uint8_t *word = _stream + LED_SOF_LEN;
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    //Linear light for each channel on a 0-65535 scale, brightness applied. A level of 0 has to come out as off.
+    uint16_t level = ((uint16_t)_pixels[i][0] * (_brightness + 1)) >> 8;
+    uint32_t blue = ((uint32_t)kLedGamma.values[_pixels[i][1]] * level + 127) / 255;
+    uint32_t green = ((uint32_t)kLedGamma.values[_pixels[i][2]] * level + 127) / 255;
+    uint32_t red = ((uint32_t)kLedGamma.values[_pixels[i][3]] * level + 127) / 255;
+    uint32_t brightest = max(red, max(green, blue));
+
+    if (!brightest)
+    {
+      word[0] = LED_START_BYTE;
+      word[1] = word[2] = word[3] = 0;
+      word += 4;
+      continue;
+    }
+
+    //Lowest global current that still fits the brightest channel in the PWM
+    uint8_t global = (brightest * LED_GLOBAL_MAX + 65534) / 65535;
+    uint32_t scale = kLedPwmScale.values[global];
+
+    word[0] = LED_START_BYTE | global;
+    word[1] = scalePwm(blue, scale); //Blue
+    word[2] = scalePwm(green, scale); //Green
+    word[3] = scalePwm(red, scale); //Red
+    word += 4;
+  }
+
+  _dirty = false;
+}
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <inttypes.h>
 #include "Arduino.h"
+#include "LcdGpio.h"
+#include "Profiler.h"
 
 // When the display powers up, it is configured as follows:
 //
@@ -67,19 +69,43 @@ void LiquidCrystal::init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t en
   _data_pins[6] = d6;
   _data_pins[7] = d7; 
 
+  _buffered = false;
+  _async = false;
+  _queueHead = 0;
+  _queueCount = 0;
+  _readyAt = 0;
+  _busyPolling = false;
+  _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+  _ddramValid = false;
+  _shadowAddress = 0;
+  _address = LCD_ADDRESS_UNKNOWN;
+  _busTransactions = 0;
+  _lastFlushTransactions = 0;
+
   if (fourbitmode)
     _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
   else 
     _displayfunction = LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
+
+  buildNibbleMasks();
   
   begin(16, 1);  
 }
 
 void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
+  // initialization always runs synchronously, anything still queued is stale
+  uint8_t async = _async;
+  _async = false;
+  _queueCount = 0;
+  // the busy flag can't be checked until the function set is done
+  _busyPolling = false;
+
   if (lines > 1) {
     _displayfunction |= LCD_2LINE;
   }
   _numlines = lines;
+  _ddramValid = false;
+  _address = LCD_ADDRESS_UNKNOWN;
 
   setRowOffsets(0x00, 0x40, 0x00 + cols, 0x40 + cols);  
 
@@ -107,6 +133,7 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   delayMicroseconds(50000); 
   // Now we pull both RS and R/W low to begin commands
   digitalWrite(_rs_pin, LOW);
+  _rsLevel = LOW;
   digitalWrite(_enable_pin, LOW);
   if (_rw_pin != 255) { 
     digitalWrite(_rw_pin, LOW);
@@ -154,14 +181,17 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;  
   display();
 
-  // clear it off
-  clear();
+  // clear it off, straight to the panel even when buffered
+  command(LCD_CLEARDISPLAY);
 
   // Initialize to default text direction (for romance languages)
   _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
   // set the entry mode
   command(LCD_ENTRYMODESET | _displaymode);
 
+  _async = async;
+  setBusyPolling(true);
+
 }
 
 void LiquidCrystal::setRowOffsets(int row0, int row1, int row2, int row3)
@@ -175,14 +205,23 @@ void LiquidCrystal::setRowOffsets(int row0, int row1, int row2, int row3)
 /********** high level commands, for the user! */
 void LiquidCrystal::clear()
 {
+  if (_buffered) {
+    memset(_shadow, ' ', sizeof(_shadow));
+    _shadowAddress = 0;
+    return;
+  }
+
   command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
 }
 
 void LiquidCrystal::home()
 {
+  if (_buffered) {
+    _shadowAddress = 0;
+    return;
+  }
+
   command(LCD_RETURNHOME);  // set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
 }
 
 void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
@@ -195,6 +234,11 @@ void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
     row = _numlines - 1;    // we count rows starting w/0
   }
   
+  if (_buffered) {
+    _shadowAddress = (col + _row_offsets[row]) & 0x7F;
+    return;
+  }
+
   command(LCD_SETDDRAMADDR | (col + _row_offsets[row]));
 }
 
@@ -266,10 +310,293 @@ void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
   location &= 0x7; // we only have 8 locations 0-7
   command(LCD_SETCGRAMADDR | (location << 3));
   for (int i=0; i<8; i++) {
-    write(charmap[i]);
+    send(charmap[i], HIGH); // CGRAM data never goes through the shadow
+  }
+}
+
+/*********** shadow framebuffer */
+
+void LiquidCrystal::setBuffered(bool buffered) {
+  if (buffered && !_buffered) {
+    // start drawing from whatever the panel currently shows
+    if (_ddramValid) {
+      memcpy(_shadow, _ddram, sizeof(_shadow));
+    } else {
+      memset(_shadow, ' ', sizeof(_shadow));
+    }
+    _shadowAddress = (_address < 0x80) ? _address : 0;
+  }
+  _buffered = buffered;
+}
+
+bool LiquidCrystal::drawPage(const char *page, uint8_t cols, uint8_t rows, bool force) {
+  if (rows > _numlines) {
+    rows = _numlines;
+  }
+
+  // Skipped only when the _ddram mirror says the panel shows the page and
+  // the shadow holds nothing else waiting to be flushed over it. Checking
+  // _ddram catches cells changed by direct writes that bypassed the shadow.
+  if (_buffered && !force && _ddramValid) {
+    bool same = true;
+    for (uint8_t row = 0; row < rows && same; row++) {
+      uint8_t index = addressToIndex(_row_offsets[row]);
+      same = (index + cols <= LCD_DDRAM_SIZE)
+        && memcmp(&_ddram[index], page + row * cols, cols) == 0
+        && memcmp(&_shadow[index], page + row * cols, cols) == 0;
+    }
+    if (same) {
+      return false;
+    }
+  }
+
+  for (uint8_t row = 0; row < rows; row++) {
+    setCursor(0, row);
+    write((const uint8_t *)page + row * cols, cols);
+  }
+  return true;
+}
+
+// Send the cells that differ from the panel. Cells are visited in address
+// counter order so consecutive changes ride on the auto-increment and only
+// need one LCD_SETDDRAMADDR per run.
+void LiquidCrystal::flush() {
+  // once per frame, a span per send() would push every other span out of the ring
+  PROFILE_SCOPE(SpanLcdFlush, "lcd flush");
+  uint32_t start = _busTransactions;
+
+  // the controller can tell us where its cursor is, which may save a move
+  if (_address == LCD_ADDRESS_UNKNOWN && _busyPolling && !_queueCount) {
+    waitReady();
+    _address = readStatus() & 0x7F;
+  }
+
+  for (uint8_t i = 0; i < LCD_DDRAM_SIZE; i++) {
+    uint8_t address = indexToAddress(i);
+
+    if (_ddramValid && _shadow[i] == _ddram[i]) {
+      // Rewriting a single unchanged cell costs the same as a cursor move,
+      // so keep going through one-cell gaps when we are already in place.
+      bool bridge = (_address == address) && (i + 1 < LCD_DDRAM_SIZE)
+        && (_shadow[i + 1] != _ddram[i + 1]);
+      if (!bridge) {
+        continue;
+      }
+    }
+
+    if (_address != address) {
+      command(LCD_SETDDRAMADDR | address);
+    }
+    send(_shadow[i], HIGH);
+  }
+
+  _ddramValid = true;
+  _lastFlushTransactions = _busTransactions - start;
+}
+
+// Keep _ddram/_address in step with what each command does to the controller
+void LiquidCrystal::trackCommand(uint8_t value) {
+  if (value & LCD_SETDDRAMADDR) {
+    _address = value & 0x7F;
+  } else if (value & LCD_SETCGRAMADDR) {
+    _address = LCD_ADDRESS_CGRAM;
+  } else if (value & LCD_FUNCTIONSET) {
+    // no effect on the address counter
+  } else if (value & LCD_CURSORSHIFT) {
+    if (!(value & LCD_DISPLAYMOVE)) {
+      _address = LCD_ADDRESS_UNKNOWN;
+    }
+  } else if (value & (LCD_DISPLAYCONTROL | LCD_ENTRYMODESET)) {
+    // no effect on the address counter
+  } else if (value & LCD_RETURNHOME) {
+    _address = 0;
+  } else if (value == LCD_CLEARDISPLAY) {
+    memset(_ddram, ' ', sizeof(_ddram));
+    _ddramValid = true;
+    _address = 0;
   }
 }
 
+void LiquidCrystal::trackData(uint8_t value) {
+  if (_address == LCD_ADDRESS_CGRAM) {
+    return;
+  }
+  if (_address == LCD_ADDRESS_UNKNOWN) {
+    // the character landed somewhere we can't see, resend everything
+    _ddramValid = false;
+    return;
+  }
+
+  uint8_t index = addressToIndex(_address);
+  if (index < LCD_DDRAM_SIZE) {
+    _ddram[index] = value;
+  }
+  _address = stepAddress(_address);
+}
+
+// Move an address the way the controller does after a data write
+uint8_t LiquidCrystal::stepAddress(uint8_t address) {
+  bool increment = _displaymode & LCD_ENTRYLEFT;
+
+  if (!(_displayfunction & LCD_2LINE)) {
+    return increment ? (address + 1) % LCD_DDRAM_SIZE
+      : (address + LCD_DDRAM_SIZE - 1) % LCD_DDRAM_SIZE;
+  }
+
+  // two line mode: 0x00-0x27 and 0x40-0x67, wrapping between them
+  if (increment) {
+    if (address == 0x27) return 0x40;
+    if (address == 0x67) return 0x00;
+    return address + 1;
+  }
+  if (address == 0x40) return 0x27;
+  if (address == 0x00) return 0x67;
+  return address - 1;
+}
+
+// Returns LCD_DDRAM_SIZE for addresses that have no DDRAM behind them
+uint8_t LiquidCrystal::addressToIndex(uint8_t address) {
+  if (!(_displayfunction & LCD_2LINE)) {
+    return (address < LCD_DDRAM_SIZE) ? address : LCD_DDRAM_SIZE;
+  }
+
+  uint8_t column = address & 0x3F;
+  if (column >= LCD_DDRAM_SIZE / 2) {
+    return LCD_DDRAM_SIZE;
+  }
+  return (address & 0x40) ? LCD_DDRAM_SIZE / 2 + column : column;
+}
+
+uint8_t LiquidCrystal::indexToAddress(uint8_t index) {
+  if (!(_displayfunction & LCD_2LINE) || index < LCD_DDRAM_SIZE / 2) {
+    return index;
+  }
+  return 0x40 + index - LCD_DDRAM_SIZE / 2;
+}
+
+/*********** async command queue */
+
+void LiquidCrystal::setAsync(bool async) {
+  if (!async) {
+    // drain whatever is still queued so nothing is sent out of order
+    while (_queueCount) {
+      waitReady();
+      pump();
+    }
+  }
+  _async = async;
+}
+
+// Sends the next queued byte if the controller is ready for it. Never
+// waits, so it is safe to call from a busy loop. Returns true while there
+// is still something queued.
+bool LiquidCrystal::pump() {
+  if (!_queueCount) {
+    return false;
+  }
+  if (!isReady()) {
+    return true;
+  }
+
+  uint16_t entry = _queue[_queueHead];
+  _queueHead = (_queueHead + 1) & (LCD_QUEUE_SIZE - 1);
+  _queueCount--;
+  transmit(entry);
+
+  return _queueCount != 0;
+}
+
+void LiquidCrystal::waitReady() {
+  while (!isReady()) {
+  }
+}
+
+// Ready once the worst case settle time has passed, or earlier if the
+// controller says it is no longer busy.
+bool LiquidCrystal::isReady() {
+  if ((int32_t)(micros() - _readyAt) >= 0) {
+    return true;
+  }
+  if (_busyPolling && !(readStatus() & 0x80)) {
+    _readyAt = micros();
+    return true;
+  }
+  return false;
+}
+
+/*********** busy flag */
+
+void LiquidCrystal::setBusyPolling(bool polling) {
+  // without an RW pin there is nothing to read back, stay on timed delays
+  _busyPolling = polling && (_rw_pin != 255);
+}
+
+// Returns the busy flag in bit 7 and the address counter in bits 0-6
+uint8_t LiquidCrystal::readStatus() {
+  if (_rw_pin == 255) {
+    return 0x80 | LCD_ADDRESS_UNKNOWN;
+  }
+
+  uint8_t pins = (_displayfunction & LCD_8BITMODE) ? 8 : 4;
+#ifdef LCD_GPIO_MASKS
+  if (_maskedBus) {
+    lcdGpioInput(_dataMask);
+  } else
+#endif
+  for (uint8_t i = 0; i < pins; i++) {
+    pinMode(_data_pins[i], INPUT);
+  }
+  if (_rsLevel != LOW) {
+    digitalWrite(_rs_pin, LOW);
+    _rsLevel = LOW;
+  }
+  digitalWrite(_rw_pin, HIGH);
+
+  uint8_t value;
+  if (_displayfunction & LCD_8BITMODE) {
+    value = readBus();
+  } else {
+    value = readBus() << 4;
+    value |= readBus();
+  }
+
+  digitalWrite(_rw_pin, LOW);
+#ifdef LCD_GPIO_MASKS
+  if (_maskedBus) {
+    lcdGpioOutput(_dataMask);
+  } else
+#endif
+  for (uint8_t i = 0; i < pins; i++) {
+    pinMode(_data_pins[i], OUTPUT);
+  }
+
+  return value;
+}
+
+// One enable pulse worth of data from the controller
+uint8_t LiquidCrystal::readBus() {
+  uint8_t value = 0;
+  uint8_t pins = (_displayfunction & LCD_8BITMODE) ? 8 : 4;
+
+  digitalWrite(_enable_pin, HIGH);
+  delayMicroseconds(1);    // data is valid 360ns after enable rises
+#ifdef LCD_GPIO_MASKS
+  if (_maskedBus) {
+    uint32_t port = lcdGpioRead();
+    for (uint8_t i = 0; i < pins; i++) {
+      value |= ((port >> _data_pins[i]) & 0x01) << i;
+    }
+  } else
+#endif
+  for (uint8_t i = 0; i < pins; i++) {
+    value |= (digitalRead(_data_pins[i]) ? 1 : 0) << i;
+  }
+  digitalWrite(_enable_pin, LOW);
+  delayMicroseconds(1);
+
+  return value;
+}
+
 /*********** mid level commands, for sending data/cmds */
 
 inline void LiquidCrystal::command(uint8_t value) {
@@ -277,6 +604,15 @@ inline void LiquidCrystal::command(uint8_t value) {
 }
 
 inline size_t LiquidCrystal::write(uint8_t value) {
+  if (_buffered) {
+    uint8_t index = addressToIndex(_shadowAddress);
+    if (index < LCD_DDRAM_SIZE) {
+      _shadow[index] = value;
+    }
+    _shadowAddress = stepAddress(_shadowAddress);
+    return 1;
+  }
+
   send(value, HIGH);
   return 1; // assume sucess
 }
@@ -285,11 +621,40 @@ inline size_t LiquidCrystal::write(uint8_t value) {
 
 // write either command or data, with automatic 4/8-bit selection
 void LiquidCrystal::send(uint8_t value, uint8_t mode) {
-  digitalWrite(_rs_pin, mode);
+  _busTransactions++;
+  if (mode == LOW) {
+    trackCommand(value);
+  } else {
+    trackData(value);
+  }
 
-  // if there is a RW pin indicated, set it low to Write
-  if (_rw_pin != 255) { 
-    digitalWrite(_rw_pin, LOW);
+  uint16_t entry = value | (mode == LOW ? 0 : 0x100);
+
+  if (!_async) {
+    waitReady();
+    transmit(entry);
+    return;
+  }
+
+  // queue full, fall back to sending synchronously until there is room
+  while (_queueCount == LCD_QUEUE_SIZE) {
+    waitReady();
+    pump();
+  }
+  _queue[(_queueHead + _queueCount) & (LCD_QUEUE_SIZE - 1)] = entry;
+  _queueCount++;
+}
+
+// put one byte on the bus, then note when the controller will be ready again
+void LiquidCrystal::transmit(uint16_t entry) {
+  uint8_t value = entry & 0xFF;
+  uint8_t mode = (entry & 0x100) ? HIGH : LOW;
+
+  // RS often stays put between bytes, and RW is already low (begin() and
+  // readStatus() leave it there), so only touch the pins that change
+  if (_rsLevel != mode) {
+    digitalWrite(_rs_pin, mode);
+    _rsLevel = mode;
   }
   
   if (_displayfunction & LCD_8BITMODE) {
@@ -298,18 +663,42 @@ void LiquidCrystal::send(uint8_t value, uint8_t mode) {
     write4bits(value>>4);
     write4bits(value);
   }
+
+  if (mode == LOW && value <= (LCD_RETURNHOME | LCD_CLEARDISPLAY)) {
+    _readyAt = micros() + LCD_SLOW_SETTLE_US;
+  }
 }
 
 void LiquidCrystal::pulseEnable(void) {
+#ifdef LCD_GPIO_MASKS
+  if (_enableMask) {
+    lcdGpioClear(_enableMask);
+    delayMicroseconds(1);
+    lcdGpioSet(_enableMask);
+    delayMicroseconds(1);    // enable pulse must be >450ns
+    lcdGpioClear(_enableMask);
+    _readyAt = micros() + LCD_SETTLE_US; // waited for by the next send, not here
+    return;
+  }
+#endif
   digitalWrite(_enable_pin, LOW);
   delayMicroseconds(1);    
   digitalWrite(_enable_pin, HIGH);
   delayMicroseconds(1);    // enable pulse must be >450ns
   digitalWrite(_enable_pin, LOW);
-  delayMicroseconds(100);   // commands need > 37us to settle
+  _readyAt = micros() + LCD_SETTLE_US; // waited for by the next send, not here
 }
 
 void LiquidCrystal::write4bits(uint8_t value) {
+#ifdef LCD_GPIO_MASKS
+  if (_maskedBus) {
+    value &= 0x0F;
+    lcdGpioSet(_nibbleSet[value]);
+    lcdGpioClear(_nibbleClear[value]);
+    pulseEnable();
+    return;
+  }
+#endif
   for (int i = 0; i < 4; i++) {
     digitalWrite(_data_pins[i], (value >> i) & 0x01);
   }
@@ -323,4 +712,41 @@ void LiquidCrystal::write8bits(uint8_t value) {
   }
   
   pulseEnable();
+}
+
+// Precompute which port bits to set and clear for every 4-bit value. Only
+// possible in 4-bit mode with all data pins on GPIO 0-15; anything else
+// keeps the digitalWrite() loop.
+void LiquidCrystal::buildNibbleMasks() {
+  _maskedBus = false;
+  _dataMask = 0;
+  _enableMask = 0;
+  _rsLevel = 255;
+
+#ifdef LCD_GPIO_MASKS
+  if (_enable_pin < LCD_GPIO_MASK_PINS) {
+    _enableMask = 1UL << _enable_pin;
+  }
+
+  if (_displayfunction & LCD_8BITMODE) {
+    return;
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    if (_data_pins[i] >= LCD_GPIO_MASK_PINS) {
+      return;
+    }
+    _dataMask |= 1UL << _data_pins[i];
+  }
+
+  for (uint8_t value = 0; value < 16; value++) {
+    _nibbleSet[value] = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      if ((value >> i) & 0x01) {
+        _nibbleSet[value] |= 1UL << _data_pins[i];
+      }
+    }
+    _nibbleClear[value] = _dataMask & ~_nibbleSet[value];
+  }
+  _maskedBus = true;
+#endif
 }
\ No newline at end of file
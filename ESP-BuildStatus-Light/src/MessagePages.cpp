@@ -0,0 +1,111 @@
+#include "MessagePages.h"
+
+#include <string.h>
+#include "Profiler.h"
+
+MessagePages::MessagePages()
+{
+  set(NULL, 0);
+}
+
+void MessagePages::set(const char * message, uint16_t len)
+{
+  if (len > MAX_MESSAGE_LEN)
+  {
+    len = MAX_MESSAGE_LEN;
+  }
+
+  if (len > 0)
+  {
+    memcpy(_text, message, len);
+  }
+
+  _text[len] = '\0';
+  _length = len;
+
+  wrap();
+  render();
+}
+
+//Lines break at the last space that fits, the space itself is dropped. A word too long for a line is cut.
+void MessagePages::wrap()
+{
+  PROFILE_SCOPE(SpanWrapMessage, "wrap message");
+  uint16_t charIndex = 0;
+  uint16_t lastWhiteSpaceIndex = 0;
+  MessageLine *currentLine = _lines;
+
+  _lineCount = 0;
+
+  if (_length == 0)
+  {
+    return;
+  }
+
+  currentLine->offset = 0;
+  currentLine->len = 0;
+
+  while(true)
+  {
+    if (_text[charIndex] == ' ')
+    {
+      lastWhiteSpaceIndex = charIndex;
+    }
+
+    //We have enough characters for a line
+    if (currentLine->len == MESSAGE_COLS - 1)
+    {
+      //If we have found another white space before the end of this line, we should truncate the line there.    
+      if (lastWhiteSpaceIndex > 0)
+      {
+        currentLine->len = lastWhiteSpaceIndex - currentLine->offset;
+        charIndex = lastWhiteSpaceIndex + 1;
+        lastWhiteSpaceIndex = 0;  
+      }
+
+      _lineCount++;
+
+      //The white space we split on was the last character, or anything past here would not fit
+      if (charIndex >= _length || _lineCount >= MAX_MESSAGE_LINES)
+      {
+        break;
+      }
+
+      //Then we start the next line where this one ended
+      currentLine++;
+      currentLine->offset = charIndex;
+      currentLine->len = 0;
+    }
+    else
+    {
+      currentLine->len++;
+      charIndex++;
+
+      //We have reached the end of the message
+      if (charIndex >= _length)
+      {
+        _lineCount++;
+        break;
+      }
+    }
+  }
+}
+
+void MessagePages::render()
+{
+  memset(_rows, ' ', sizeof(_rows));
+
+  for (uint8_t i = 0; i < _lineCount; i++)
+  {
+    memcpy(_rows[i], _text + _lines[i].offset, _lines[i].len);
+  }
+
+  if (_lineCount == 0)
+  {
+    _pageCount = 0;
+  }
+  else
+  {
+    _pageCount = _lineCount > MESSAGE_PAGE_ROWS ? _lineCount : 1;
+  }
+}
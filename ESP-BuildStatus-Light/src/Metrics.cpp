@@ -0,0 +1,89 @@
+#include "Metrics.h"
+
+void recordDuration(DurationHistogram &histogram, uint32_t duration)
+{
+  uint8_t bucket = 0;
+
+  while (bucket < DURATION_BUCKETS - 1 && duration > kDurationBuckets[bucket])
+  {
+    bucket++;
+  }
+
+  histogram.counts[bucket]++;
+  histogram.count++;
+  histogram.sum += duration;
+}
+
+void printMetricType(Print &out, const char * name, const char * type)
+{
+  out.print("# TYPE " METRICS_PREFIX);
+  out.print(name);
+  out.print(' ');
+  out.println(type);
+}
+
+void printMetric(Print &out, const char * name, const char * type, int32_t value)
+{
+  printMetricType(out, name, type);
+  out.print(METRICS_PREFIX);
+  out.print(name);
+  out.print(' ');
+  out.println((long)value);
+}
+
+void printMetric(Print &out, const char * name, const char * type, uint32_t value)
+{
+  printMetricType(out, name, type);
+  out.print(METRICS_PREFIX);
+  out.print(name);
+  out.print(' ');
+  out.println((unsigned long)value);
+}
+
+void printLabelledMetric(Print &out, const char * name, const char * label, const char * labelValue, uint32_t value)
+{
+  out.print(METRICS_PREFIX);
+  out.print(name);
+  out.print('{');
+  out.print(label);
+  out.print("=\"");
+  out.print(labelValue);
+  out.print("\"} ");
+  out.println((unsigned long)value);
+}
+
+void printHistogram(Print &out, const char * name, const DurationHistogram &histogram)
+{
+  uint32_t cumulative = 0;
+
+  printMetricType(out, name, "histogram");
+
+  for (uint8_t i = 0; i < DURATION_BUCKETS; i++)
+  {
+    cumulative += histogram.counts[i];
+
+    out.print(METRICS_PREFIX);
+    out.print(name);
+    out.print("_bucket{le=\"");
+    if (i < DURATION_BUCKETS - 1)
+    {
+      out.print((unsigned long)kDurationBuckets[i]);
+    }
+    else
+    {
+      out.print("+Inf");
+    }
+    out.print("\"} ");
+    out.println((unsigned long)cumulative);
+  }
+
+  out.print(METRICS_PREFIX);
+  out.print(name);
+  out.print("_sum ");
+  out.println((unsigned long long)histogram.sum);
+
+  out.print(METRICS_PREFIX);
+  out.print(name);
+  out.print("_count ");
+  out.println((unsigned long)histogram.count);
+}
@@ -0,0 +1,138 @@
+#include "PixelPayload.h"
+
+struct PixelPayload
+{
+  LedFrame * frame;
+  uint8_t stride; //3 for RGB, 4 for RGB + brightness
+  uint8_t pixel[4];
+  size_t count;
+};
+
+static uint8_t getPixelStride(size_t len)
+{
+  if (len == PIXEL_PAYLOAD_RGB_LEN)
+  {
+    return 3;
+  }
+  if (len == PIXEL_PAYLOAD_RGBB_LEN)
+  {
+    return 4;
+  }
+  return 0;
+}
+
+//Returns the 6 bit value of a base64 character, either alphabet, or -1 if it isn't one
+static int8_t getBase64Value(char c)
+{
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+' || c == '-' || c == ' ') return 62;
+  if (c == '/' || c == '_') return 63;
+  return -1;
+}
+
+static bool isBase64Filler(char c)
+{
+  return c == '=' || c == '\r' || c == '\n' || c == '\t';
+}
+
+//Each complete pixel goes straight into the LED frame
+static void pushPixelByte(PixelPayload &payload, uint8_t value)
+{
+  uint8_t channel = payload.count % payload.stride;
+
+  payload.pixel[channel] = value;
+  payload.count++;
+
+  if (channel == payload.stride - 1)
+  {
+    //Brightness stays 0-255 here, LedFrame splits it with the gamma corrected color into the 5-bit global current
+    //and the 8-bit PWM when the frame is rebuilt. Without a brightness byte the pixel is at full brightness.
+    uint8_t brightness = payload.stride == 4 ? payload.pixel[3] : LED_FULL_BRIGHTNESS;
+    payload.frame->setPixel(payload.count / payload.stride - 1, payload.pixel[0], payload.pixel[1], payload.pixel[2], brightness);
+  }
+}
+
+bool setPixelsFromPayload(LedFrame &frame, const char * data, size_t len, bool base64)
+{
+  PixelPayload payload = {};
+
+  payload.frame = &frame;
+
+  if (!base64)
+  {
+    payload.stride = getPixelStride(len);
+
+    if (!payload.stride)
+    {
+      return false;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+      pushPixelByte(payload, data[i]);
+    }
+
+    return true;
+  }
+
+  //First pass only validates and counts so a bad payload never touches the frame
+  size_t sextets = 0;
+  int8_t last = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if (isBase64Filler(data[i]))
+    {
+      continue;
+    }
+
+    last = getBase64Value(data[i]);
+
+    if (last < 0)
+    {
+      return false;
+    }
+
+    sextets++;
+  }
+
+  //A group of 4 characters is 3 bytes, 2 or 3 characters are 1 or 2 bytes with 4 or 2 bits left over, which
+  //have to be 0. A single character can't make a byte at all.
+  uint8_t leftoverBits = sextets * 6 % 8;
+
+  if (sextets % 4 == 1 || (last & ((1 << leftoverBits) - 1)))
+  {
+    return false;
+  }
+
+  payload.stride = getPixelStride(sextets * 6 / 8);
+
+  if (!payload.stride)
+  {
+    return false;
+  }
+
+  uint32_t bits = 0;
+  uint8_t bitCount = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if (isBase64Filler(data[i]))
+    {
+      continue;
+    }
+
+    bits = (bits << 6) | getBase64Value(data[i]);
+    bitCount += 6;
+
+    if (bitCount >= 8)
+    {
+      bitCount -= 8;
+      pushPixelByte(payload, (bits >> bitCount) & 0xFF);
+    }
+  }
+
+  return true;
+}
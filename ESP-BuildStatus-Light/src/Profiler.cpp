@@ -0,0 +1,104 @@
+#include "Profiler.h"
+
+#ifdef PROFILING
+
+#include <string.h>
+
+Profiler _profiler;
+
+Profiler::Profiler()
+{
+  reset();
+}
+
+void Profiler::reset()
+{
+  memset(_ring, 0, sizeof(_ring));
+  memset(_names, 0, sizeof(_names));
+  memset(_counts, 0, sizeof(_counts));
+  memset(_max, 0, sizeof(_max));
+  memset(_total, 0, sizeof(_total));
+  memset(_min, 0xFF, sizeof(_min));
+  _head = 0;
+  _ringCount = 0;
+}
+
+void Profiler::record(uint8_t span, const char * name, uint32_t cycles)
+{
+  if (span >= PROFILE_SPAN_COUNT)
+  {
+    return;
+  }
+
+  ProfileSample &sample = _ring[_head];
+  sample.cycles = cycles;
+  sample.span = span;
+  _head = (_head + 1) & (PROFILE_RING_SIZE - 1);
+
+  if (_ringCount < PROFILE_RING_SIZE)
+  {
+    _ringCount++;
+  }
+
+  _names[span] = name;
+  _counts[span]++;
+  _total[span] += cycles;
+
+  if (cycles < _min[span])
+  {
+    _min[span] = cycles;
+  }
+
+  if (cycles > _max[span])
+  {
+    _max[span] = cycles;
+  }
+}
+
+void Profiler::print(Print &out)
+{
+  uint32_t perMicro = profileCyclesPerMicro();
+
+  out.println("Span, count, min uS, avg uS, p99 uS, max uS");
+
+  for (uint8_t span = 0; span < PROFILE_SPAN_COUNT; span++)
+  {
+    uint16_t samples = 0;
+    uint32_t p99 = 0;
+
+    if (!_counts[span])
+    {
+      continue;
+    }
+
+    //Insertion sort the ring's samples for this span, there are only a few hundred at most
+    for (uint16_t i = 0; i < _ringCount; i++)
+    {
+      if (_ring[i].span != span)
+      {
+        continue;
+      }
+
+      uint32_t cycles = _ring[i].cycles;
+      uint16_t j = samples++;
+
+      while (j > 0 && _scratch[j - 1] > cycles)
+      {
+        _scratch[j] = _scratch[j - 1];
+        j--;
+      }
+
+      _scratch[j] = cycles;
+    }
+
+    if (samples)
+    {
+      p99 = _scratch[(samples * 99 + 99) / 100 - 1];
+    }
+
+    out.printf("%s, %u, %u, %u, %u, %u\n", _names[span] ? _names[span] : "?", (unsigned)_counts[span], (unsigned)(_min[span] / perMicro),
+      (unsigned)(_total[span] / _counts[span] / perMicro), (unsigned)(p99 / perMicro), (unsigned)(_max[span] / perMicro));
+  }
+}
+
+#endif
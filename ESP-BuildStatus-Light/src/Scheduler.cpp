@@ -0,0 +1,104 @@
+#include "Scheduler.h"
+
+#include <string.h>
+
+Scheduler::Scheduler(SchedulerClock clock)
+{
+  _clock = clock;
+  _taskCount = 0;
+  memset(_tasks, 0, sizeof(_tasks));
+}
+
+int8_t Scheduler::addTask(const char * name, TaskFunction function, uint32_t period, uint32_t budget)
+{
+  if (_taskCount >= MAX_SCHEDULER_TASKS)
+  {
+    return -1;
+  }
+
+  SchedulerTask &task = _tasks[_taskCount];
+
+  task.name = name;
+  task.function = function;
+  task.period = period;
+  task.budget = budget;
+  task.deadline = _clock();
+
+  return _taskCount++;
+}
+
+bool Scheduler::run(uint32_t now)
+{
+  SchedulerTask *next = 0;
+  uint32_t nextLateness = 0;
+
+  //Earliest deadline first among the tasks that are due. Wrap-safe since lateness is a difference.
+  for (uint8_t i = 0; i < _taskCount; i++)
+  {
+    uint32_t lateness = now - _tasks[i].deadline;
+
+    if ((int32_t)lateness >= 0 && (!next || lateness > nextLateness))
+    {
+      next = &_tasks[i];
+      nextLateness = lateness;
+    }
+  }
+
+  if (!next)
+  {
+    return false;
+  }
+
+  uint32_t start = _clock();
+  next->function();
+  uint32_t duration = _clock() - start;
+
+  if (next->runs == 0 || nextLateness < next->minLatency)
+  {
+    next->minLatency = nextLateness;
+  }
+
+  next->runs++;
+  next->totalLatency += nextLateness;
+
+  if (nextLateness > next->maxLatency)
+  {
+    next->maxLatency = nextLateness;
+  }
+
+  if (duration > next->maxDuration)
+  {
+    next->maxDuration = duration;
+  }
+
+  if (duration > next->budget)
+  {
+    next->overruns++;
+  }
+
+  //Keep the cadence, but don't try to catch up on whole periods that were missed. The next deadline and every
+  //one up to now are dropped.
+  next->deadline += next->period;
+
+  if ((int32_t)(now - next->deadline) >= (int32_t)next->period)
+  {
+    next->skipped += (now - next->deadline) / next->period + 1;
+    next->deadline = now + next->period;
+  }
+
+  return true;
+}
+
+void Scheduler::resetStats()
+{
+  for (uint8_t i = 0; i < _taskCount; i++)
+  {
+    _tasks[i].runs = 0;
+    _tasks[i].overruns = 0;
+    _tasks[i].skipped = 0;
+    _tasks[i].maxDuration = 0;
+    _tasks[i].minLatency = 0;
+    _tasks[i].maxLatency = 0;
+    _tasks[i].totalLatency = 0;
+  }
+}
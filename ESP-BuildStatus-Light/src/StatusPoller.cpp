@@ -0,0 +1,343 @@
+#include "StatusPoller.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char * const _defaultFields[PollFieldCount] = { "status", "branch", "author" };
+
+const char * getPollResultName(PollResult result)
+{
+  static const char * const names[PollResultCount] = { "changed", "not_modified", "failed" };
+
+  return result < PollResultCount ? names[result] : "";
+}
+
+StatusPoller::StatusPoller(PollHandler handler)
+{
+  _handler = handler;
+  _state = PollIdle;
+  _url[0] = '\0';
+  _host[0] = '\0';
+  _path = _url;
+  _port = 80;
+  _address = 0;
+  _resolved = false;
+  _interval = 0;
+  _lastPoll = 0;
+  _due = false;
+  _etag[0] = '\0';
+  _lastStatusCode = 0;
+  _maxConnectWait = 0;
+  memset(_counts, 0, sizeof(_counts));
+
+  for (uint8_t i = 0; i < PollFieldCount; i++)
+  {
+    strcpy(_fields[i], _defaultFields[i]);
+    _fieldPaths[i] = _fields[i];
+  }
+
+  _scanner.setFields(_fieldPaths, PollFieldCount);
+}
+
+bool StatusPoller::configure(const char * url, uint16_t urlLen, uint32_t interval)
+{
+  static const char scheme[] = "http://";
+  const char * host;
+  const char * hostEnd;
+  const char * colon;
+  long port = 80;
+
+  if (urlLen >= POLL_URL_SIZE || urlLen <= sizeof(scheme) - 1 || strncasecmp(url, scheme, sizeof(scheme) - 1) != 0)
+  {
+    return false;
+  }
+
+  host = url + sizeof(scheme) - 1;
+  hostEnd = (const char *)memchr(host, '/', url + urlLen - host);
+  hostEnd = hostEnd ? hostEnd : url + urlLen;
+  colon = (const char *)memchr(host, ':', hostEnd - host);
+
+  if (colon)
+  {
+    port = strtol(colon + 1, NULL, 10);
+    hostEnd = colon;
+  }
+
+  if (hostEnd == host || hostEnd - host >= POLL_HOST_SIZE || port < 1 || port > 0xFFFF)
+  {
+    return false;
+  }
+
+  if (_state != PollIdle)
+  {
+    _client.stop();
+    _state = PollIdle;
+  }
+
+  memcpy(_url, url, urlLen);
+  _url[urlLen] = '\0';
+  memcpy(_host, host, hostEnd - host);
+  _host[hostEnd - host] = '\0';
+  _port = port;
+  _path = strchr(_url + sizeof(scheme) - 1, '/');
+  _path = _path ? _path : "/";
+  _address = 0;
+  //The interval is in seconds and compared in ms, so this also keeps it from overflowing
+  _interval = interval ? min(max(interval, (uint32_t)POLL_MIN_INTERVAL), (uint32_t)POLL_MAX_INTERVAL) : 0;
+  //A new URL is a different document
+  _etag[0] = '\0';
+  _due = true;
+
+  return true;
+}
+
+bool StatusPoller::setField(PollField field, const char * path, uint16_t len)
+{
+  if (len >= POLL_FIELD_SIZE)
+  {
+    return false;
+  }
+
+  memcpy(_fields[field], path, len);
+  _fields[field][len] = '\0';
+  //What was fetched before may have had the new field in it
+  _etag[0] = '\0';
+
+  return true;
+}
+
+//Runs in lwIP's context. A lookup for a host that has since been replaced is ignored.
+void StatusPoller::onResolved(const char * name, const ip_addr_t * address, void * arg)
+{
+  StatusPoller * poller = (StatusPoller *)arg;
+
+  if (poller->_state != PollResolving || strcmp(name, poller->_host) != 0)
+  {
+    return;
+  }
+
+  poller->_address = address && IP_IS_V4(address) ? ip4_addr_get_u32(ip_2_ip4(address)) : 0;
+  poller->_resolved = true;
+}
+
+void StatusPoller::start(uint32_t now)
+{
+  ip_addr_t address;
+  err_t result;
+
+  _lastPoll = now;
+  _startedAt = now;
+  _due = false;
+
+  if (_address)
+  {
+    connect(now);
+    return;
+  }
+
+  //Answers from lwIP's cache, or an IP literal, come straight back. Anything else calls onResolved later.
+  _resolved = false;
+  _state = PollResolving;
+  result = dns_gethostbyname(_host, &address, onResolved, this);
+
+  if (result == ERR_OK)
+  {
+    _address = IP_IS_V4(&address) ? ip4_addr_get_u32(ip_2_ip4(&address)) : 0;
+    _resolved = true;
+  }
+  else if (result != ERR_INPROGRESS)
+  {
+    _resolved = true;
+  }
+}
+
+void StatusPoller::connect(uint32_t now)
+{
+  bool connected;
+
+  _client.setTimeout(POLL_CONNECT_TIMEOUT);
+  connected = _client.connect(IPAddress(_address), _port);
+  _maxConnectWait = max(_maxConnectWait, (uint32_t)(millis() - now));
+
+  if (!connected)
+  {
+    //The host may have moved, so the next poll looks it up again
+    _address = 0;
+    fail();
+    return;
+  }
+
+  //Small pieces, Nagle puts them together into one packet
+  _client.print("GET ");
+  _client.print(_path);
+  _client.print(" HTTP/1.0\r\nHost: ");
+  _client.print(_host);
+  _client.print("\r\nAccept: application/json\r\nUser-Agent: ESP-BuildStatus-Light\r\n");
+
+  if (_etag[0])
+  {
+    _client.print("If-None-Match: ");
+    _client.print(_etag);
+    _client.print("\r\n");
+  }
+
+  _client.print("\r\n");
+
+  _state = PollStatusLine;
+  _startedAt = now;
+  _lineLen = 0;
+  _statusCode = 0;
+  _newEtag[0] = '\0';
+}
+
+//The whole document has been read. Without a status it doesn't count and the ETag isn't kept, so it's fetched again.
+void StatusPoller::complete()
+{
+  if (!_scanner.isFound(PollStatus))
+  {
+    finish(PollFailed);
+    return;
+  }
+
+  _handler(_scanner);
+  strcpy(_etag, _newEtag);
+  finish(PollChanged);
+}
+
+//Failed before there was a response
+void StatusPoller::fail()
+{
+  _state = PollIdle;
+  _counts[PollFailed]++;
+  _lastStatusCode = 0;
+}
+
+void StatusPoller::finish(PollResult result)
+{
+  _client.stop();
+  _state = PollIdle;
+  _counts[result]++;
+  _lastStatusCode = _statusCode;
+}
+
+//One status or header line, without the line ending
+void StatusPoller::handleLine()
+{
+  if (_state == PollStatusLine)
+  {
+    const char * space = strchr(_line, ' ');
+
+    _statusCode = strncmp(_line, "HTTP/1.", 7) == 0 && space ? atoi(space + 1) : 0;
+    _state = PollHeaders;
+    return;
+  }
+
+  if (_lineLen == 0)
+  {
+    //End of the headers
+    if (_statusCode == 304)
+    {
+      finish(PollNotModified);
+    }
+    else if (_statusCode == 200)
+    {
+      _scanner.reset();
+      _state = PollBody;
+    }
+    else
+    {
+      finish(PollFailed);
+    }
+    return;
+  }
+
+  if (strncasecmp(_line, "ETag:", 5) == 0)
+  {
+    const char * value = _line + 5;
+
+    while (*value == ' ')
+    {
+      value++;
+    }
+
+    //A cut short ETag would never match, so it's better not to send one
+    if (_lineLen < POLL_LINE_SIZE - 1 && strlen(value) < POLL_ETAG_SIZE)
+    {
+      strcpy(_newEtag, value);
+    }
+  }
+}
+
+void StatusPoller::poll(uint32_t now)
+{
+  char buffer[POLL_READ_SIZE];
+  int count;
+
+  if (_state == PollIdle)
+  {
+    if (_interval && _host[0] && (_due || now - _lastPoll >= _interval * 1000))
+    {
+      start(now);
+    }
+    return;
+  }
+
+  if (_state == PollResolving)
+  {
+    if (_resolved && _address)
+    {
+      connect(now);
+    }
+    else if (_resolved || now - _startedAt > POLL_TIMEOUT)
+    {
+      fail();
+    }
+    return;
+  }
+
+  count = _client.available();
+
+  if (count <= 0)
+  {
+    if (!_client.connected())
+    {
+      //Closed before the document was complete, or the headers ended
+      finish(PollFailed);
+    }
+    else if (now - _startedAt > POLL_TIMEOUT)
+    {
+      finish(PollFailed);
+    }
+    return;
+  }
+
+  count = _client.read((uint8_t *)buffer, count < POLL_READ_SIZE ? count : POLL_READ_SIZE);
+
+  for (int i = 0; i < count && _state != PollIdle; i++)
+  {
+    if (_state == PollBody)
+    {
+      if (!_scanner.feed(buffer + i, count - i))
+      {
+        finish(PollFailed);
+      }
+      else if (_scanner.isDone())
+      {
+        complete();
+      }
+      break;
+    }
+
+    if (buffer[i] == '\n')
+    {
+      _line[_lineLen] = '\0';
+      handleLine();
+      _lineLen = 0;
+    }
+    else if (buffer[i] != '\r' && _lineLen < POLL_LINE_SIZE - 1)
+    {
+      _line[_lineLen++] = buffer[i];
+    }
+  }
+}
@@ -0,0 +1,149 @@
+#include "TokenTable.h"
+
+#include <string.h>
+#include <bearssl/bearssl.h>
+
+static_assert((TOKEN_SLOTS & (TOKEN_SLOTS - 1)) == 0, "TOKEN_SLOTS must be a power of two.");
+static_assert(TOKEN_SLOTS > TOKEN_CAPACITY, "There has to be an empty slot to end every probe.");
+
+//Looks at every byte whatever the first difference is
+static bool digestsEqual(const uint8_t * a, const uint8_t * b)
+{
+  uint8_t diff = 0;
+
+  for (uint8_t i = 0; i < TOKEN_DIGEST_SIZE; i++)
+  {
+    diff |= a[i] ^ b[i];
+  }
+
+  return diff == 0;
+}
+
+TokenTable::TokenTable(TokenEntries &entries) : _entries(entries)
+{
+  memset(_slots, 0, sizeof(_slots));
+  _count = 0;
+}
+
+void TokenTable::hashToken(const char * token, size_t len, uint8_t digest[TOKEN_DIGEST_SIZE])
+{
+  br_sha256_context context;
+  uint8_t hash[32];
+
+  br_sha256_init(&context);
+  br_sha256_update(&context, token, len);
+  br_sha256_out(&context, hash);
+  memcpy(digest, hash, TOKEN_DIGEST_SIZE);
+}
+
+void TokenTable::clear()
+{
+  memset(&_entries, 0, sizeof(_entries));
+  memset(_slots, 0, sizeof(_slots));
+  _count = 0;
+}
+
+void TokenTable::load()
+{
+  _count = 0;
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    _count += has(i);
+  }
+
+  rebuild();
+}
+
+bool TokenTable::set(uint16_t index, const uint8_t digest[TOKEN_DIGEST_SIZE])
+{
+  if (index >= TOKEN_CAPACITY)
+  {
+    return false;
+  }
+
+  memcpy(_entries.digests[index], digest, TOKEN_DIGEST_SIZE);
+
+  if (has(index))
+  {
+    //Its old slot is somewhere along another probe, simplest to lay the slots out again
+    rebuild();
+  }
+  else
+  {
+    _entries.used[index / 8] |= 1 << (index % 8);
+    _count++;
+    insert(index);
+  }
+
+  return true;
+}
+
+void TokenTable::remove(uint16_t index)
+{
+  if (!has(index))
+  {
+    return;
+  }
+
+  _entries.used[index / 8] &= ~(1 << (index % 8));
+  _count--;
+  memset(_entries.digests[index], 0, TOKEN_DIGEST_SIZE);
+  //Emptying the slot in place would cut short the probes running through it
+  rebuild();
+}
+
+int TokenTable::find(const char * token, size_t len)
+{
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  hashToken(token, len, digest);
+
+  return findDigest(digest);
+}
+
+int TokenTable::findDigest(const uint8_t digest[TOKEN_DIGEST_SIZE])
+{
+  for (uint16_t slot = getHome(digest); _slots[slot]; slot = (slot + 1) & (TOKEN_SLOTS - 1))
+  {
+    uint16_t index = _slots[slot] - 1;
+
+    if (digestsEqual(_entries.digests[index], digest))
+    {
+      return index;
+    }
+  }
+
+  return -1;
+}
+
+//The digest is already uniformly spread, so its first bytes do as the hash
+uint16_t TokenTable::getHome(const uint8_t digest[TOKEN_DIGEST_SIZE])
+{
+  return (digest[0] | (digest[1] << 8)) & (TOKEN_SLOTS - 1);
+}
+
+void TokenTable::insert(uint16_t index)
+{
+  uint16_t slot = getHome(_entries.digests[index]);
+
+  while (_slots[slot])
+  {
+    slot = (slot + 1) & (TOKEN_SLOTS - 1);
+  }
+
+  _slots[slot] = index + 1;
+}
+
+void TokenTable::rebuild()
+{
+  memset(_slots, 0, sizeof(_slots));
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    if (has(i))
+    {
+      insert(i);
+    }
+  }
+}
@@ -1,10 +1,27 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
-#include <ESP8266WebServer.h>
+#include <WiFiUdp.h>
 #include <ESP8266mDNS.h>
 #include <SPI.h>
+#include <lwip/dhcp.h>
 #include "LiquidCrystal.h"
+#include "LedFrame.h"
+#include "LedEffects.h"
+#include "PixelPayload.h"
+#include "MessagePages.h"
+#include "Scheduler.h"
+#include "CommandArgs.h"
+#include "CommandTable.h"
+#include "ChunkWriter.h"
+#include "JsonWriter.h"
+#include "HttpServer.h"
+#include "ControlProtocol.h"
+#include "StatusPoller.h"
+#include "TokenTable.h"
+#include "ConfigStore.h"
+#include "Metrics.h"
+#include "Profiler.h"
 #include <FS.h>
 
 
@@ -12,11 +29,10 @@
 #define MAX_INPUT_LEN 256
 
 #define LED_SPI_SPEED 1000000
-#define LED_COUNT   24
-#define LED_START_BYTE 0xE0 //first byte of the 32 bits for each APA102c LED. Needs to start with 0b111xxxxx where xxxxx is the brightness
-#define LED_LUM 0x07
+#define LED_DEFAULT_BRIGHTNESS 160 //0-255, about what the old fixed 5-bit level of 7 gave once colors are gamma corrected
 #define LED_SPI_MOSI  13
 #define LED_SPI_SLK   14
+#define MAX_ZONES 8
 
 #define LCD_COLS 20
 #define LCD_ROWS 4
@@ -28,38 +44,106 @@
 #define LCD_D6     4
 #define LCD_D7     15
 
+#define CONFIG_FILE_A "configA.bin"
+#define CONFIG_FILE_B "configB.bin"
+#define CONFIG_VERSION 1 //only for changes to Config that adding fields at the end can't cover
+
+//Older firmware kept its settings in these, they are moved into the config on the first boot
 #define SETTINGS_FILE "settings.txt"
 #define USER_ID_FILE "userIds.txt"
+#define TOKEN_FILE "tokens.bin"
 #define PASSWORD_FILE "password.bin"
+#define POLL_FILE "poll.txt"
 
 #define KEY "f72de5a6-2195-4e4b-9e35-76e21c6a4ddb"
 
 
-#define USER_ID_COUNT 16
-#define USER_ID_MAX_LEN 36
-
 #define DEFAULT_USER_ID "18096604-508b-422b-b58c-fe22f43c89d0"
 
+#define SSID_SIZE 33 //32 characters, the most WiFi allows
+#define WIFI_PW_SIZE 65 //64 characters, the longest WPA2 passphrase
+
 #define SERVER_PORT 80
-#define MAX_WIFI_CONNECT_RETRY_TIME 20
+#define UDP_CONTROL_PORT 4210 //binary control frames, see ControlProtocol.h. 0 turns the listener off
+#define MAX_WIFI_CONNECT_RETRY_TIME 20 //seconds for a connect with a scan
+#define WIFI_FAST_CONNECT_TIME 5 //seconds for a connect to the cached AP, then it falls back to a scan
+#define WIFI_RETRY_MIN_DELAY 1000 //ms after the first failed connect, doubling after each one after that
+#define WIFI_RETRY_MAX_DELAY 60000 //ms
+#define WIFI_MAX_LEASE_REUSE 86400 //seconds a DHCP lease is reused for, however long the server gave it for
 
 #define SCROLL_SPEED 20 //10 * 100ms = 1s
 #define IP_DISPLAY_TIME 30 //30 * 100ms = 3s
 #define FLASH_SPEED 5 //5 * 100ms = 0.5s
 
-#define MAX_MESSAGE_LEN 240 //characters
+#define RESPONSE_CHUNK_SIZE 512 //streamed HTTP replies go out this many bytes at a time, other replies are sent whole up to it
+#define SKIP_UNCHANGED_PAGES true //don't redraw a scroll page the LCD is already showing
+
+//Scheduler task periods and budgets, all in uS
+#define TICK_TASK_PERIOD 10000 //checks for 100ms timer ticks
+#define TICK_TASK_BUDGET 2000
+#define EFFECT_TASK_PERIOD 20000
+#define EFFECT_TASK_BUDGET 1000
+#define LCD_TASK_PERIOD 50000
+#define LCD_TASK_BUDGET 1000
+#define SERIAL_TASK_PERIOD 20000
+#define SERIAL_TASK_BUDGET 5000
+#define IP_TASK_PERIOD 100000 //IP_DISPLAY_TIME counts these
+#define IP_TASK_BUDGET 500
+#define MDNS_TASK_PERIOD 100000
+#define MDNS_TASK_BUDGET 5000
+#define POLL_TASK_PERIOD 20000
+#define POLL_TASK_BUDGET 2000 //apart from connecting, which counts as an overrun, see POLL_CONNECT_TIMEOUT
+#define WIFI_TASK_PERIOD 100000
+#define WIFI_TASK_BUDGET 2000
 
 struct Settings
 {
-  String ssid;
-  String pw;
+  char ssid[SSID_SIZE];
+  char pw[WIFI_PW_SIZE]; //XORed with KEY while in flash
   bool useDHCP;
-  String ipAddress;
-  String subnet;
-  String gateway;
+  uint32_t ipAddress; //the static addresses are 0 with DHCP
+  uint32_t subnet;
+  uint32_t gateway;
+};
+
+struct PollSettings
+{
+  char url[POLL_URL_SIZE];
+  uint32_t interval;
+  uint8_t zone;
+  char fields[PollFieldCount][POLL_FIELD_SIZE];
+};
+
+//The AP that worked last time, so the next connect can skip the scan
+struct WifiCache
+{
+  uint8_t bssid[6];
+  uint8_t channel; //0 if nothing is cached
+};
+
+//The last DHCP lease, so a reconnect can skip DHCP while the lease is still good. Only kept in RAM:
+//how long the light was off can't be known, so the first connect after a start always asks DHCP.
+struct WifiLease
+{
+  uint32_t ipAddress; //0 if there's no lease that can be reused
+  uint32_t subnet;
+  uint32_t gateway;
+  uint32_t dns;
+  uint32_t reuseTime; //seconds from start it can be reused for
+  uint32_t start; //millis when it was bound
+};
+
+//Everything kept in flash, read in one go at boot and written whole on every change. See ConfigStore.
+//New fields go at the end, so a config saved by older firmware still loads.
+struct Config
+{
+  Settings settings;
+  TokenEntries tokens;
+  PollSettings poll;
+  WifiCache wifi;
 };
 
-enum DisplayStates
+enum DisplayStates : uint8_t
 {
   StartDisplayingColor,
   FlashingColor,
@@ -68,6 +152,15 @@ enum DisplayStates
   DoNothing,
 };
 
+enum WifiStates : uint8_t
+{
+  WifiIdle,
+  WifiStartConnecting,
+  WifiConnecting,
+  WifiConnected,
+  WifiWaitingToRetry,
+};
+
 enum DisplayIpStates
 {
   StartDisplayingIp,
@@ -76,35 +169,52 @@ enum DisplayIpStates
   DoNothingIp,
 };
 
-class LinkedStrings
-{
-  public:
-    String value;
-    LinkedStrings * next;
+//Each zone is a run of LEDs with its own color, effect and timers. One array per field, indexed by zone,
+//so the tick loops walk each field in order and a zone costs no more than its LEDs.
+struct DisplayZones
+{
+  uint8_t count;
+  uint8_t first[MAX_ZONES];
+  uint8_t length[MAX_ZONES];
+  DisplayStates state[MAX_ZONES];
+  bool flashOn[MAX_ZONES];
+  uint flashTimer[MAX_ZONES];
+  int flashTime[MAX_ZONES];
+  int displayTime[MAX_ZONES];
+  uint32_t startTime[MAX_ZONES];
+  LedEffectParams effect[MAX_ZONES]; //holds the zone's color too
 };
 
-LinkedStrings _messageListHead;
-uint _lineCount = 0;
-bool _smallMessageDisplayed = false;
+static_assert(MESSAGE_COLS == LCD_COLS && MESSAGE_PAGE_ROWS == LCD_ROWS, "Message pages must match the LCD");
+
 os_timer_t _displayTimer;
 void timerCallback(void *pArg);
+void handleHTTPRequest(HttpRequest &request);
 void(* resetFunc) (void) = 0;//declare reset function at address 0
 LiquidCrystal _lcd(LCD_RS, LCD_EN, LCD_D4, LCD_D5, LCD_D6, LCD_D7);
-ESP8266WebServer server(SERVER_PORT);
-Settings _settings;
-String _userIds[USER_ID_COUNT];
+LedFrame _ledFrame;
+HttpServer _httpServer(SERVER_PORT);
+Config _config = {};
+ConfigStore _configStore(CONFIG_FILE_A, CONFIG_FILE_B, CONFIG_VERSION);
+TokenTable _tokens(_config.tokens);
 bool _wasRestartedSinceSettingsUpdate = true;
 os_timer_t _myTimer;
-DisplayStates _displayState = DoNothing;
+volatile uint _pendingTicks = 0;
+Scheduler _scheduler(micros);
 DisplayIpStates _displayIpState = DoNothingIp;
-int _flashTime = 0;
-int _displayTime = 0;
-uint8_t _redVal = 0;
-uint8_t _greenVal = 0;
-uint8_t _blueVal = 0;
-String _displayMessage;
+DisplayZones _zones = {};
+MessagePages _message;
 uint _startingMessageIndex = 0;
 bool _messageEnabled = false;
+char _serialLine[MAX_INPUT_LEN + 1];
+uint _serialLineLen = 0;
+char _responseChunk[RESPONSE_CHUNK_SIZE];
+DurationHistogram _tickDurations = {};
+uint32_t _wifiConnects = 0;
+uint32_t _wifiDisconnects = 0;
+WiFiEventHandler _wifiGotIpHandler;
+WiFiEventHandler _wifiDisconnectedHandler;
+uint32_t _httpNotFound = 0;
 
 /********Utility Method Region*/
 String getLine(File file)
@@ -120,34 +230,31 @@ String getLine(File file)
     return line;      
 }
 
-char * xorString(const char * value, uint len)
+//In place, so doing it twice gives back the value
+void xorString(char * value, uint len)
 {
+  static const char key[] = KEY;
   uint j = 0;
 
-  char *cypher = (char *) malloc(sizeof(char) * len);
-  String key = KEY;
-  uint keyLen = key.length();
-
-  for (uint i = 0; i < len; i++)  
+  for (uint i = 0; i < len; i++)
   {
-    cypher[i] = value[i] ^ key[j];
+    value[i] ^= key[j];
     j++;
 
-    if (j == keyLen)
+    if (j == sizeof(key) - 1)
     {
       j = 0;
     }
   }
-
-  return cypher;
 }
 
 void loadDefaultUserId()
 {
-  for (uint8_t i = 0; i < USER_ID_COUNT; i++)
-  {
-    _userIds[i] = DEFAULT_USER_ID;
-  }
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  TokenTable::hashToken(DEFAULT_USER_ID, strlen(DEFAULT_USER_ID), digest);
+  _tokens.clear();
+  _tokens.set(0, digest);
 }
 
 IPAddress convertStringToIPAddress(String ipString)
@@ -163,243 +270,116 @@ IPAddress convertStringToIPAddress(String ipString)
   return 0;
 }
 
-int findStringIgnoreCase(String source, String toFind, uint startIndex = 0)
-{
-
-  uint index = startIndex;
-  uint sourceLen = source.length();
-  uint toFindLen = toFind.length();
-
-  while(index + toFindLen < sourceLen)
-  {
-
-    if (source.substring(index, index + toFindLen).equalsIgnoreCase(toFind))
-    {
-      return index;
-    }
+/********End Utility Method Region*/
 
-    index++;
-  }
 
-  return -1;
-}
 
-//Attempts to get a value from the input string for the given key. Returns nothing if not found or value is not surrounded by = and ;
-String getValueFromInputString(String input, String key)
+//Copies the message into the fixed buffer and rewraps it. Nothing is allocated, the same arrays are reused every time.
+void setDisplayMessage(const char *message, uint len)
 {
-  String value;
-  int index;
-  int endIndex;
-
-  //Jump out right away incase the input is empty so we don't have to worry about it causing any problems.
-  if (input.isEmpty())
+  if (len == 0)
   {
-    return value;
+    _lcd.clear();
   }
 
-  //First find the index of the key
-  index = findStringIgnoreCase(input, key + "=");
+  _message.set(message, len);
+  _startingMessageIndex = 0;
+  _messageEnabled = _message.pageCount() > 0;
 
 #ifdef DEBUG
-  Serial.printf("Index found at %d\n", index);
-#endif
-
-  if (index < 0)
-  {
-    return value;
-  }
-
-  //Need to move to the next index so we are at the start of the value
-  index += key.length() + 1;
-
-  //Find the end of the value, should be the next ;
-  endIndex = input.indexOf(";", index);
-
-  //If the endIndex <= index, there is no value
-  if (endIndex <= index)
+  for(uint i = 0; i < _message.lineCount(); i++)
   {
-    return value;
+    Serial.printf("%.*s\n", _message.line(i).len, _message.text() + _message.line(i).offset);
   }
-
-#ifdef DEBUG
-
-  Serial.print(key);
-  Serial.print(": ");
-  Serial.println(input.substring(index, endIndex));
-
 #endif
-
-  return input.substring(index, endIndex);
-
 }
 
-/********End Utility Method Region*/
-
-
-
-//This method creates a Linked List of strings that represent the lines to display on the LCD.
-//
-void createDisplayLinesFromMessage()
+//Constant time, the pages were rendered when the message was set
+void scrollMessage()
 {
-  uint charIndex = 0;
-  uint startCharIndex = 0;
-  uint lastWhiteSpaceIndex = 0;
-  uint len = _displayMessage.length();
-  LinkedStrings *currentLine = &_messageListHead;
-  char currentChar;
+  PROFILE_SCOPE(SpanScroll, "scroll message");
 
-  _startingMessageIndex = 0;
-  _messageListHead.value.clear();
-  _messageListHead.next = 0;
-  _lineCount = 0;
-  _smallMessageDisplayed = false;
-  _messageEnabled = false;
-
-  while(len)
+  if (_startingMessageIndex >= _message.pageCount())
   {
-    currentChar = _displayMessage[charIndex];
-    
-    if (currentChar == ' ')
-    {
-      lastWhiteSpaceIndex = charIndex;
-    }
+    _startingMessageIndex = 0;
+  }
 
-    //We have enough characters for a line
-    if (currentLine->value.length() == LCD_COLS - 1)
-    {
-      // Serial.printf("Line %d before: %s\n", _lineCount, currentLine->value.c_str());
+  _lcd.drawPage(_message.page(_startingMessageIndex), LCD_COLS, LCD_ROWS, !SKIP_UNCHANGED_PAGES);
 
-      //If we have found another white space before the end of this line, we should truncate the string there.    
-      if (lastWhiteSpaceIndex > 0)
-      {
-    
-        currentLine->value = currentLine->value.substring(0, lastWhiteSpaceIndex - startCharIndex);
-        
-        charIndex = lastWhiteSpaceIndex + 1;
-        lastWhiteSpaceIndex = 0;  
+  //restart once we reached the end
+  if (++_startingMessageIndex >= _message.pageCount())
+  {
+    _startingMessageIndex = 0;
+  }
+}
 
-      }
 
-      //Settings startCharIndex so we can calculate the end index of the next line if we split on a whit space
-      startCharIndex = charIndex;
 
-      //Then we create a new Line and link it
-      currentLine->next = new LinkedStrings();
-      currentLine = currentLine->next;
-      _lineCount++;
-    }
-    else
-    {
-      currentLine->value += currentChar;
-      charIndex++;
 
-      //We have reached the end of the message
-      if (charIndex >= len)
-      {
-        _lineCount++;
 
-#ifdef DEBUG
-          currentLine = &_messageListHead;
-          for(uint i = 0; i < _lineCount; i++)
-          {
-
-            Serial.println(currentLine->value);
-            currentLine = currentLine->next;
-            
-          }
-#endif
-        _messageEnabled = true;
-        return;
-        
-      }
+//All LED output goes through _ledFrame, which only sends when something actually changed.
+//This draws the zone's color with its effect into the frame, so it is called every tick while the color is showing.
+//Nothing goes out until the caller shows the frame, once for all the zones.
+void showDisplayColor(uint8_t zone)
+{
+  PROFILE_SCOPE(SpanShowColor, "show color");
 
-    }
-  }
+  renderLedEffect(_zones.effect[zone], millis() - _zones.startTime[zone], _ledFrame, _zones.first[zone], _zones.length[zone]);
 }
 
-void scrollMessage()
+void clearZone(uint8_t zone)
 {
-  LinkedStrings *currentLine = &_messageListHead;
-
-  //This avoids re-displaying a message that is less than LCD_ROWS in lenght
-  // if (_smallMessageDisplayed)
-  // {
-  //   return;
-  // }
-
-  if (_lineCount >= LCD_ROWS - 1 && _startingMessageIndex > 0)
-  {
-
-    //First move to start of message;
-    for (uint i = 0; i < _startingMessageIndex; i++)
-    {
-      currentLine = currentLine->next;
-    }
-  }
-  // else
-  // {
-  //   _smallMessageDisplayed = true;
-  // }
-  _lcd.clear();
-
-  for(uint i = 0; i < LCD_ROWS && currentLine; i++)
+  for (uint8_t i = 0; i < _zones.length[zone]; i++)
   {
-    _lcd.setCursor(0, i);
-    _lcd.write(currentLine->value.c_str());
-    currentLine = currentLine->next;
-    
-  }
-
-  if (_lineCount > LCD_ROWS)
-  {
-    _startingMessageIndex++;
-  }
-  //restart one we reached the end. 
-  //Because we are going all the way to _lineCount insteadn of _lineCount - COL_ROWS, the last line will scroll to the top before the message repeates.
-  if (_startingMessageIndex >= _lineCount)
-  {
-    _startingMessageIndex = 0;
+    _ledFrame.setPixel(_zones.first[zone] + i, 0, 0, 0);
   }
 }
 
+//Sets the effect and brightness for the zone's next color. A progress or brightness < 0 means full.
+void startDisplayEffect(uint8_t zone, LedEffect effect, long period, bool eased, long progress, long brightness)
+{
+  LedEffectParams &params = _zones.effect[zone];
 
+  params.effect = effect;
+  params.period = period > 0 ? min(period, 0xFFFFL) : DEFAULT_EFFECT_PERIOD;
+  params.eased = eased;
+  params.progress = progress < 0 ? 100 : min(progress, 100L);
+  params.brightness = brightness < 0 ? LED_FULL_BRIGHTNESS : min(brightness, 255L);
 
-
-
-//APA 102c start of frame: 0x00000000
-void sendLED_SoF()
-{
-  SPI.transfer(0x00);
-  SPI.transfer(0x00);
-  SPI.transfer(0x00);
-  SPI.transfer(0x00);
+  //Fades start from whatever is showing right now
+  _ledFrame.getPixel(_zones.first[zone], params.fromRed, params.fromGreen, params.fromBlue);
 }
 
-//APA 102c end of frame: 0xFF00
-void sendLED_EoF()
+//Splits the strip into zones of the given lengths from the first LED on. Every zone starts off, with the
+//effect defaults UPDATEDISPLAY keeps when it isn't sent them.
+void setZones(const uint8_t *lengths, uint8_t count)
 {
-  SPI.transfer(0xFF);
-  SPI.transfer(0x00);
-}
+  uint8_t first = 0;
 
-void setFullDisplayColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t lum = LED_LUM, uint8_t ledCount = LED_COUNT)
-{
-   sendLED_SoF();
-  
-  for(uint8_t i = 0; i < LED_COUNT; i++)
+  memset(&_zones, 0, sizeof(_zones));
+  _zones.count = count;
+
+  for (uint8_t i = 0; i < count; i++)
   {
-    SPI.transfer(LED_START_BYTE | (lum & 0b00011111));
-    SPI.transfer(blue); //Blue
-    SPI.transfer(green); //Green
-    SPI.transfer(red); //Red
+    _zones.first[i] = first;
+    _zones.length[i] = lengths[i];
+    _zones.state[i] = DoNothing;
+    _zones.effect[i].period = DEFAULT_EFFECT_PERIOD;
+    _zones.effect[i].progress = 100;
+    _zones.effect[i].brightness = LED_FULL_BRIGHTNESS;
+    first += lengths[i];
   }
 
-  sendLED_EoF(); 
+  _ledFrame.clear();
+  _ledFrame.show();
 }
 
-void clearDisplay()
+//One zone over the whole strip, which behaves just like before there were zones
+void initZones()
 {
-   setFullDisplayColor(0, 0, 0, 0, LED_COUNT);
+  uint8_t length = LED_COUNT;
+
+  setZones(&length, 1);
 }
 
 
@@ -413,200 +393,351 @@ void clearDisplay()
 
 
 
-void handleHttpRoot()
+
+int rootHandler(const CommandArgs &args, Print &out)
 {  
-  server.send(200, "text/plain", "ESP BuildStatus Light v1.0, 2020");
+  out.print("ESP BuildStatus Light v1.0, 2020");
+  return 200;
 }
 
-void handleNotFound()
+void sendText(HttpRequest &request, int status, const char *text)
 {
-  server.send(404, "Oops. Looks like you entered a bad URL.");
+  request.send(status, "text/plain", text, strlen(text));
 }
 
-bool isUserIdValid(String userId)
+void handleNotFound(HttpRequest &request)
 {
-  
-  if (!userId.isEmpty())
-  {
-    for(uint i = 0; i < USER_ID_COUNT; i++)
-    {
-      if (!_userIds[i].isEmpty() && _userIds[i].equals(userId))
-      {
-        return true;
-      }
-    }
-  }
-  return false;
+  sendText(request, 404, "Oops. Looks like you entered a bad URL.");
 }
 
-void getDisplayStatus()
+bool isUserIdValid(const char *userId, uint len)
 {
-  String returnMsg = "Red: " + String(_redVal) + " Green: " + String(_greenVal) + " Blue: " + String(_blueVal) + " FlashTime left: " + String(_flashTime)
-    + " DisplayTime left: " + String(_displayTime) + " Message: " + _displayMessage;
-  server.send(200, returnMsg.c_str());
+  return len > 0 && _tokens.find(userId, len) >= 0;
 }
 
+//HTTP callers have always sent 1 or true
+bool isArgTrue(const CommandArgs &args, CommandKey key)
+{
+  return args.equalsIgnoreCase(key, "1") || args.equalsIgnoreCase(key, "TRUE");
+}
 
-
-void startSetDisplayColor(uint8_t red, uint8_t green, uint8_t blue)
+//ZONE=<1-n> picks one zone, without it a command applies to every zone. Returns false if there is no such zone.
+bool getZoneArg(const CommandArgs &args, uint8_t &first, uint8_t &last)
 {
-  _flashTime = server.arg("flashtime").toInt();
-  _displayTime = server.arg("displaytime").toInt();
-  _redVal = red;
-  _greenVal = green;
-  _blueVal = blue;
-  //if neither time was set, default to full on infinite.
-  if (!_flashTime && !_displayTime)
+  long zone = args.getInt(KeyZone);
+
+  if (!args.has(KeyZone))
   {
-    _displayTime = -1;
+    first = 0;
+    last = _zones.count - 1;
+    return true;
   }
 
-  _displayState = StartDisplayingColor;
+  if (zone < 1 || zone > _zones.count)
+  {
+    return false;
+  }
 
-  getDisplayStatus();
+  first = zone - 1;
+  last = zone - 1;
+  return true;
 }
 
-void setDisplayRed()
+int printZoneError(Print &out)
 {
-  startSetDisplayColor(128, 0, 0);
+  out.printf("ZONE must be 1 to %d. Nothing updated.\n", _zones.count);
+  return 400;
 }
 
-void setDisplayGreen()
+//EffectNone if no EFFECT was given, EffectCount if it isn't known
+LedEffect getEffectArg(const CommandArgs &args)
 {
-  startSetDisplayColor(0, 128, 0);
-}
+  uint16_t len;
+  const char *name = args.get(KeyEffect, len);
 
-void setDisplayBlue()
-{
-  startSetDisplayColor(0, 0, 128);
+  return name ? getLedEffect(name, len) : EffectNone;
 }
 
-void setDisplayYellow()
+void startEffectFromArgs(const CommandArgs &args, uint8_t zone, LedEffect effect)
 {
-  startSetDisplayColor(64, 32, 0);
+  startDisplayEffect(zone, effect, args.getInt(KeyPeriod), isArgTrue(args, KeyEase),
+    args.has(KeyProgress) ? args.getInt(KeyProgress) : -1, args.has(KeyBrightness) ? args.getInt(KeyBrightness) : -1);
 }
 
-void setDisplayPurple()
+uint32_t getUptimeSeconds()
 {
-  startSetDisplayColor(64, 0, 32);
+  return micros64() / 1000000;
 }
 
-void setDisplayWhite()
+//The display part of every status reply, into whatever object the caller has open
+void writeDisplayStatus(JsonWriter &json)
 {
-  startSetDisplayColor(32, 32, 32);
+  json.beginArray("zones");
+
+  for (uint8_t i = 0; i < _zones.count; i++)
+  {
+    json.beginObject();
+    json.addUint("zone", i + 1);
+    json.addUint("firstLed", _zones.first[i] + 1);
+    json.addUint("lastLed", _zones.first[i] + _zones.length[i]);
+    json.addUint("red", _zones.effect[i].red);
+    json.addUint("green", _zones.effect[i].green);
+    json.addUint("blue", _zones.effect[i].blue);
+    json.addInt("flashTimeLeft", _zones.flashTime[i]);
+    json.addInt("displayTimeLeft", _zones.displayTime[i]);
+    json.addString("effect", getLedEffectName(_zones.effect[i].effect));
+    json.endObject();
+  }
+
+  json.endArray();
+  json.addUint("brightness", _ledFrame.getBrightness());
+  json.addString("message", _message.text(), _message.length());
 }
 
-void setDisplayOff()
+int getDisplayStatusHandler(const CommandArgs &args, Print &out)
 {
-  //Make sure everything is cleared out
-  _redVal = 0;
-  _greenVal = 0;
-  _blueVal = 0;
-  _displayTime = 0;
-  _flashTime = 0;
-  _displayState = StopDisplayingColor;
-  clearDisplay();
+  JsonWriter json(out);
+
+  json.beginObject();
+  writeDisplayStatus(json);
+  json.addUint("uptime", getUptimeSeconds());
+  json.endObject();
+  out.println();
 
-  getDisplayStatus();
+  return 200;
 }
 
-void setDisplayColor()
+void startDisplayingColor(uint8_t zone, uint8_t red, uint8_t green, uint8_t blue, int flashTime, int displayTime)
 {
-  startSetDisplayColor(server.arg("red").toInt() & 0xFF, server.arg("green").toInt() & 0xFF, server.arg("blue").toInt() & 0xFF);
+  _zones.flashTime[zone] = flashTime;
+  _zones.displayTime[zone] = displayTime;
+  _zones.effect[zone].red = red;
+  _zones.effect[zone].green = green;
+  _zones.effect[zone].blue = blue;
+  //if neither time was set, default to full on infinite.
+  if (!flashTime && !displayTime)
+  {
+    _zones.displayTime[zone] = -1;
+  }
+
+  _zones.state[zone] = StartDisplayingColor;
 }
 
-void setDisplayMessage()
+//Returns false, with nothing changed, if the effect isn't known
+bool applyDisplayColor(const CommandArgs &args, uint8_t first, uint8_t last, uint8_t red, uint8_t green, uint8_t blue)
 {
-  _displayMessage = server.arg("message");
+  LedEffect effect = getEffectArg(args);
 
-
-  
-  if (_displayMessage.length() == 0)
+  if (effect == EffectCount)
   {
-    _lcd.clear();
+    return false;
   }
-  else
-  {
-    if (_displayMessage.length() > MAX_MESSAGE_LEN)
-    {
-      _displayMessage = _displayMessage.substring(0, MAX_MESSAGE_LEN - 1);
-    }
 
-    createDisplayLinesFromMessage();
+  for (uint8_t zone = first; zone <= last; zone++)
+  {
+    startEffectFromArgs(args, zone, effect);
+    startDisplayingColor(zone, red, green, blue, args.getInt(KeyFlashTime), args.getInt(KeyDisplayTime));
   }
 
-  getDisplayStatus();
-
+  return true;
 }
 
-
-void handleHTTPRequest(void (*requestHandler)())
+int startSetDisplayColor(const CommandArgs &args, Print &out, uint8_t red, uint8_t green, uint8_t blue)
 {
-  if (requestHandler == 0)
+  uint8_t first;
+  uint8_t last;
+
+  if (!getZoneArg(args, first, last))
   {
-    handleNotFound();
-    return;
+    return printZoneError(out);
   }
 
-  if (!isUserIdValid(server.arg("userid")))
+  if (!applyDisplayColor(args, first, last, red, green, blue))
   {
-    server.send(401, "The User Id was missing or was not a valid User Id.");
-    return;
+    out.print("Unknown effect. Use none, fade, breathe, chase, comet or progress.");
+    return 400;
   }
-  
-  requestHandler();
 
-  
+  return getDisplayStatusHandler(args, out);
 }
 
-void handleSetDisplayRed()
+//One handler per fixed color, e.g. setDisplayPresetHandler<128, 0, 0> for red
+template <uint8_t red, uint8_t green, uint8_t blue>
+int setDisplayPresetHandler(const CommandArgs &args, Print &out)
 {
-  handleHTTPRequest(setDisplayRed);
+  return startSetDisplayColor(args, out, red, green, blue);
 }
 
-void handleSetDisplayGreen()
+int setDisplayOffHandler(const CommandArgs &args, Print &out)
 {
-  handleHTTPRequest(setDisplayGreen);
-}
+  uint8_t first;
+  uint8_t last;
 
-void handleSetDisplayBlue()
-{
-  handleHTTPRequest(setDisplayBlue);
+  if (!getZoneArg(args, first, last))
+  {
+    return printZoneError(out);
+  }
+
+  //Make sure everything is cleared out
+  for (uint8_t zone = first; zone <= last; zone++)
+  {
+    _zones.effect[zone].red = 0;
+    _zones.effect[zone].green = 0;
+    _zones.effect[zone].blue = 0;
+    _zones.effect[zone].effect = EffectNone;
+    _zones.displayTime[zone] = 0;
+    _zones.flashTime[zone] = 0;
+    _zones.state[zone] = StopDisplayingColor;
+    clearZone(zone);
+  }
+
+  _ledFrame.show();
+
+  return getDisplayStatusHandler(args, out);
 }
 
-void handleSetDisplayYellow()
+int setDisplayColorHandler(const CommandArgs &args, Print &out)
 {
-  handleHTTPRequest(setDisplayYellow);
+  return startSetDisplayColor(args, out, args.getInt(KeyRed) & 0xFF, args.getInt(KeyGreen) & 0xFF, args.getInt(KeyBlue) & 0xFF);
 }
 
-void handleSetDisplayPurple()
+//The channel's value if it was sent, otherwise what the zone already has
+uint8_t getColorArg(const CommandArgs &args, CommandKey key, uint8_t current)
 {
-  handleHTTPRequest(setDisplayPurple);
+  return args.has(key) ? args.getInt(key) : current;
 }
 
-void handleSetDisplayWhite()
+//The range UPDATEDISPLAY takes for each numeric key, checked before anything changes
+struct DisplayArgRange
 {
-  handleHTTPRequest(setDisplayWhite);
-}
+  CommandKey key;
+  long min;
+  long max;
+};
 
-void handleSetDisplayOff()
+static const DisplayArgRange _displayArgRanges[] =
 {
-  handleHTTPRequest(setDisplayOff);
-}
+  { KeyRed, 0, 255 },
+  { KeyGreen, 0, 255 },
+  { KeyBlue, 0, 255 },
+  { KeyBrightness, 0, 255 },
+  { KeyProgress, 0, 100 },
+  { KeyPeriod, MIN_EFFECT_PERIOD, 0xFFFF },
+  { KeyFlashTime, INT16_MIN, INT16_MAX },
+  { KeyDisplayTime, INT16_MIN, INT16_MAX },
+};
 
-void handleSetDisplayColor()
+//Color, effect, times and message in one request. Everything is checked before anything changes, so the LEDs
+//and the LCD never show half an update. Only the parts that were sent are changed: a zone keeps its own color
+//channels, effect, period, easing, progress, brightness and time left for any key that wasn't sent.
+int updateDisplayHandler(const CommandArgs &args, Print &out)
 {
-  handleHTTPRequest(setDisplayColor);
+  static const CommandKey displayKeys[] = { KeyRed, KeyGreen, KeyBlue, KeyFlashTime, KeyDisplayTime, KeyEffect, KeyPeriod, KeyEase, KeyProgress, KeyBrightness };
+  uint16_t messageLen;
+  const char *message = args.get(KeyMessage, messageLen);
+  LedEffect effect = getEffectArg(args);
+  bool updateColor = false;
+  uint8_t first;
+  uint8_t last;
+
+  if (!getZoneArg(args, first, last))
+  {
+    return printZoneError(out);
+  }
+
+  for (uint i = 0; i < sizeof(_displayArgRanges) / sizeof(_displayArgRanges[0]); i++)
+  {
+    const DisplayArgRange &range = _displayArgRanges[i];
+    long value = args.getInt(range.key);
+
+    if (args.has(range.key) && (value < range.min || value > range.max))
+    {
+      out.printf("%s must be %ld to %ld. Nothing updated.\n", getCommandKeyName(range.key), range.min, range.max);
+      return 400;
+    }
+  }
+
+  if (effect == EffectCount)
+  {
+    out.print("Unknown effect. Use none, fade, breathe, chase, comet or progress. Nothing updated.\n");
+    return 400;
+  }
+
+  for (uint i = 0; i < sizeof(displayKeys) / sizeof(displayKeys[0]); i++)
+  {
+    updateColor |= args.has(displayKeys[i]);
+  }
+
+  if (!updateColor && message == NULL)
+  {
+    out.print("No display params or MESSAGE in input. Nothing updated.\n");
+    return 400;
+  }
+
+  //Nothing can fail past this point
+  if (message != NULL)
+  {
+    setDisplayMessage(message, messageLen);
+  }
+
+  //Zones can differ in all of these, so each one is kept per zone. The zone's effect restarts either way.
+  //If neither time was sent and both have run out, the zone comes back on solid like SETDISPLAY without times.
+  if (updateColor)
+  {
+    for (uint8_t zone = first; zone <= last; zone++)
+    {
+      LedEffectParams current = _zones.effect[zone];
+      int flashTime = args.has(KeyFlashTime) ? args.getInt(KeyFlashTime) : _zones.flashTime[zone];
+      int displayTime = args.has(KeyDisplayTime) ? args.getInt(KeyDisplayTime) : _zones.displayTime[zone];
+
+      startDisplayEffect(zone, args.has(KeyEffect) ? effect : current.effect,
+        args.has(KeyPeriod) ? args.getInt(KeyPeriod) : current.period,
+        args.has(KeyEase) ? isArgTrue(args, KeyEase) : current.eased,
+        args.has(KeyProgress) ? args.getInt(KeyProgress) : current.progress,
+        args.has(KeyBrightness) ? args.getInt(KeyBrightness) : current.brightness);
+      startDisplayingColor(zone, getColorArg(args, KeyRed, current.red), getColorArg(args, KeyGreen, current.green),
+        getColorArg(args, KeyBlue, current.blue), flashTime, displayTime);
+    }
+  }
+
+  out.print("OK\n");
+  return 200;
 }
 
-void handleSetDisplayMessage()
+bool showPixelPayload(const char *data, uint len, bool base64)
 {
-  handleHTTPRequest(setDisplayMessage);
+  if (!setPixelsFromPayload(_ledFrame, data, len, base64))
+  {
+    return false;
+  }
+
+  //The pattern stays up until something else sets the display
+  for (uint8_t zone = 0; zone < _zones.count; zone++)
+  {
+    _zones.flashTime[zone] = 0;
+    _zones.displayTime[zone] = 0;
+    _zones.state[zone] = DoNothing;
+  }
+
+  _ledFrame.show();
+
+  return true;
 }
 
-void handleGetDisplayStatus()
+//Takes the pixels from the "data" arg or the request body. Base64 unless encoding=raw.
+int setDisplayPixelsHandler(const CommandArgs &args, Print &out)
 {
-  handleHTTPRequest(getDisplayStatus);
+  uint16_t len;
+  const char *data = args.has(KeyData) ? args.get(KeyData, len) : args.get(KeyPlain, len);
+  bool base64 = !args.equalsIgnoreCase(KeyEncoding, "raw");
+
+  if (data == NULL || !showPixelPayload(data, len, base64))
+  {
+    out.print("Expected 72 (RGB) or 96 (RGB + brightness) bytes of pixel data.");
+    return 400;
+  }
+
+  return 204;
 }
 
  
@@ -621,8 +752,11 @@ void initLCD()
 {
   
   _lcd.begin(20 ,4);
+  //Everything after this draws into the LCD's shadow buffer and only reaches the panel on flush()
+  _lcd.setBuffered(true);
   _lcd.clear();
   _lcd.home();
+  _lcd.flush();
 
   Serial.println("LCD Initialized.");
 }
@@ -633,7 +767,10 @@ void initLED_SPI()
   digitalWrite(13, 1);
   //SPI.setFrequency(LED_SPI_SPEED);
   SPI.begin();
-  clearDisplay();
+  //Force the first frame out since we don't know what the LEDs powered up showing
+  _ledFrame.setBrightness(LED_DEFAULT_BRIGHTNESS);
+  _ledFrame.clear();
+  _ledFrame.show(true);
   Serial.println("LED display Initialized.");
 }
 
@@ -658,87 +795,509 @@ void initTimer()
   Serial.println("Timer started.");
 }
 
-bool initWifi(Settings settings)
+/********WiFi Region*/
+
+WifiStates _wifiState = WifiIdle;
+uint32_t _wifiStateStart = 0; //millis
+uint32_t _wifiRetryDelay = 0; //ms
+uint8_t _wifiFailures = 0; //in a row, reset once connected
+bool _wifiFastConnect = false;
+bool _wifiUsingLease = false; //connected on a reused lease, without a DHCP client running
+bool _wifiCacheChanged = false; //saved by loop() once no task is due
+WifiLease _wifiLease = {};
+bool _networkStarted = false;
+uint32_t _wifiFastConnects = 0;
+uint32_t _wifiConnectFailures = 0;
+
+void initHTTPServer();
+void initUdpControl();
+bool saveConfig();
+
+void onWifiGotIP(const WiFiEventStationModeGotIP &event)
+{
+  _wifiConnects++;
+}
+
+void onWifiDisconnected(const WiFiEventStationModeDisconnected &event)
 {
-  int retrySeconds = 0;
-  WiFi.mode(WIFI_STA);
+  _wifiDisconnects++;
+}
+
+void setWifiState(WifiStates state)
+{
+  _wifiState = state;
+  _wifiStateStart = millis();
+}
+
+//Seconds the DHCP server gave the current lease for, 0 if there isn't one. The station is lwIP's default netif.
+uint32_t getDhcpLeaseTime()
+{
+  struct dhcp *dhcp = netif_default ? netif_dhcp_data(netif_default) : NULL;
+
+  return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+//Called every run of the wifi task, so millis() can't wrap past the end of a lease unnoticed
+void expireWifiLease()
+{
+  if (_wifiLease.ipAddress && (millis() - _wifiLease.start) / 1000 >= _wifiLease.reuseTime)
+  {
+    _wifiLease.ipAddress = 0;
+  }
+}
+
+//Joins the AP that worked last time on its channel, skipping the scan, and with DHCP it takes the last lease
+//instead of asking again while that lease is still good. If that doesn't work the next try is a full one.
+void startWifiConnect()
+{
+  const Settings &settings = _config.settings;
+  const WifiCache &cache = _config.wifi;
+
+  _wifiFastConnect = cache.channel && _wifiFailures == 0;
+  _wifiUsingLease = settings.useDHCP && _wifiFastConnect && _wifiLease.ipAddress;
 
   if (!settings.useDHCP)
   {
 #ifdef DEBUG
-    Serial.println("IP: '" + settings.ipAddress + "' Gateway: '" + settings.gateway + "' Subnet: '" + settings.subnet + "'");
+    Serial.println("IP: '" + IPAddress(settings.ipAddress).toString() + "' Gateway: '" + IPAddress(settings.gateway).toString() + "' Subnet: '" + IPAddress(settings.subnet).toString() + "'");
 #endif
-    WiFi.config(convertStringToIPAddress(settings.ipAddress), convertStringToIPAddress(settings.gateway), convertStringToIPAddress(settings.subnet));
+    WiFi.config(IPAddress(settings.ipAddress), IPAddress(settings.gateway), IPAddress(settings.subnet));
+  }
+  else if (_wifiUsingLease)
+  {
+    WiFi.config(IPAddress(_wifiLease.ipAddress), IPAddress(_wifiLease.gateway), IPAddress(_wifiLease.subnet), IPAddress(_wifiLease.dns));
+  }
+  else
+  {
+    //All zeros goes back to DHCP
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  }
 
+  if (_wifiFastConnect)
+  {
+    WiFi.begin(settings.ssid, settings.pw, cache.channel, cache.bssid);
+    _wifiFastConnects++;
+  }
+  else
+  {
+    WiFi.begin(settings.ssid, settings.pw);
   }
 
-  WiFi.begin(settings.ssid, settings.pw);
-  
-  Serial.print("Connecting to '" + settings.ssid + "'.");
+  Serial.printf("Connecting to '%s'%s.\n", settings.ssid, _wifiFastConnect ? " on the last AP" : "");
 
-  _lcd.setCursor(0, 0);
-  _lcd.write("Connecting to ");
-  _lcd.setCursor(0, 1);
-  _lcd.write(settings.ssid.c_str());
-  _lcd.setCursor(0, 2);
+  //Once running, the LCD keeps showing whatever it was showing
+  if (!_networkStarted)
+  {
+    _lcd.clear();
+    _lcd.write("Connecting to ");
+    _lcd.setCursor(0, 1);
+    _lcd.write(settings.ssid);
+  }
 
-  // Wait for connection
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(1000);
+  setWifiState(WifiConnecting);
+}
 
-    if (retrySeconds++ >= MAX_WIFI_CONNECT_RETRY_TIME)
-    {
-      _lcd.clear();
-      _lcd.write("Could not connect");
-      Serial.println("Could not connect.");
-      return false;
-    }
-    else
-    {
-        _lcd.write(".");
-        Serial.print(".");
-    }
+//Saving the whole config is a flash write, so it's only flagged when the AP changed and loop() writes it
+void updateWifiCache()
+{
+  WifiCache cache = {};
+
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+
+  if (memcmp(&cache, &_config.wifi, sizeof(cache)) != 0)
+  {
+    _config.wifi = cache;
+    _wifiCacheChanged = true;
   }
 
+  //A reused lease keeps its start, it's no newer than when DHCP gave it out
+  if (_config.settings.useDHCP && !_wifiUsingLease)
+  {
+    _wifiLease.ipAddress = WiFi.localIP();
+    _wifiLease.subnet = WiFi.subnetMask();
+    _wifiLease.gateway = WiFi.gatewayIP();
+    _wifiLease.dns = WiFi.dnsIP();
+    //Reused up to the point a DHCP client would renew it
+    _wifiLease.reuseTime = min(getDhcpLeaseTime() / 2, (uint32_t)WIFI_MAX_LEASE_REUSE);
+    _wifiLease.start = millis();
+  }
+}
+
+void onWifiConnected()
+{
   Serial.println("Connected.");
   Serial.println("IP: " + WiFi.localIP().toString());
 
+  _wifiFailures = 0;
+  updateWifiCache();
+  setWifiState(WifiConnected);
+
+  if (_networkStarted)
+  {
+    return;
+  }
+
   _lcd.clear();
   _lcd.write("Connected.");
   _displayIpState = StartDisplayingIp;
 
-  if (settings.useDHCP)
+  if (_config.settings.useDHCP)
   {
     Serial.println("Using DHCP.");
     _lcd.setCursor(0, 2);
     _lcd.write("Using DHCP.");
   }
- 
+
+  initHTTPServer();
+  initUdpControl();
+  _networkStarted = true;
+}
+
+void onWifiConnectFailed()
+{
+  WiFi.disconnect();
+  _wifiConnectFailures++;
+
+  //The AP may have moved or given the address to someone else, the next try scans and asks DHCP
+  if (_wifiFastConnect)
+  {
+    _wifiLease.ipAddress = 0;
+  }
+  _wifiRetryDelay = min((uint32_t)WIFI_RETRY_MIN_DELAY << min(_wifiFailures, (uint8_t)16), (uint32_t)WIFI_RETRY_MAX_DELAY);
+
+  if (_wifiFailures < 0xFF)
+  {
+    _wifiFailures++;
+  }
+
+  Serial.printf("Could not connect. Trying again in %u seconds.\n", (uint)(_wifiRetryDelay / 1000));
+
+  if (!_networkStarted)
+  {
+    _lcd.clear();
+    _lcd.write("Could not connect");
+  }
+
+  setWifiState(WifiWaitingToRetry);
+}
+
+//Runs from the scheduler, so the LEDs, LCD and serial console keep going while there's no connection
+void handleWifi()
+{
+  uint32_t elapsed = millis() - _wifiStateStart;
+
+  expireWifiLease();
+
+  switch (_wifiState)
+  {
+    case WifiIdle:
+      break;
+
+    case WifiStartConnecting:
+      startWifiConnect();
+      break;
+
+    case WifiConnecting:
+    {
+      wl_status_t status = WiFi.status();
+
+      if (status == WL_CONNECTED)
+      {
+        onWifiConnected();
+      }
+      else if (status == WL_CONNECT_FAILED || status == WL_WRONG_PASSWORD || (_wifiFastConnect && status == WL_NO_SSID_AVAIL) ||
+        elapsed >= (_wifiFastConnect ? WIFI_FAST_CONNECT_TIME : MAX_WIFI_CONNECT_RETRY_TIME) * 1000)
+      {
+        onWifiConnectFailed();
+      }
+      break;
+    }
+
+    case WifiConnected:
+      if (WiFi.status() != WL_CONNECTED)
+      {
+        Serial.println("WiFi connection lost.");
+        WiFi.disconnect();
+        setWifiState(WifiStartConnecting);
+      }
+      else if (_wifiUsingLease && !_wifiLease.ipAddress)
+      {
+        //Nothing renews a reused lease, so once it's as old as a renewal would be, DHCP takes over.
+        //All zeros starts the DHCP client without dropping the connection.
+        Serial.println("Reused lease is up, asking DHCP.");
+        _wifiUsingLease = false;
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      }
+      break;
+
+    case WifiWaitingToRetry:
+      if (elapsed >= _wifiRetryDelay)
+      {
+        setWifiState(WifiStartConnecting);
+      }
+      break;
+  }
+}
+
+//The connection is made by handleWifi(), this only gets it started
+void initWifi()
+{
+  WiFi.mode(WIFI_STA);
+  //The SDK would otherwise write the credentials to flash on every begin(), and reconnect on its own without the backoff
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+
+  //Only counted for /Metrics, the handlers have to be kept or they are unregistered
+  _wifiGotIpHandler = WiFi.onStationModeGotIP(onWifiGotIP);
+  _wifiDisconnectedHandler = WiFi.onStationModeDisconnected(onWifiDisconnected);
+
+  setWifiState(WifiStartConnecting);
+}
+
+/********End WiFi Region*/
+
+/********CI Poll Region*/
+
+//How a polled status shows, matched case-insensitively
+struct StatusColor
+{
+  const char *status;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+  LedEffect effect;
+};
+
+const StatusColor _statusColors[] =
+{
+  { "success", 0, 128, 0, EffectNone },
+  { "succeeded", 0, 128, 0, EffectNone },
+  { "passed", 0, 128, 0, EffectNone },
+  { "failure", 128, 0, 0, EffectNone },
+  { "failed", 128, 0, 0, EffectNone },
+  { "error", 128, 0, 0, EffectNone },
+  { "running", 64, 32, 0, EffectBreathe },
+  { "in_progress", 64, 32, 0, EffectBreathe },
+  { "pending", 64, 32, 0, EffectBreathe },
+  { "queued", 64, 32, 0, EffectBreathe },
+};
+
+//Anything not in _statusColors, e.g. canceled
+const StatusColor _unknownStatusColor = { NULL, 64, 0, 32, EffectNone };
+
+uint8_t _pollZone = 0; //0 for every zone
+
+//True if the zones already show the color and effect, and the LCD the message. A server without ETags sends
+//the whole document every poll, and starting the same status again would restart the scroll and the effects.
+bool isPollResultShowing(const StatusColor *color, uint8_t first, uint8_t last, const char *message, uint len)
+{
+  if (len != _message.length() || memcmp(message, _message.text(), len) != 0)
+  {
+    return false;
+  }
+
+  for (uint8_t zone = first; zone <= last; zone++)
+  {
+    const LedEffectParams &current = _zones.effect[zone];
+
+    if ((_zones.state[zone] != StartDisplayingColor && _zones.state[zone] != DisplayingColor) || current.effect != color->effect ||
+      current.red != color->red || current.green != color->green || current.blue != color->blue)
+    {
+      return false;
+    }
+  }
 
   return true;
+}
+
+//Shows a changed CI status through the same calls as the display commands
+void onPollResult(JsonScanner &scanner)
+{
+  const char *status = scanner.getValue(PollStatus);
+  const char *branch = scanner.getValue(PollBranch);
+  const char *author = scanner.getValue(PollAuthor);
+  const StatusColor *color = &_unknownStatusColor;
+  char message[MAX_MESSAGE_LEN + 1];
+  //The zones may have changed since the poll was set up
+  bool allZones = _pollZone == 0 || _pollZone > _zones.count;
+  uint8_t first = allZones ? 0 : _pollZone - 1;
+  uint8_t last = allZones ? _zones.count - 1 : _pollZone - 1;
+  int len;
+
+  for (uint i = 0; i < sizeof(_statusColors) / sizeof(_statusColors[0]); i++)
+  {
+    if (strcasecmp(_statusColors[i].status, status) == 0)
+    {
+      color = &_statusColors[i];
+      break;
+    }
+  }
+
+  //e.g. "main: success by Ann"
+  len = snprintf(message, sizeof(message), "%s%s%s%s%s", branch, *branch ? ": " : "", status, *author ? " by " : "", author);
+  len = min(len, MAX_MESSAGE_LEN);
+
+  if (isPollResultShowing(color, first, last, message, len))
+  {
+    return;
+  }
+
+  for (uint8_t zone = first; zone <= last; zone++)
+  {
+    startDisplayEffect(zone, color->effect, 0, false, -1, -1);
+    startDisplayingColor(zone, color->red, color->green, color->blue, 0, -1);
+  }
+
+  setDisplayMessage(message, len);
+}
+
+StatusPoller _poller(onPollResult);
+
+void handlePoll()
+{
+  //Connecting can only fail without WiFi, and it would wait out POLL_CONNECT_TIMEOUT every time
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    _poller.poll(millis());
+  }
+}
+
+/********End CI Poll Region*/
+
+/********UDP Control Region*/
 
+static_assert(TOKEN_DIGEST_SIZE == CONTROL_KEY_SIZE, "The control key is derived from the stored User Id digest.");
+
+WiFiUDP _udp;
+uint8_t _controlPacket[CONTROL_MAX_FRAME];
+
+//Token ids are the User Id indexes shown by GETUSERIDS, so only the first CONTROL_TOKEN_COUNT User Ids can send frames
+bool lookupControlKey(uint8_t tokenId, uint8_t key[CONTROL_KEY_SIZE])
+{
+  if (!_tokens.has(tokenId - 1))
+  {
+    return false;
+  }
 
+  deriveControlKey(_tokens.getDigest(tokenId - 1), key);
+  return true;
 }
 
+ControlReceiver _control(lookupControlKey);
+
+//Goes through the same calls as the HTTP handlers, so both leave the display in the same state
+ControlResult applyControlFrame(const ControlFrame &frame)
+{
+  const uint8_t *payload = frame.payload;
+  uint8_t first = frame.zone ? frame.zone - 1 : 0;
+  uint8_t last = frame.zone ? frame.zone - 1 : _zones.count - 1;
+
+  if (frame.zone > _zones.count)
+  {
+    return ControlBadPayload;
+  }
+
+  switch (frame.opcode)
+  {
+    case OpColor:
+      if (frame.payloadLen != CONTROL_COLOR_SIZE)
+      {
+        return ControlBadPayload;
+      }
+      for (uint8_t zone = first; zone <= last; zone++)
+      {
+        startDisplayEffect(zone, EffectNone, 0, false, -1, -1);
+        startDisplayingColor(zone, payload[0], payload[1], payload[2], (int16_t)readControlUint16(payload + 3), (int16_t)readControlUint16(payload + 5));
+      }
+      return ControlOk;
+
+    case OpEffect:
+      if (frame.payloadLen != CONTROL_EFFECT_SIZE || payload[0] >= EffectCount)
+      {
+        return ControlBadPayload;
+      }
+      //Runs on the current color, on until something else sets the display
+      for (uint8_t zone = first; zone <= last; zone++)
+      {
+        const LedEffectParams &current = _zones.effect[zone];
+
+        startDisplayEffect(zone, (LedEffect)payload[0], readControlUint16(payload + 2), payload[1] & 1, payload[4], payload[5]);
+        startDisplayingColor(zone, current.red, current.green, current.blue, 0, -1);
+      }
+      return ControlOk;
+
+    case OpPixels:
+      return showPixelPayload((const char *)payload, frame.payloadLen, false) ? ControlOk : ControlBadPayload;
+
+    case OpMessage:
+      setDisplayMessage((const char *)payload, frame.payloadLen);
+      return ControlOk;
+
+    default:
+      return ControlBadPayload;
+  }
+}
+
+//Called every pass of loop(), one packet at a time. Every frame is acked with its result.
+void handleUdpControl()
+{
+  int size = _udp.parsePacket();
+  ControlFrame frame;
+  ControlResult result;
+  uint8_t ack[CONTROL_ACK_SIZE];
+
+  if (size <= 0)
+  {
+    return;
+  }
+
+  if (size > CONTROL_MAX_FRAME)
+  {
+    _udp.flush();
+    memset(&frame, 0, sizeof(frame));
+    result = ControlBadFrame;
+    _control.count(result);
+  }
+  else
+  {
+    result = _control.receive(_controlPacket, _udp.read(_controlPacket, size), frame);
+
+    if (result == ControlOk)
+    {
+      result = applyControlFrame(frame);
+      _control.count(result);
+    }
+  }
+
+  buildControlAck(frame.sequence, _control.getBootId(), result, ack);
+  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+  _udp.write(ack, sizeof(ack));
+  _udp.endPacket();
+}
+
+void initUdpControl()
+{
+  //From the hardware RNG, so frames from before this start are never taken again
+  _control.begin(ESP.random());
+
+  if (UDP_CONTROL_PORT && _udp.begin(UDP_CONTROL_PORT))
+  {
+    Serial.printf("UDP control listening on port %d.\n", UDP_CONTROL_PORT);
+  }
+}
+
+/********End UDP Control Region*/
+
 void initHTTPServer()
 {
   if (MDNS.begin("esp-buildstatus-light")) 
   {
     Serial.println("MDNS responder started");
   }
-  server.on("/", handleHttpRoot);
-  server.on("/Display/Red", handleSetDisplayRed);
-  server.on("/Display/Green", handleSetDisplayGreen);
-  server.on("/Display/Blue", handleSetDisplayBlue);
-  server.on("/Display/Yellow", handleSetDisplayYellow);
-  server.on("/Display/Purple", handleSetDisplayPurple);
-  server.on("/Display/White", handleSetDisplayWhite);
-  server.on("/Display/Off", handleSetDisplayOff);  
-  server.on("/Display/Color", handleSetDisplayColor);  
-  server.on("/Display/Message", handleSetDisplayMessage); 
-  server.on("/Display", handleGetDisplayStatus);
-  server.onNotFound(handleNotFound);
-  server.begin();
+  //Routes come from the command table, see handleHTTPRequest()
+  _httpServer.onRequest(handleHTTPRequest);
+  _httpServer.begin();
 
   Serial.println("HTTP Server initialized.");
 }
@@ -751,93 +1310,214 @@ void initHTTPServer()
 
 
 
-String loadPassword()
+bool saveConfig()
 {
-  File f = SPIFFS.open(PASSWORD_FILE, "r");
-  String pwString;
-  uint i = 0;
-  uint len = f.size();
-  char pwChars[len];
-  char * newChars;
+  bool saved;
 
-  if (f)
+  //The password is only obscured while it's written
+  xorString(_config.settings.pw, sizeof(_config.settings.pw));
+  saved = _configStore.save(&_config, sizeof(_config));
+  xorString(_config.settings.pw, sizeof(_config.settings.pw));
+
+  Serial.println(saved ? "Settings saved." : "Settings could not be saved.");
+
+  return saved;
+}
+
+void applyPollSettings()
+{
+  for (uint8_t i = 0; i < PollFieldCount; i++)
   {
-    while(f.available())
+    if (_config.poll.fields[i][0])
     {
-      pwChars[i++] = f.read();
+      _poller.setField((PollField)i, _config.poll.fields[i], strlen(_config.poll.fields[i]));
     }
+  }
+
+  _pollZone = _config.poll.zone;
+  _poller.configure(_config.poll.url, strlen(_config.poll.url), _config.poll.interval);
+}
+
+bool loadLegacySettings()
+{
+  File f = SPIFFS.open(SETTINGS_FILE, "r");
+
+  if (!f)
+  {
+    return false;
+  }
+
+  strlcpy(_config.settings.ssid, getLine(f).c_str(), sizeof(_config.settings.ssid));
+  _config.settings.useDHCP = getLine(f).toInt();
 
-    newChars = xorString(pwChars, len);
+  if (!_config.settings.useDHCP)
+  {
+    _config.settings.ipAddress = convertStringToIPAddress(getLine(f));
+    _config.settings.subnet = convertStringToIPAddress(getLine(f));
+    _config.settings.gateway = convertStringToIPAddress(getLine(f));
+  }
+
+  f.close();
 
-    for (uint i = 0; i < len; i++)
+  f = SPIFFS.open(PASSWORD_FILE, "r");
+
+  if (f)
+  {
+    uint len = f.read((uint8_t *)_config.settings.pw, sizeof(_config.settings.pw) - 1);
+
+    xorString(_config.settings.pw, len);
+    f.close();
+  }
+
+  return true;
+}
+
+//Plain User Ids one per line, or from a little later, a record per User Id of its index then its digest
+bool loadLegacyUserIds()
+{
+  File f = SPIFFS.open(TOKEN_FILE, "r");
+  uint8_t record[1 + TOKEN_DIGEST_SIZE];
+
+  if (f)
+  {
+    while (f.read(record, sizeof(record)) == sizeof(record))
     {
-      pwString += newChars[i];
+      _tokens.set(record[0], record + 1);
     }
 
     f.close();
+    return true;
+  }
+
+  f = SPIFFS.open(USER_ID_FILE, "r");
+
+  if (!f)
+  {
+    return false;
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY && f.available(); i++)
+  {
+    String id = getLine(f);
+
+    if (!id.isEmpty())
+    {
+      TokenTable::hashToken(id.c_str(), id.length(), record);
+      _tokens.set(i, record);
+    }
   }
 
-  return pwString;
+  f.close();
 
+  return true;
 }
 
-bool loadSettings()
+bool loadLegacyPollSettings()
 {
-  File f = SPIFFS.open(SETTINGS_FILE, "r");
-
+  File f = SPIFFS.open(POLL_FILE, "r");
 
   if (!f)
   {
-    Serial.println("Settings file could not be read. It may not yet exist.");
     return false;
   }
 
-  _settings.ssid = getLine(f);
+  strlcpy(_config.poll.url, getLine(f).c_str(), sizeof(_config.poll.url));
+  _config.poll.interval = getLine(f).toInt();
+  _config.poll.zone = getLine(f).toInt();
 
-  _settings.useDHCP = getLine(f).toInt();
-  
-  if (!_settings.useDHCP)
+  for (uint8_t i = 0; i < PollFieldCount; i++)
+  {
+    strlcpy(_config.poll.fields[i], getLine(f).c_str(), sizeof(_config.poll.fields[i]));
+  }
+
+  f.close();
+
+  return true;
+}
+
+//The text files are only removed once the config holding them is safely written
+bool migrateLegacyFiles()
+{
+  static const char * const files[] = { SETTINGS_FILE, PASSWORD_FILE, USER_ID_FILE, TOKEN_FILE, POLL_FILE };
+  bool found = loadLegacySettings();
+
+  found = loadLegacyUserIds() || found;
+  found = loadLegacyPollSettings() || found;
+
+  if (!found)
+  {
+    return false;
+  }
+
+  if (_tokens.getCount() == 0)
+  {
+    loadDefaultUserId();
+  }
+
+  if (saveConfig())
+  {
+    for (uint8_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+      SPIFFS.remove(files[i]);
+    }
+  }
+
+  return true;
+}
+
+//One read into _config, falling back to the files older firmware wrote
+void loadConfig()
+{
+  if (_configStore.load(&_config, sizeof(_config)))
+  {
+    xorString(_config.settings.pw, sizeof(_config.settings.pw));
+    Serial.println("Settings loaded.");
+  }
+  else if (migrateLegacyFiles())
+  {
+    Serial.println("Settings moved from the old text files.");
+  }
+  else
   {
-    _settings.ipAddress = getLine(f);
-    _settings.subnet = getLine(f);
-    _settings.gateway = getLine(f);
+    Serial.println("Settings could not be read. They may not yet exist. Using default Id.");
+    loadDefaultUserId();
   }
 
-  f.close();
+  _tokens.load();
+  applyPollSettings();
 
-  _settings.pw = loadPassword();
+  Serial.printf("%d User Ids loaded.\n", _tokens.getCount());
+}
 
-  Serial.println("Settings loaded.");
 
-  return true;
-}
 
 
 
-void loadUserIds()
-{
-  File f = SPIFFS.open(USER_ID_FILE, "r");
-  String pw;
 
-  if (!f)
-  {
-    Serial.println("User Ids file could not be read. Using default Id.");   
-    loadDefaultUserId();
-    return;
-  }
 
-  for (uint8_t i = 0; i < USER_ID_COUNT; i++)
-  {
-    _userIds[i] = getLine(f);
-  }
 
-  f.close();
 
-  Serial.println("User Ids loaded.");   
 
+void saveSettings()
+{
+    saveConfig();
+
+    _wasRestartedSinceSettingsUpdate = false;
 }
 
+void savePollSettings()
+{
+    strlcpy(_config.poll.url, _poller.getUrl(), sizeof(_config.poll.url));
+    _config.poll.interval = _poller.getInterval();
+    _config.poll.zone = _pollZone;
+
+    for (uint8_t i = 0; i < PollFieldCount; i++)
+    {
+      strlcpy(_config.poll.fields[i], _poller.getField((PollField)i), sizeof(_config.poll.fields[i]));
+    }
 
+    saveConfig();
+}
 
 
 
@@ -846,116 +1526,163 @@ void loadUserIds()
 
 
 
-void savePassword(String password)
+int restartHandler(const CommandArgs &args, Print &out)
 {
-  uint len = password.length();
+  _wasRestartedSinceSettingsUpdate = true;
+  ESP.restart();
+  return 200;
+}
 
-  char * xorPW = xorString(password.c_str(), len);
-  File f = SPIFFS.open(PASSWORD_FILE, "w+");
+int setDisplayHandler(const CommandArgs &args, Print &out)
+{
+  LedEffect effect = getEffectArg(args);
+  uint8_t first;
+  uint8_t last;
 
-  for (uint i = 0; i < len; i++)
+  if (!getZoneArg(args, first, last))
   {
-    f.write(xorPW[i]);
+    out.printf("ZONE must be 1 to %d. Display not updated.\n", _zones.count);
+    return 400;
   }
 
-  f.close();
+  if (effect == EffectCount)
+  {
+    out.println("EFFECT was not recognized. Display not updated.");
+    return 400;
+  }
 
+  for (uint8_t zone = first; zone <= last; zone++)
+  {
+    startEffectFromArgs(args, zone, effect);
+    _zones.effect[zone].red = args.getInt(KeyRed);
+    _zones.effect[zone].green = args.getInt(KeyGreen);
+    _zones.effect[zone].blue = args.getInt(KeyBlue);
+    _zones.flashTime[zone] = args.getInt(KeyFlashTime);
+    _zones.displayTime[zone] = args.getInt(KeyDisplayTime);
+    _zones.state[zone] = StartDisplayingColor;
+  }
+
+  return 200;
 }
 
-void saveSettings(Settings settings)
+//ZONES=<LEDs>,<LEDs>,... lists how many LEDs each zone gets, from the first LED on
+int setZonesHandler(const CommandArgs &args, Print &out)
 {
-    File f = SPIFFS.open(SETTINGS_FILE, "w+");
-
-    //Using "write" instead of "println" to avoid the "\r"
-    f.write(settings.ssid.c_str());
-    f.write('\n');
-  
+  uint16_t len;
+  const char *list = args.get(KeyZones, len);
+  uint8_t lengths[MAX_ZONES];
+  uint8_t count = 0;
+  uint total = 0;
+  uint value = 0;
+  bool hasDigits = false;
 
-    if (settings.useDHCP)
+  for (uint16_t i = 0; i <= len; i++)
+  {
+    if (i < len && list[i] >= '0' && list[i] <= '9')
     {
-      f.println("1");   
+      value = min(value * 10 + (list[i] - '0'), (uint)LED_COUNT + 1);
+      hasDigits = true;
+      continue;
     }
-    else
+
+    if ((i < len && list[i] != ',') || !hasDigits || value == 0 || count == MAX_ZONES)
     {
-      f.println("0");
-      f.write(settings.ipAddress.c_str());
-      f.write('\n');
-      f.write(settings.subnet.c_str());         
-      f.write('\n');
-      f.write(settings.gateway.c_str());         
-      f.write('\n');      
+      count = 0;
+      break;
     }
 
-    f.close();
+    lengths[count++] = value;
+    total += value;
+    value = 0;
+    hasDigits = false;
+  }
 
-    savePassword(settings.pw);
+  if (count == 0 || total > LED_COUNT)
+  {
+    out.printf("ZONES must be up to %d LED counts, separated by commas, adding up to no more than %d. Zones not updated.\n", MAX_ZONES, LED_COUNT);
+    return 400;
+  }
 
-    _wasRestartedSinceSettingsUpdate = false;
+  setZones(lengths, count);
 
-    Serial.println("Settings saved.");
+  return getDisplayStatusHandler(args, out);
 }
 
-void saveUserIds()
+int setBrightnessHandler(const CommandArgs &args, Print &out)
 {
-    File f = SPIFFS.open(USER_ID_FILE, "w+");
-
-    //Using "write" instead of "println" to avoid the "\r"
-    for (uint8_t i = 0; i < USER_ID_COUNT; i++)
-    {
-       f.write(_userIds[i].c_str());           
-       f.write('\n');
-    }
+  _ledFrame.setBrightness(constrain(args.getInt(KeyLevel), 0L, 255L));
+  _ledFrame.show();
 
-    
-    f.close();
-
-    Serial.println("User Ids saved.");  
+  return getDisplayStatusHandler(args, out);
 }
 
+int setMessageHandler(const CommandArgs &args, Print &out)
+{
+  uint16_t len;
+  const char *msg = args.get(KeyMessage, len);
 
+  setDisplayMessage(msg, len);
 
+  return getDisplayStatusHandler(args, out);
+}
 
+int setPollHandler(const CommandArgs &args, Print &out)
+{
+  static const CommandKey fieldKeys[PollFieldCount] = { KeyStatusField, KeyBranchField, KeyAuthorField };
+  uint16_t urlLen;
+  const char *url = args.get(KeyUrl, urlLen);
+  long zone = args.getInt(KeyZone);
 
+  if (zone < 0 || zone > MAX_ZONES)
+  {
+    out.printf("ZONE must be 1 to %d, or 0 for every zone. Poll not updated.\n", MAX_ZONES);
+    return 400;
+  }
 
+  for (uint8_t i = 0; i < PollFieldCount; i++)
+  {
+    uint16_t len;
 
+    if (args.get(fieldKeys[i], len) && len >= POLL_FIELD_SIZE)
+    {
+      out.printf("%s must be shorter than %d characters. Poll not updated.\n", getCommandKeyName(fieldKeys[i]), POLL_FIELD_SIZE);
+      return 400;
+    }
+  }
 
-void restartHandler()
-{
-  _wasRestartedSinceSettingsUpdate = true;
-  ESP.restart();
-}
+  if (!_poller.configure(url, urlLen, max(args.getInt(KeyInterval), 0L)))
+  {
+    out.printf("URL must be http://host[:port]/path and shorter than %d characters. Poll not updated.\n", POLL_URL_SIZE);
+    return 400;
+  }
 
-void setDisplayHandler(String input)
-{
-  _redVal = getValueFromInputString(input, "RED").toInt();
-  _greenVal = getValueFromInputString(input, "GREEN").toInt();
-  _blueVal = getValueFromInputString(input, "BLUE").toInt();
-  _flashTime = getValueFromInputString(input, "FLASHTIME").toInt();
-  _displayTime = getValueFromInputString(input, "DISPLAYTIME").toInt();
+  for (uint8_t i = 0; i < PollFieldCount; i++)
+  {
+    uint16_t len;
+    const char *field = args.get(fieldKeys[i], len);
 
-  _displayState = StartDisplayingColor;
-}
+    if (field)
+    {
+      _poller.setField((PollField)i, field, len);
+    }
+  }
 
-void setMessageHandler(String input)
-{
-  String msg = getValueFromInputString(input, "MESSAGE");
+  _pollZone = zone;
+  savePollSettings();
 
-  if (msg.length() > MAX_MESSAGE_LEN)
+  if (_poller.getInterval())
   {
-    msg = msg.substring(0, MAX_MESSAGE_LEN - 1);
+    out.printf("Polling %s every %u seconds.\n", _poller.getUrl(), (uint)_poller.getInterval());
   }
-
-  _displayMessage = msg;
-
-  if (msg.length() == 0)
+  else
   {
-    _lcd.clear();
+    out.println("Polling stopped.");
   }
 
-  createDisplayLinesFromMessage();
+  return 200;
 }
 
-void setSettingsHandler(String input)
+int setSettingsHandler(const CommandArgs &args, Print &out)
 {
   String ssid;
   String password;
@@ -966,31 +1693,25 @@ void setSettingsHandler(String input)
   bool bUseDHCP;
  
   //Get SSID
-  ssid = getValueFromInputString(input, "SSID");
+  ssid = args.getString(KeySsid);
 
-  if (ssid.isEmpty())
+  if (ssid.length() >= SSID_SIZE)
   {
-    Serial.println("SSID not found in input. Settings not updated.");
-    return;
+    out.printf("SSID must be shorter than %d characters. Settings not updated.\n", SSID_SIZE);
+    return 400;
   }
 
   //Get PW
-  password = getValueFromInputString(input, "PW");
+  password = args.getString(KeyPw);
 
-  if (password.isEmpty())
+  if (password.length() >= WIFI_PW_SIZE)
   {
-    Serial.println("PW not found in input. Settings not updated.");
-    return;
+    out.printf("PW must be shorter than %d characters. Settings not updated.\n", WIFI_PW_SIZE);
+    return 400;
   }
 
   //Get USEDHCP
-  useDHCP = getValueFromInputString(input, "USEDHCP");
-
-  if (useDHCP.isEmpty())
-  {
-    Serial.println("USEDHCP not found in input. Settings not updated.");
-    return;
-  }
+  useDHCP = args.getString(KeyUseDhcp);
 
   //Parse useDHCP
   if (useDHCP.equalsIgnoreCase("FALSE"))
@@ -1003,266 +1724,549 @@ void setSettingsHandler(String input)
   }
   else
   {
-    Serial.println("USEDHCP was not set to either TRUE or FALSE. Settings not updated.");
-    return;    
+    out.println("USEDHCP was not set to either TRUE or FALSE. Settings not updated.");
+    return 400;    
   }
 
   //We ignore any of the IP settings if we are using DHCP
   if (!bUseDHCP)
   {
     //Get IP
-    ipAddress = getValueFromInputString(input, "IP");
+    ipAddress = args.getString(KeyIp);
 
     if (ipAddress.isEmpty())
     {
-      Serial.println("IP not found in input. Settings not updated.");
-      return;
+      out.println("IP not found in input. Settings not updated.");
+      return 400;
     }  
 
     if (!convertStringToIPAddress(ipAddress))
     {
-      Serial.println("IP was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
-      return;      
+      out.println("IP was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
+      return 400;      
     }
 
     //Get SUBNET
-    subnetMask = getValueFromInputString(input, "SUBNET");
+    subnetMask = args.getString(KeySubnet);
 
     if (subnetMask.isEmpty())
     {
-      Serial.println("SUBNET not found in input. Settings not updated.");
-      return;
+      out.println("SUBNET not found in input. Settings not updated.");
+      return 400;
     }  
 
     if (!convertStringToIPAddress(subnetMask))
     {
-      Serial.println("SUBNET was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
-      return;      
+      out.println("SUBNET was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
+      return 400;      
     } 
 
     //Get GATEWAY
-    gateway = getValueFromInputString(input, "GATEWAY");
+    gateway = args.getString(KeyGateway);
 
     if (gateway.isEmpty())
     {
-      Serial.println("GATEWAY not found in input. Settings not updated.");
-      return;
+      out.println("GATEWAY not found in input. Settings not updated.");
+      return 400;
     }  
 
     if (!convertStringToIPAddress(gateway))
     {
-      Serial.println("GATEWAY was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
-      return;      
+      out.println("GATEWAY was not in a valid v4 format (aaa.bbb.ccc.ddd). Settings not updated.");
+      return 400;      
     }      
   }
 
-  _settings.ssid = ssid;
-  _settings.pw = password;
-  _settings.useDHCP = bUseDHCP;
-  _settings.ipAddress = ipAddress;
-  _settings.subnet = subnetMask;
-  _settings.gateway = gateway;
-
-  saveSettings(_settings);
-
+  strlcpy(_config.settings.ssid, ssid.c_str(), sizeof(_config.settings.ssid));
+  strlcpy(_config.settings.pw, password.c_str(), sizeof(_config.settings.pw));
+  _config.settings.useDHCP = bUseDHCP;
+  _config.settings.ipAddress = convertStringToIPAddress(ipAddress);
+  _config.settings.subnet = convertStringToIPAddress(subnetMask);
+  _config.settings.gateway = convertStringToIPAddress(gateway);
+  //It could be a different network, so the next connect scans and asks DHCP
+  memset(&_config.wifi, 0, sizeof(_config.wifi));
+  _wifiLease.ipAddress = 0;
 
+  saveSettings();
 
+  return 200;
 }
 
-void helpHandler()
+int helpHandler(const CommandArgs &args, Print &out)
 {
-  Serial.println("Help: commands are case-insensitive.");
-  Serial.println("RESTART - soft reset.");
-  Serial.println("HELP - display help.");
-  Serial.println("SETSETTINGS - sets the network settings and required additional params:");
-  Serial.println("\tSSID=<value>;PW=<password>;USEDHCP=<TRUE/FALSE>;IP=<v4ipaddress>;GATEWAY=<v4gameway>;SUBNET=<v4subnetmask>;");
-  Serial.println("\tIP and SUBNET are not required if USEDHCP is false. RESTART should be called after using this command.");
-  Serial.println("GETSTATUS - returns current network settings and status, display status, and message.");
-  Serial.println("GETUSERIDS - returns the list of User Ids.");
-  Serial.printf("SETUSERID - sets a specific user id. IDs are numbered 1 through %d and can be up to %d characters long. Requires additional params:\n", USER_ID_COUNT, USER_ID_MAX_LEN);
-  //NOTE: Indexes are labeled 1 to 16 because String.ToInt returns 0 for invalid strings
-  Serial.printf("\tINDEX=<1-%d>;ID=<value>;\n", USER_ID_COUNT);
-  Serial.printf("\tThe ID cannot be blank and if it is longer than %d it will be truncated.\n", USER_ID_MAX_LEN);
-  Serial.println("SETDISPLAY - sets the light display and requires optional params (params can be left blank but will be read as 0):");
-  Serial.println("\tRED=<8bitVal>;GREEN=<8bitVal>;BLUE=<8bitVal>;FLASHTIME=<number>;DISPLAYTIME=<number>;");
-  Serial.println("\tIf FLASHTIME is < 0, it will flash indefinitely, if it is 0, it will not flash, if it is > 0, it will flash for that many mS * 100.");
-  Serial.println("\tWhen FLASHTIME is done. The display may turn on solid. If DISPLAYTIME < 0, it will turn solid indefinitely. If it is 0 it will not turn on.");
-  Serial.println("\tIf it is > 0, it will turn on solid for tham many mS * 100.");
-  Serial.println("SETMESSAGE - sets the message to display on the LCD and reuqires optional params (blank params will clear the LCD):");
-  Serial.printf("\tMESSAGE=<message>; MESSAGE will be automatically capped at %d characters.\n", MAX_MESSAGE_LEN);
+  out.println("Help: commands are case-insensitive.");
+  out.println("RESTART - soft reset.");
+  out.println("HELP - display help.");
+  out.println("SETSETTINGS - sets the network settings and required additional params:");
+  out.println("\tSSID=<value>;PW=<password>;USEDHCP=<TRUE/FALSE>;IP=<v4ipaddress>;GATEWAY=<v4gameway>;SUBNET=<v4subnetmask>;");
+  out.println("\tIP and SUBNET are not required if USEDHCP is false. RESTART should be called after using this command.");
+  out.println("GETSTATUS - returns current network settings and status, display status, and message, as JSON.");
+  out.println("GETUSERIDS - returns which User Ids are set. Only the start of each one's SHA-256 is kept, so that is what's shown.");
+  out.println("GETMETRICS - returns the counters served at /Metrics, in Prometheus text format.");
+  out.println("PROFILE - returns min/avg/p99/max uS per profiled span when built with -DPROFILING. Optional: RESET=<TRUE/FALSE>;");
+  out.printf("SETUSERID - sets a specific user id. IDs are numbered 1 through %d. Requires additional params:\n", TOKEN_CAPACITY);
+  //NOTE: Indexes are labeled from 1 because String.ToInt returns 0 for invalid strings
+  out.printf("\tINDEX=<1-%d>;ID=<value>;\n", TOKEN_CAPACITY);
+  out.printf("\tThe ID cannot be blank. Ids 1 to %d can also sign UDP control frames.\n", CONTROL_TOKEN_COUNT);
+  out.println("CLEARUSERID - removes a user id. Requires additional params:");
+  out.printf("\tINDEX=<1-%d>;\n", TOKEN_CAPACITY);
+  out.println("SETDISPLAY - sets the light display and requires optional params (params can be left blank but will be read as 0):");
+  out.println("\tRED=<8bitVal>;GREEN=<8bitVal>;BLUE=<8bitVal>;FLASHTIME=<number>;DISPLAYTIME=<number>;");
+  out.println("\tIf FLASHTIME is < 0, it will flash indefinitely, if it is 0, it will not flash, if it is > 0, it will flash for that many mS * 100.");
+  out.println("\tWhen FLASHTIME is done. The display may turn on solid. If DISPLAYTIME < 0, it will turn solid indefinitely. If it is 0 it will not turn on.");
+  out.println("\tIf it is > 0, it will turn on solid for tham many mS * 100.");
+  out.println("\tOptional: EFFECT=<none/fade/breathe/chase/comet/progress>;PERIOD=<mS per cycle>;EASE=<TRUE/FALSE>;PROGRESS=<0-100>;BRIGHTNESS=<8bitVal>;");
+  out.println("\tOptional: ZONE=<1-n>; to only set one zone. Without it every zone is set.");
+  out.println("SETZONES - splits the LEDs into zones, each with its own color, effect and times. Requires additional params:");
+  out.printf("\tZONES=<LEDs>,<LEDs>,...; Up to %d zones from the first LED on, e.g. ZONES=8,8,8; Every zone starts off.\n", MAX_ZONES);
+  out.println("UPDATEDISPLAY - sets the color, effect, times and message together. Takes the SETDISPLAY and SETMESSAGE params.");
+  out.println("\tOnly the parts that are sent change: each zone keeps its color, effect, PERIOD, EASE, PROGRESS, BRIGHTNESS and time left");
+  out.printf("\tfor the params that aren't sent. PERIOD must be %d to 65535 and FLASHTIME and DISPLAYTIME -32768 to 32767.\n", MIN_EFFECT_PERIOD);
+  out.println("\tNothing changes if any param is invalid.");
+  out.println("SETPOLL - polls a CI status URL and shows the result. Requires additional params:");
+  out.println("\tURL=<http://host[:port]/path>;INTERVAL=<seconds, 0 to stop>;");
+  out.println("\tOptional: STATUSFIELD=<path>;BRANCHFIELD=<path>;AUTHORFIELD=<path>;ZONE=<1-n>; Paths are dotted JSON keys, [] for any array element.");
+  out.println("\tThe defaults are status, branch and author. Success shows green, failure red, running yellow and anything else purple.");
+  out.println("SETBRIGHTNESS - sets the overall LED brightness, which scales every color. Requires additional params:");
+  out.println("\tLEVEL=<8bitVal>;");
+  out.println("SETMESSAGE - sets the message to display on the LCD and reuqires optional params (blank params will clear the LCD):");
+  out.printf("\tMESSAGE=<message>; MESSAGE will be automatically capped at %d characters.\n", MAX_MESSAGE_LEN);
+  return 200;
 }
 
-void getStatusHandler()
+int getStatusHandler(const CommandArgs &args, Print &out)
 {
-  if (!_wasRestartedSinceSettingsUpdate)
+  JsonWriter json(out);
+  bool connected = WiFi.status() == WL_CONNECTED;
+
+  json.beginObject();
+  //Settings saved since the last restart aren't in use yet
+  json.addBool("restartRequired", !_wasRestartedSinceSettingsUpdate);
+  json.addUint("uptime", getUptimeSeconds());
+
+  json.beginObject("settings");
+  json.addString("ssid", _config.settings.ssid);
+  json.addBool("useDhcp", _config.settings.useDHCP);
+
+  if (!_config.settings.useDHCP)
   {
-    Serial.println("NOTE: Current settings have not been implemented. RESTART required.");
+    json.addIp("ip", _config.settings.ipAddress);
+    json.addIp("subnet", _config.settings.subnet);
+    json.addIp("gateway", _config.settings.gateway);
   }
 
-  Serial.println("Settings:");
-  Serial.println("\tSSID: " + _settings.ssid);
-  Serial.print("\tUse DHCP: ");
-  Serial.println(_settings.useDHCP ? "TRUE" : "FALSE");
-  
-  if (!_settings.useDHCP)
+  json.endObject();
+
+  json.beginObject("wifi");
+  json.addBool("connected", connected);
+
+  if (connected)
   {
-    Serial.println("\tIP Address: " + _settings.ipAddress);
-    Serial.println("\tSubnet Mask: " + _settings.subnet);
-    Serial.println("\tGateway: " + _settings.gateway);
+    json.addIp("ip", WiFi.localIP());
+    json.addInt("rssi", WiFi.RSSI());
   }
-
-  if (WiFi.status() == WL_CONNECTED)
+  else if (_wifiState == WifiWaitingToRetry)
   {
-    Serial.println("WiFi Status: Connected");
-    if (_settings.useDHCP)
+    uint32_t waited = millis() - _wifiStateStart;
+
+    json.addUint("retryIn", (_wifiRetryDelay - min(waited, _wifiRetryDelay)) / 1000);
+  }
+
+  json.endObject();
+
+  json.beginObject("display");
+  writeDisplayStatus(json);
+  json.endObject();
+
+  if (_poller.getInterval())
+  {
+    json.beginObject("poll");
+    json.addString("url", _poller.getUrl());
+    json.addUint("interval", _poller.getInterval());
+    json.addInt("lastStatusCode", _poller.getLastStatusCode());
+    json.addUint("maxConnectWait", _poller.getMaxConnectWait());
+
+    for (uint8_t i = 0; i < PollResultCount; i++)
     {
-      Serial.println("\tAcquired IP Address: " + WiFi.localIP().toString());
+      json.addUint(getPollResultName((PollResult)i), _poller.getCount((PollResult)i));
     }
+
+    json.endObject();
   }
-  else
+
+  json.addUint("ledFramesSent", _ledFrame.framesSent());
+
+  //Times are all uS
+  json.beginArray("tasks");
+
+  for (uint8_t i = 0; i < _scheduler.getTaskCount(); i++)
   {
-        Serial.println("WiFi Status: Not Connected");
+    const SchedulerTask &task = _scheduler.getTask(i);
+
+    json.beginObject();
+    json.addString("name", task.name);
+    json.addUint("runs", task.runs);
+    json.addUint("overruns", task.overruns);
+    json.addUint("skipped", task.skipped);
+    json.addUint("maxDuration", task.maxDuration);
+    json.addUint("maxLate", task.maxLatency);
+    json.addUint("avgLate", task.runs ? task.totalLatency / task.runs : 0);
+    json.addUint("jitter", task.jitter());
+    json.endObject();
   }
 
-  Serial.printf("Display Status: red=%d, green=%d, blue=%d, flastTime left=%d, displayTime left=%d\n", 
-    _redVal, _greenVal, _blueVal, _flashTime, _displayTime);
-  Serial.println("Current Message: " + _displayMessage);
+  json.endArray();
 
+  json.beginObject("lcd");
+  json.addUint("busTransactions", _lcd.busTransactions());
+  json.addUint("lastFrameTransactions", _lcd.lastFlushTransactions());
+  json.endObject();
+
+  json.endObject();
+  out.println();
+
+  return 200;
 }
 
 
-void getUserIdsHandler()
+int getUserIdsHandler(const CommandArgs &args, Print &out)
+{
+  out.printf("User Ids: %d of %d set\n", _tokens.getCount(), TOKEN_CAPACITY);
+  //NOTE: Indexes are labeled from 1 because String.ToInt returns 0 for invalid strings
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    if (_tokens.has(i))
+    {
+      const uint8_t *digest = _tokens.getDigest(i);
+
+      out.printf("%3d: sha256 %02x%02x%02x%02x...\n", i + 1, digest[0], digest[1], digest[2], digest[3]);
+    }
+  }
+
+  return 200;
+}
+
+//Returns the 1 based INDEX, or 0 after printing why it isn't one
+int getUserIdIndexArg(const CommandArgs &args, Print &out, const char *notDone)
 {
-  Serial.println("User Ids:");
-  //NOTE: Indexes are labeled 1 to 16 because String.ToInt returns 0 for invalid strings
-  for (uint8_t i = 0; i < USER_ID_COUNT; i++)
+  int i = args.getInt(KeyIndex);
+
+  if (i < 1 || i > TOKEN_CAPACITY)
   {
-    Serial.printf("%2d: '%s'\n", i + 1, _userIds[i].c_str());
+    out.printf("INDEX was not a number between 1 and %d. %s\n", TOKEN_CAPACITY, notDone);
+    return 0;
   }
+
+  return i;
 }
 
-void setUserIdsHandler(String input)
+int setUserIdsHandler(const CommandArgs &args, Print &out)
 {
-  String index;
-  String id;
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+  const char *id;
+  uint16_t idLen;
   int i;
 
   //Get the INDEX
-  index = getValueFromInputString(input, "INDEX");
+  i = getUserIdIndexArg(args, out, "User Id not updated.");
 
-  if (index.isEmpty())
+  if (!i)
   {
-      Serial.println("INDEX not found in input. User Id not updated.");
-      return;   
+    return 400;
   }
 
-  i = index.toInt();
+  //Get the ID
+  id = args.get(KeyId, idLen);
+  TokenTable::hashToken(id, idLen, digest);
+
+  out.printf("Updateing User Id %d\n", i);
+  //Make sure to subtract 1 from i since i should start at 1
+  _tokens.set(i - 1, digest);
+
+  saveConfig();
+
+  return 200;
+}
+
+int clearUserIdHandler(const CommandArgs &args, Print &out)
+{
+  int i = getUserIdIndexArg(args, out, "User Id not removed.");
 
-  if (i < 1 || i > USER_ID_COUNT)
+  if (!i)
   {
-      Serial.printf("INDEX was not a number between 1 and %d. User Id not updated.\n", USER_ID_COUNT);
-      return;   
+    return 400;
   }
 
-  //Get the ID
-  id = getValueFromInputString(input, "ID");
-  if (id.isEmpty())
+  out.printf("Removing User Id %d\n", i);
+  _tokens.remove(i - 1);
+
+  saveConfig();
+
+  return 200;
+}
+
+
+/********Command Table Region*/
+
+int getMetricsHandler(const CommandArgs &args, Print &out);
+int profileHandler(const CommandArgs &args, Print &out);
+
+constexpr Command _commands[] =
+{
+  //name, HTTP route, handler, required params, flags
+  { "RESTART", NULL, restartHandler, 0, 0 },
+  { "SETSETTINGS", NULL, setSettingsHandler, commandKeyBit(KeySsid) | commandKeyBit(KeyPw) | commandKeyBit(KeyUseDhcp), 0 },
+  { "HELP", NULL, helpHandler, 0, 0 },
+  { "GETSTATUS", NULL, getStatusHandler, 0, COMMAND_JSON },
+  { "GETUSERIDS", NULL, getUserIdsHandler, 0, 0 },
+  { "SETUSERID", NULL, setUserIdsHandler, commandKeyBit(KeyIndex) | commandKeyBit(KeyId), 0 },
+  { "CLEARUSERID", NULL, clearUserIdHandler, commandKeyBit(KeyIndex), 0 },
+  { "SETDISPLAY", NULL, setDisplayHandler, 0, 0 },
+  { "SETMESSAGE", "/Display/Message", setMessageHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { "SETBRIGHTNESS", "/Display/Brightness", setBrightnessHandler, commandKeyBit(KeyLevel), COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/", rootHandler, 0, 0 },
+  { NULL, "/Display", getDisplayStatusHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Red", setDisplayPresetHandler<128, 0, 0>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Green", setDisplayPresetHandler<0, 128, 0>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Blue", setDisplayPresetHandler<0, 0, 128>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Yellow", setDisplayPresetHandler<64, 32, 0>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Purple", setDisplayPresetHandler<64, 0, 32>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/White", setDisplayPresetHandler<32, 32, 32>, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Off", setDisplayOffHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Color", setDisplayColorHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Pixels", setDisplayPixelsHandler, 0, COMMAND_AUTH },
+  { "UPDATEDISPLAY", "/Display/Update", updateDisplayHandler, 0, COMMAND_AUTH },
+  { "SETZONES", "/Display/Zones", setZonesHandler, commandKeyBit(KeyZones), COMMAND_AUTH | COMMAND_JSON },
+  { "SETPOLL", "/Poll", setPollHandler, commandKeyBit(KeyUrl) | commandKeyBit(KeyInterval), COMMAND_AUTH },
+  { "GETMETRICS", "/Metrics", getMetricsHandler, 0, COMMAND_STREAM },
+  { "PROFILE", "/Profile", profileHandler, 0, COMMAND_AUTH | COMMAND_STREAM },
+};
+
+#define COMMAND_COUNT (sizeof(_commands) / sizeof(_commands[0]))
+
+//Per route, indexed like _commands
+uint32_t _httpRequests[COMMAND_COUNT];
+uint32_t _httpAuthFailures[COMMAND_COUNT];
+
+static_assert(SpanCommands + COMMAND_COUNT <= PROFILE_SPAN_COUNT, "Not enough profiler spans for every command, raise PROFILE_SPAN_COUNT.");
+
+constexpr CommandIndex _serialCommandIndex = buildCommandIndex(_commands, false);
+constexpr CommandIndex _httpCommandIndex = buildCommandIndex(_commands, true);
+
+static_assert(_serialCommandIndex.seed < COMMAND_MAX_SEED, "No perfect hash for the serial commands, raise COMMAND_SLOT_BITS.");
+static_assert(_httpCommandIndex.seed < COMMAND_MAX_SEED, "No perfect hash for the HTTP routes, raise COMMAND_SLOT_BITS.");
+
+//Every command runs through here, whether it came from serial or HTTP
+int runCommand(const Command &command, const CommandArgs &args, Print &out)
+{
+  CommandKey missing = getMissingCommandKey(command, args);
+  PROFILE_SCOPE(SpanCommands + (&command - _commands), command.route ? command.route : command.name);
+
+  if (missing != CommandKeyCount)
   {
-      Serial.println("ID not found in input. User Id not updated.");
-      return;   
-  }  
+    out.printf("%s not found in input. Nothing updated.\n", getCommandKeyName(missing));
+    return 400;
+  }
+
+  return command.handler(args, out);
+}
+
+//Called by _httpServer once a whole request has been read. Every request ends up here and the route comes from the command table
+void handleHTTPRequest(HttpRequest &request)
+{
+  const Command *command = findCommand(_commands, _httpCommandIndex, true, request.path(), request.pathLength());
+  CommandArgs args;
+  const char *userId;
+  uint16_t userIdLen;
+  int status;
 
-  if (id.length() > USER_ID_MAX_LEN)
+  if (command == NULL)
   {
-    id = id.substring(0, USER_ID_MAX_LEN - 1);
+    _httpNotFound++;
+    handleNotFound(request);
+    return;
   }
 
-  Serial.printf("Updateing User Id %d with value '%s'\n", i, id.c_str());
-  //Make sure to subtract 1 from i since i should start at 1
-  _userIds[i - 1] = id;
+  _httpRequests[command - _commands]++;
+  userId = request.arg("userid", userIdLen);
 
-  saveUserIds();
+  if ((command->flags & COMMAND_AUTH) && !isUserIdValid(userId, userIdLen))
+  {
+    _httpAuthFailures[command - _commands]++;
+    sendText(request, 401, "The User Id was missing or was not a valid User Id.");
+    return;
+  }
 
-}
+  //The args are decoded in place in the request's buffer, which lives until the reply is sent
+  for (uint8_t i = 0; i < request.argCount(); i++)
+  {
+    const HttpArg &arg = request.arg(i);
+    args.set(getCommandKey(arg.name, arg.nameLen), arg.value, arg.valueLen);
+  }
 
-void parseSerialInput(String input)
-{
-  String inputUpper = input;
-  inputUpper.toUpperCase();
+  //A body that isn't a form is passed on as is, like ESP8266WebServer's "plain" arg
+  if (request.bodyLength())
+  {
+    args.set(KeyPlain, request.body(), request.bodyLength());
+  }
 
-  if (input.isEmpty())
+  if (command->flags & COMMAND_STREAM)
   {
+    ChunkWriter chunks(_responseChunk, sizeof(_responseChunk), &request);
+
+    //No Content-Length, the reply ends when the connection closes
+    request.beginResponse(200, "text/plain; version=0.0.4");
+    runCommand(*command, args, chunks);
+    chunks.flush();
     return;
   }
-  else if (inputUpper.startsWith("RESTART"))
+
+  const char *type = (command->flags & COMMAND_JSON) ? "application/json" : "text/plain";
+  HttpSpillResponse spill(request, type);
+  ChunkWriter reply(_responseChunk, sizeof(_responseChunk), &spill);
+
+  status = runCommand(*command, args, reply);
+
+  //Only a long status reply outgrows _responseChunk, and that has already gone out as a 200
+  if (spill.isStarted())
   {
-    restartHandler();
+    reply.flush();
+    return;
   }
-  else if (inputUpper.startsWith("SETSETTINGS"))
+
+  request.send(status, status < 300 ? type : "text/plain", reply.data(), reply.length());
+}
+
+//Prometheus text format. Everything here is a fixed counter and the reply is streamed out of _responseChunk,
+//so a scrape doesn't move the heap numbers it reports.
+int getMetricsHandler(const CommandArgs &args, Print &out)
+{
+  printMetric(out, "heap_free_bytes", "gauge", (uint32_t)ESP.getFreeHeap());
+  printMetric(out, "heap_max_free_block_bytes", "gauge", (uint32_t)ESP.getMaxFreeBlockSize());
+  printMetric(out, "heap_fragmentation_percent", "gauge", (uint32_t)ESP.getHeapFragmentation());
+  printMetric(out, "uptime_seconds", "counter", (uint32_t)(micros64() / 1000000));
+  printMetric(out, "wifi_rssi_dbm", "gauge", WiFi.status() == WL_CONNECTED ? (int32_t)WiFi.RSSI() : 0);
+  printMetric(out, "wifi_connects_total", "counter", _wifiConnects);
+  printMetric(out, "wifi_disconnects_total", "counter", _wifiDisconnects);
+  printMetric(out, "wifi_fast_connects_total", "counter", _wifiFastConnects);
+  printMetric(out, "wifi_connect_failures_total", "counter", _wifiConnectFailures);
+
+  printMetricType(out, "http_requests_total", "counter");
+  for (uint8_t i = 0; i < COMMAND_COUNT; i++)
   {
-    setSettingsHandler(input);
+    if (_commands[i].route)
+    {
+      printLabelledMetric(out, "http_requests_total", "route", _commands[i].route, _httpRequests[i]);
+    }
   }
-  else if (inputUpper.startsWith("HELP"))
+
+  printMetricType(out, "http_auth_failures_total", "counter");
+  for (uint8_t i = 0; i < COMMAND_COUNT; i++)
   {
-    helpHandler();
+    if (_commands[i].route && (_commands[i].flags & COMMAND_AUTH))
+    {
+      printLabelledMetric(out, "http_auth_failures_total", "route", _commands[i].route, _httpAuthFailures[i]);
+    }
   }
-  else if (inputUpper.startsWith("GETSTATUS"))
+
+  printMetric(out, "http_not_found_total", "counter", _httpNotFound);
+
+  printMetricType(out, "poll_results_total", "counter");
+  for (uint8_t i = 0; i < PollResultCount; i++)
   {
-    getStatusHandler();
+    printLabelledMetric(out, "poll_results_total", "result", getPollResultName((PollResult)i), _poller.getCount((PollResult)i));
   }
-  else if (inputUpper.startsWith("GETUSERIDS"))
+
+  printMetricType(out, "control_frames_total", "counter");
+  for (uint8_t i = 0; i < ControlResultCount; i++)
   {
-    getUserIdsHandler();
+    printLabelledMetric(out, "control_frames_total", "result", getControlResultName((ControlResult)i), _control.getCount((ControlResult)i));
   }
-  else if (inputUpper.startsWith("SETUSERID"))
+
+  printHistogram(out, "tick_duration_us", _tickDurations);
+  printMetric(out, "lcd_bytes_written_total", "counter", _lcd.busTransactions());
+  printMetric(out, "led_frames_sent_total", "counter", _ledFrame.framesSent());
+
+  return 200;
+}
+
+int profileHandler(const CommandArgs &args, Print &out)
+{
+  PROFILE_PRINT(out);
+
+  if (isArgTrue(args, KeyReset))
   {
-    setUserIdsHandler(input);
-  } 
-  else if (inputUpper.startsWith("SETDISPLAY"))
+    PROFILE_RESET();
+  }
+
+  return 200;
+}
+
+/********End Command Table Region*/
+
+void parseSerialInput(const char *input, uint len)
+{
+  CommandArgs args;
+  const Command *command;
+  uint nameLen = 0;
+
+  if (len == 0)
   {
-    setDisplayHandler(input);
+    return;
   }
-  else if (inputUpper.startsWith("SETMESSAGE"))
+
+  //The command runs up to the first space or ;
+  while (nameLen < len && input[nameLen] != ' ' && input[nameLen] != ';')
   {
-    setMessageHandler(input);
-  }             
-  else
+    nameLen++;
+  }
+
+  command = findCommand(_commands, _serialCommandIndex, false, input, nameLen);
+
+  if (command == NULL)
   {
     Serial.println("Command not recognized.");
+    return;
   }
+
+  args.parse(input + nameLen, len - nameLen);
+  runCommand(*command, args, Serial);
 }
 
 
+//Drains the UART's receive ring a chunk at a time and edits the line in place, so nothing is allocated per keystroke or command
 void handleSerialInput()
 {
-  static String input;
+  char chunk[32];
+  int available;
+  size_t count;
   char c;
-  while (Serial.available() > 0)
+
+  while ((available = Serial.available()) > 0)
   {
-    c = Serial.read();
+    count = Serial.read(chunk, min((size_t)available, sizeof(chunk)));
 
-    if (c == '\n')
+    for (size_t i = 0; i < count; i++)
     {
-      Serial.println("Cmd: " + input);
-      parseSerialInput(input);
-      input.clear();
-    }
-    else if (c == '\b')
-    {
-      if (input.length() > 1)
+      c = chunk[i];
+
+      if (c == '\n')
       {
-        input = input.substring(0, input.length() - 1);
+        _serialLine[_serialLineLen] = '\0';
+        Serial.printf("Cmd: %s\n", _serialLine);
+        parseSerialInput(_serialLine, _serialLineLen);
+        _serialLineLen = 0;
       }
-      else if (input.length() == 1)
+      else if (c == '\b')
       {
-        input.clear();
+        if (_serialLineLen > 0)
+        {
+          _serialLineLen--;
+        }
       }
-    }
-    else
-    {
-      if (input.length() < MAX_INPUT_LEN)
+      else if (c != '\r' && _serialLineLen < MAX_INPUT_LEN)
       {
-        input += c;     
+        _serialLine[_serialLineLen++] = c;
       }
     }
   }
@@ -1327,12 +2331,9 @@ void handleIpDiplayState()
 
 }
 
-void handleDisplayState()
+void handleZoneState(uint8_t zone)
 {
-  static uint flashingTimer = 0;
-  static bool flashOn = false;
-
-  switch (_displayState)
+  switch (_zones.state[zone])
   {
     case StartDisplayingColor:
 
@@ -1340,92 +2341,93 @@ void handleDisplayState()
       //We check for the flash timer first. If it is not 0, it's intended to turn on infinitely or for a set amount of time.
       //Otherwise, we check the same scenario for the full on display (<0 means always on, 0 means off, >0 countdown to off)
       //Finally, if both "time" vars are 0, just turn off the display.
-      if(_flashTime != 0)
+      _zones.startTime[zone] = millis();
+
+      if(_zones.flashTime[zone] != 0)
       {
-        flashingTimer = 0;
-        flashOn = true;
-        setFullDisplayColor(_redVal, _greenVal, _blueVal);
-        _displayState = FlashingColor;
+        _zones.flashTimer[zone] = 0;
+        _zones.flashOn[zone] = true;
+        showDisplayColor(zone);
+        _zones.state[zone] = FlashingColor;
       }
-      else if (_displayTime != 0)
+      else if (_zones.displayTime[zone] != 0)
       {
-        setFullDisplayColor(_redVal, _greenVal, _blueVal);
-        _displayState = DisplayingColor;
+        showDisplayColor(zone);
+        _zones.state[zone] = DisplayingColor;
       }
       else
       {
-        _displayState = StopDisplayingColor;
+        _zones.state[zone] = StopDisplayingColor;
       }
 
 
     case FlashingColor:
       /* code */
 
-      //If the _flashTime is 0, we finished flashing. Now we need to check if we move on to just displaying a color or turn off the display.
+      //If the flash time is 0, we finished flashing. Now we need to check if we move on to just displaying a color or turn off the display.
       //If the _flassTime is > 0, keep flashing
-      //The unhandled scenario is if _flashTime < 0, in which case we just keep flashing.
-      if (_flashTime == 0)
+      //The unhandled scenario is if the flash time < 0, in which case we just keep flashing.
+      if (_zones.flashTime[zone] == 0)
       {
-        //Here, if _displayTime > 0, then we need to switch states to full on display mode.
-        if (_displayTime != 0)
+        //Here, if the display time > 0, then we need to switch states to full on display mode.
+        if (_zones.displayTime[zone] != 0)
         {
-          _displayState = DisplayingColor;
+          _zones.state[zone] = DisplayingColor;
         }
         else
         {
-          _displayState = StopDisplayingColor;
+          _zones.state[zone] = StopDisplayingColor;
         }
       }
-      else if (_flashTime > 0)
+      else if (_zones.flashTime[zone] > 0)
       {
         //We are still in flashing mode here and we are counting down the timer.
-        _flashTime--;
+        _zones.flashTime[zone]--;
       }
 
       //This statements handles switching the display on and off for flashing mode.
-      //Because it only enters the body if the flashingTimer >= FLASH_SPEED, the contents are only executed onces per flash
-      if (flashingTimer >= FLASH_SPEED)
+      //Because it only enters the body if the flash timer >= FLASH_SPEED, the contents are only executed onces per flash
+      if (_zones.flashTimer[zone] >= FLASH_SPEED)
       {
-        flashingTimer = 0;
+        _zones.flashTimer[zone] = 0;
         
-        if (flashOn)
+        if (_zones.flashOn[zone])
         {
-          clearDisplay();
-          flashOn = false;
+          clearZone(zone);
+          _zones.flashOn[zone] = false;
         }
         else
         {
-          setFullDisplayColor(_redVal, _greenVal, _blueVal);
-          flashOn = true;
+          showDisplayColor(zone);
+          _zones.flashOn[zone] = true;
         }
       }
 
-      flashingTimer++;
+      _zones.flashTimer[zone]++;
 
       break;
     case DisplayingColor:
       
-      //In this if statement, if _displayTime > 0, we are counting down to eventually turn off the display.
-      //If _displayTime == 0, then the display should be turned off.
-      //Else _displayTime must be < 0 so we just leave the display on and move to the do nothing state
-      if (_displayTime > 0)
+      //In this if statement, if the display time > 0, we are counting down to eventually turn off the display.
+      //If the display time == 0, then the display should be turned off.
+      //Else the display time must be < 0 so we just leave the display on, and without an effect to animate, move to the do nothing state
+      if (_zones.displayTime[zone] > 0)
       {
-          _displayTime--;  
+          _zones.displayTime[zone]--;  
       }
-      else if (_displayTime == 0)
+      else if (_zones.displayTime[zone] == 0)
       {
-        _displayState = StopDisplayingColor;
+        _zones.state[zone] = StopDisplayingColor;
       }
-      else
+      else if (_zones.effect[zone].effect == EffectNone)
       {
-        setFullDisplayColor(_redVal, _greenVal, _blueVal);
-        _displayState = DoNothing;
+        _zones.state[zone] = DoNothing;
       }
 
       break;
     case StopDisplayingColor:
-      clearDisplay();
-      _displayState = DoNothing;
+      clearZone(zone);
+      _zones.state[zone] = DoNothing;
       break;
     case DoNothing:
       //do nothing;
@@ -1434,6 +2436,17 @@ void handleDisplayState()
   }  
 }
 
+//Steps every zone's state machine, then sends the frame they drew once for all of them
+void handleDisplayState()
+{
+  for (uint8_t zone = 0; zone < _zones.count; zone++)
+  {
+    handleZoneState(zone);
+  }
+
+  _ledFrame.show();
+}
+
 void handleMessageScrolling()
 {
   static uint scrollTimer = 0;
@@ -1449,6 +2462,68 @@ void handleMessageScrolling()
   
 }
 
+//Runs the 100ms state machines once for every timer tick since the last run, so their timers keep real time
+void handleTicks()
+{
+  uint32_t start;
+
+  while (_pendingTicks)
+  {
+    _pendingTicks--;
+    start = micros();
+    PROFILE_SCOPE(SpanTick, "tick");
+
+    handleDisplayState();
+    //We only want to start displaying the message once we have received one
+    if (_messageEnabled) 
+    {
+      handleMessageScrolling();
+    }
+
+    recordDuration(_tickDurations, micros() - start);
+  }
+}
+
+//Keeps effects animating between state machine ticks. A solid color doesn't change the frame so nothing gets sent.
+void handleLedEffects()
+{
+  for (uint8_t zone = 0; zone < _zones.count; zone++)
+  {
+    if (_zones.state[zone] == DisplayingColor || (_zones.state[zone] == FlashingColor && _zones.flashOn[zone]))
+    {
+      showDisplayColor(zone);
+    }
+  }
+
+  //One SPI transfer for every zone, and none at all if nothing changed
+  _ledFrame.show();
+}
+
+//Everything else only draws into the LCD shadow buffer, this queues the cells that changed
+void handleLCDRefresh()
+{
+  _lcd.flush();
+}
+
+void handleMDNS()
+{
+  MDNS.update();
+}
+
+void initScheduler()
+{
+  _scheduler.addTask("ticks", handleTicks, TICK_TASK_PERIOD, TICK_TASK_BUDGET);
+  _scheduler.addTask("effects", handleLedEffects, EFFECT_TASK_PERIOD, EFFECT_TASK_BUDGET);
+  _scheduler.addTask("lcd", handleLCDRefresh, LCD_TASK_PERIOD, LCD_TASK_BUDGET);
+  _scheduler.addTask("serial", handleSerialInput, SERIAL_TASK_PERIOD, SERIAL_TASK_BUDGET);
+  _scheduler.addTask("ip", handleIpDiplayState, IP_TASK_PERIOD, IP_TASK_BUDGET);
+  _scheduler.addTask("mdns", handleMDNS, MDNS_TASK_PERIOD, MDNS_TASK_BUDGET);
+  _scheduler.addTask("poll", handlePoll, POLL_TASK_PERIOD, POLL_TASK_BUDGET);
+  _scheduler.addTask("wifi", handleWifi, WIFI_TASK_PERIOD, WIFI_TASK_BUDGET);
+
+  Serial.println("Scheduler started.");
+}
+
 
 
 
@@ -1462,9 +2537,13 @@ void setup() {
 
   //Init LED SPI should come before the LCD or it could interfere with the LDC as some pins are shared
   initLED_SPI();
+  initZones();
   //LCD should be initialized early so connection status info can be displayed
   initLCD();
 
+  //The timer and scheduler start before anything that can halt initialization so the serial console always works
+  initTimer();
+  initScheduler();
 
 
   //The File System needs to be mounted before we can load user ids and settings
@@ -1474,29 +2553,25 @@ void setup() {
     return;
   }
 
-  //Loading user ids first so that, if no User Id file exists, the defaults can be loaded
-  //If we wait till after getSettings, the Ids will be blank if no network settings can be loaded
-  loadUserIds();
+  //Loads the User Ids too, or the default one, so the serial console works even without network settings
+  loadConfig();
 
   //Need to get the settings before trying to connect to wifi
-  if (!loadSettings())
+  if (!_config.settings.ssid[0])
   {
-    Serial.println("Without the settings file, the network connection info is unknown.\nInitialization haulted.");
+    Serial.println("Without network settings, the network connection info is unknown.\nInitialization haulted.");
     _lcd.clear();
     _lcd.home();
     _lcd.write("No Network Settings");
+    _lcd.flush();
     return;
   }
 
-  //Init the timer before wifi so we can use it to temporarily display value.
-  initTimer();
+  //Connects from the scheduler, which starts the HTTP server and UDP control once connected
+  initWifi();
 
-  //Need to start WiFi before starting the server
-  if (initWifi(_settings))
-  {
-    //Starting the HTTP server should be the last thing we do for initialization
-    initHTTPServer();
-  }
+  //From here on LCD writes are queued and trickled out by loop() instead of busy-waiting in the timer
+  _lcd.setAsync(true);
 
   //test
   // _redVal = 64;
@@ -1506,28 +2581,30 @@ void setup() {
   // _displayTime = 0;
   // _displayState = StartDisplayingColor;
   // _startingMessageIndex = 0;
-  // _displayMessage = "Hello, World! My name is Branden Boucher!";// And I approve this very long, multiline message.";
-  // createDisplayLinesFromMessage();
+  // const char *message = "Hello, World! My name is Branden Boucher!";// And I approve this very long, multiline message.";
+  // setDisplayMessage(message, strlen(message));
 }
 
 void loop() 
 {
-  server.handleClient();
-  MDNS.update();
-  //Try to leave this as is. No other code
+  _httpServer.poll();
+  handleUdpControl();
+  //Runs at most one task that is due. The WiFi cache is a flash write, so it waits for a pass where none is.
+  if (!_scheduler.run(micros()) && _wifiCacheChanged)
+  {
+    _wifiCacheChanged = false;
+    saveConfig();
+  }
+  //Sends at most one queued byte to the LCD, never waits
+  _lcd.pump();
+  //Nothing else in here may block
 }
 
 
 
+//Runs in the SDK's timer context, so all it does is count the tick for handleTicks()
 void timerCallback(void *pArg) 
 {
-  handleIpDiplayState();
-  handleDisplayState();
-  //We only want to start displaying the message once we have received one
-  if (_messageEnabled) 
-  {
-    handleMessageScrolling();
-  }
-  handleSerialInput();
+  _pendingTicks++;
 } 
 
@@ -0,0 +1,52 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+//Just enough of the Arduino core for the modules the native test env builds. Everything is inline so the
+//shims need no source files of their own. The clock is fake: delays move it, yield() moves it by HOST_YIELD_US
+//the way a pass through the SDK would, and every micros() call moves it by 1uS, so busy waits still finish and
+//tests are repeatable.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <algorithm>
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define IRAM_ATTR
+
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+#define HOST_PIN_COUNT 17
+#define HOST_YIELD_US 100
+
+inline uint64_t hostMicros = 0;
+inline uint8_t hostPinValues[HOST_PIN_COUNT];
+inline uint8_t hostPinModes[HOST_PIN_COUNT];
+
+inline unsigned long micros() { return (unsigned long)++hostMicros; }
+inline unsigned long millis() { return (unsigned long)(hostMicros / 1000); }
+inline void delayMicroseconds(unsigned int us) { hostMicros += us; }
+inline void delay(unsigned long ms) { hostMicros += ms * 1000; }
+inline void yield() { hostMicros += HOST_YIELD_US; }
+
+inline void pinMode(uint8_t pin, uint8_t mode) { if (pin < HOST_PIN_COUNT) hostPinModes[pin] = mode; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { if (pin < HOST_PIN_COUNT) hostPinValues[pin] = value; }
+inline int digitalRead(uint8_t pin) { return pin < HOST_PIN_COUNT ? hostPinValues[pin] : LOW; }
+
+#include "WString.h"
+#include "Print.h"
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef FS_h
+#define FS_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//In memory SPIFFS. Tests can look at and change the files directly, and set a write budget to cut a save
+//short the way losing power would.
+class File
+{
+public:
+  File() : _data(NULL), _position(0), _budget(NULL) {}
+  File(std::vector<uint8_t> * data, long * budget) : _data(data), _position(0), _budget(budget) {}
+
+  explicit operator bool() const { return _data != NULL; }
+
+  size_t read(uint8_t * buffer, size_t size)
+  {
+    size_t available = _data && _position < _data->size() ? _data->size() - _position : 0;
+    size = size < available ? size : available;
+    memcpy(buffer, _data->data() + _position, size);
+    _position += size;
+    return size;
+  }
+
+  size_t write(const uint8_t * buffer, size_t size)
+  {
+    if (_data == NULL)
+    {
+      return 0;
+    }
+
+    if (*_budget >= 0)
+    {
+      size = (long)size < *_budget ? size : *_budget;
+      *_budget -= size;
+    }
+
+    if (_data->size() < _position + size)
+    {
+      _data->resize(_position + size);
+    }
+
+    memcpy(_data->data() + _position, buffer, size);
+    _position += size;
+    return size;
+  }
+
+  void close() { _data = NULL; }
+
+private:
+  std::vector<uint8_t> * _data;
+  size_t _position;
+  long * _budget;
+};
+
+class FS
+{
+public:
+  //"r" needs the file to exist, "w" and "w+" create or truncate it
+  File open(const char * path, const char * mode)
+  {
+    if (mode[0] == 'r')
+    {
+      auto file = files.find(path);
+      return file == files.end() ? File() : File(&file->second, &writeBudget);
+    }
+
+    std::vector<uint8_t> & data = files[path];
+    data.clear();
+    return File(&data, &writeBudget);
+  }
+
+  bool exists(const char * path) { return files.count(path) != 0; }
+  bool remove(const char * path) { return files.erase(path) != 0; }
+
+  std::map<std::string, std::vector<uint8_t>> files;
+  long writeBudget = -1; //bytes left before writes come up short, -1 for no limit
+};
+
+inline FS SPIFFS;
+
+#endif
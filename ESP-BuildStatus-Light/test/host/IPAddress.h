@@ -0,0 +1,19 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <inttypes.h>
+
+//Only IPv4, held the way lwIP holds it
+class IPAddress
+{
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint32_t address) : _address(address) {}
+
+  operator uint32_t() const { return _address; }
+
+private:
+  uint32_t _address;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef LcdGpioFake_h
+#define LcdGpioFake_h
+
+#include "Arduino.h"
+
+//Host stand-in for the GPOS/GPOC/GPES/GPEC/GPI registers behind LcdGpio.h. Every set and clear is logged,
+//in order, and applied to the same pins digitalWrite() drives, so a test can check both the register
+//traffic and the levels the LCD would see.
+//
+//Once lcdModelAttach() is called an HD44780 sits on the bus too. It latches a nibble on every falling enable
+//edge the registers make, keeps the address counter and DDRAM, stays busy for the datasheet's execution time
+//after each instruction and answers busy flag reads through GPI. Only 4-bit wiring on the masked bus is modelled.
+
+#define LCD_GPIO_FAKE_LOG_SIZE 1024
+#define LCD_MODEL_EXEC_US 37 //most instructions at 270kHz
+#define LCD_MODEL_SLOW_EXEC_US 1520 //clear and home
+
+struct LcdGpioWrite
+{
+  bool set; //GPOS, otherwise GPOC
+  uint32_t mask;
+};
+
+inline LcdGpioWrite lcdGpioLog[LCD_GPIO_FAKE_LOG_SIZE];
+inline uint32_t lcdGpioWrites = 0; //every write, even past the end of the log
+inline uint32_t lcdGpioOutputs = 0; //pins currently enabled as outputs
+inline uint32_t lcdGpioInputLevels = 0; //what GPI reads for pins that are inputs
+
+struct LcdModel
+{
+  bool attached;
+  uint8_t rs;
+  uint8_t rw;
+  uint8_t enable;
+  uint8_t data[4]; //D4-D7
+  bool fourBit; //powers up in 8-bit mode, where only D4-D7 are seen
+  bool twoLine; //DDRAM is then 0x00-0x27 and 0x40-0x67, and the counter jumps between them
+  bool lowNibble; //the next 4-bit latch completes a byte
+  uint8_t pending;
+  bool readLowNibble; //the next status read returns the low half
+  bool increment;
+  uint8_t address; //the address counter
+  uint64_t busyUntil;
+  uint8_t ddram[128];
+  uint32_t executed;
+  uint32_t writesWhileBusy; //a real controller would drop or garble these
+};
+
+inline LcdModel lcdModel;
+
+inline void lcdGpioReset()
+{
+  lcdGpioWrites = 0;
+}
+
+inline void lcdModelAttach(uint8_t rs, uint8_t rw, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+{
+  lcdModel = LcdModel();
+  lcdModel.attached = true;
+  lcdModel.rs = rs;
+  lcdModel.rw = rw;
+  lcdModel.enable = enable;
+  lcdModel.data[0] = d4;
+  lcdModel.data[1] = d5;
+  lcdModel.data[2] = d6;
+  lcdModel.data[3] = d7;
+  lcdModel.increment = true;
+  memset(lcdModel.ddram, ' ', sizeof(lcdModel.ddram));
+}
+
+inline bool lcdModelBusy()
+{
+  return hostMicros < lcdModel.busyUntil;
+}
+
+inline void lcdModelExecute(bool isData, uint8_t value)
+{
+  uint32_t time = LCD_MODEL_EXEC_US;
+
+  lcdModel.writesWhileBusy += lcdModelBusy();
+  lcdModel.executed++;
+
+  if (isData)
+  {
+    lcdModel.ddram[lcdModel.address] = value;
+    lcdModel.address = (lcdModel.address + (lcdModel.increment ? 1 : -1)) & 0x7F;
+
+    if (lcdModel.twoLine && (lcdModel.address & 0x3F) >= 0x28)
+    {
+      lcdModel.address = lcdModel.increment ? (lcdModel.address & 0x40) ^ 0x40 : (lcdModel.address & 0x40) ^ 0x27;
+    }
+  }
+  else if (value & 0x80)
+  {
+    lcdModel.address = value & 0x7F;
+  }
+  else if (value & 0x40)
+  {
+    //CGRAM, the address counter then points there
+    lcdModel.address = value & 0x3F;
+  }
+  else if (value & 0x20)
+  {
+    lcdModel.fourBit = !(value & 0x10);
+    lcdModel.twoLine = value & 0x08;
+  }
+  else if (value & 0x04)
+  {
+    lcdModel.increment = value & 0x02;
+  }
+  else if (value & 0x02)
+  {
+    lcdModel.address = 0;
+    time = LCD_MODEL_SLOW_EXEC_US;
+  }
+  else if (value & 0x01)
+  {
+    memset(lcdModel.ddram, ' ', sizeof(lcdModel.ddram));
+    lcdModel.address = 0;
+    lcdModel.increment = true;
+    time = LCD_MODEL_SLOW_EXEC_US;
+  }
+
+  lcdModel.busyUntil = hostMicros + time;
+}
+
+inline uint8_t lcdModelDataLevels()
+{
+  uint8_t nibble = 0;
+
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    nibble |= (hostPinValues[lcdModel.data[i]] ? 1 : 0) << i;
+  }
+
+  return nibble;
+}
+
+//Falling enable edge with RW low: take the nibble on D4-D7
+inline void lcdModelLatch()
+{
+  uint8_t nibble = lcdModelDataLevels();
+  bool isData = hostPinValues[lcdModel.rs];
+
+  lcdModel.readLowNibble = false;
+
+  if (!lcdModel.fourBit)
+  {
+    lcdModelExecute(isData, nibble << 4);
+  }
+  else if (!lcdModel.lowNibble)
+  {
+    lcdModel.pending = nibble << 4;
+    lcdModel.lowNibble = true;
+  }
+  else
+  {
+    lcdModel.lowNibble = false;
+    lcdModelExecute(isData, lcdModel.pending | nibble);
+  }
+}
+
+inline void lcdGpioRecord(bool set, uint32_t mask)
+{
+  bool enableWasHigh = lcdModel.attached && hostPinValues[lcdModel.enable];
+
+  if (lcdGpioWrites < LCD_GPIO_FAKE_LOG_SIZE)
+  {
+    lcdGpioLog[lcdGpioWrites] = { set, mask };
+  }
+
+  lcdGpioWrites++;
+
+  for (uint8_t pin = 0; pin < HOST_PIN_COUNT; pin++)
+  {
+    if (mask & (1UL << pin))
+    {
+      hostPinValues[pin] = set ? HIGH : LOW;
+    }
+  }
+
+  if (enableWasHigh && !set && (mask & (1UL << lcdModel.enable)) && !hostPinValues[lcdModel.rw])
+  {
+    lcdModelLatch();
+  }
+}
+
+inline void lcdGpioSet(uint32_t mask) { lcdGpioRecord(true, mask); }
+inline void lcdGpioClear(uint32_t mask) { lcdGpioRecord(false, mask); }
+inline void lcdGpioOutput(uint32_t mask) { lcdGpioOutputs |= mask; }
+inline void lcdGpioInput(uint32_t mask) { lcdGpioOutputs &= ~mask; }
+
+inline uint32_t lcdGpioRead()
+{
+  uint32_t levels = 0;
+
+  //A status read: busy flag and address counter, high half first
+  if (lcdModel.attached && hostPinValues[lcdModel.rw] && hostPinValues[lcdModel.enable] && !hostPinValues[lcdModel.rs])
+  {
+    uint8_t status = (lcdModelBusy() ? 0x80 : 0) | lcdModel.address;
+    uint8_t nibble = lcdModel.readLowNibble ? status & 0x0F : status >> 4;
+
+    lcdModel.readLowNibble = !lcdModel.readLowNibble;
+    lcdGpioInputLevels = 0;
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      lcdGpioInputLevels |= (uint32_t)((nibble >> i) & 1) << lcdModel.data[i];
+    }
+  }
+
+  for (uint8_t pin = 0; pin < HOST_PIN_COUNT; pin++)
+  {
+    levels |= (uint32_t)(hostPinValues[pin] ? 1 : 0) << pin;
+  }
+
+  return (levels & lcdGpioOutputs) | (lcdGpioInputLevels & ~lcdGpioOutputs);
+}
+
+#endif
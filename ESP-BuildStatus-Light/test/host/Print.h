@@ -0,0 +1,60 @@
+#ifndef Print_h
+#define Print_h
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEC 10
+
+//Host Print with the same virtual write() pair as the core, so ChunkWriter and friends behave the same.
+//Numbers go through snprintf instead of the core's own formatting.
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t * buffer, size_t size)
+  {
+    size_t n = 0;
+
+    while (size-- && write(*buffer++))
+    {
+      n++;
+    }
+
+    return n;
+  }
+  size_t write(const char * str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char * buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const char * str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int = DEC) { return printf("%d", value); }
+  size_t print(unsigned int value, int = DEC) { return printf("%u", value); }
+  size_t print(long value, int = DEC) { return printf("%ld", value); }
+  size_t print(unsigned long value, int = DEC) { return printf("%lu", value); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T value) { return print(value) + println(); }
+
+  size_t printf(const char * format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len < 0)
+    {
+      return 0;
+    }
+
+    return write((const uint8_t *)buffer, (size_t)len < sizeof(buffer) ? len : sizeof(buffer) - 1);
+  }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SPI_h
+#define SPI_h
+
+#include "Arduino.h"
+
+//Host SPI that keeps the bytes of the last burst and counts every call that puts bytes on the bus
+#define SPI_FAKE_BUFFER_SIZE 512
+
+class SPIClass
+{
+public:
+  void begin() {}
+
+  uint8_t transfer(uint8_t data)
+  {
+    transfers++;
+    record(&data, 1);
+    return 0;
+  }
+
+  void writeBytes(const uint8_t * data, uint32_t size)
+  {
+    transfers++;
+    record(data, size);
+  }
+
+  void reset()
+  {
+    transfers = 0;
+    length = 0;
+  }
+
+  uint32_t transfers = 0;
+  uint32_t length = 0; //bytes since the last reset, only the first SPI_FAKE_BUFFER_SIZE are kept
+  uint8_t bytes[SPI_FAKE_BUFFER_SIZE];
+
+private:
+  void record(const uint8_t * data, uint32_t size)
+  {
+    for (uint32_t i = 0; i < size; i++, length++)
+    {
+      if (length < SPI_FAKE_BUFFER_SIZE)
+      {
+        bytes[length] = data[i];
+      }
+    }
+  }
+};
+
+inline SPIClass SPI;
+
+#endif
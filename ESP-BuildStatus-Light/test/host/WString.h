@@ -0,0 +1,22 @@
+#ifndef WString_h
+#define WString_h
+
+#include <string>
+
+//Host String, only what the native modules use
+class String
+{
+public:
+  String() {}
+  String(const char * value) : _value(value ? value : "") {}
+
+  unsigned int length() const { return _value.size(); }
+  const char * c_str() const { return _value.c_str(); }
+  bool concat(const char * value, unsigned int len) { _value.append(value, len); return true; }
+  bool operator==(const char * value) const { return _value == value; }
+
+private:
+  std::string _value;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef WiFiClient_h
+#define WiFiClient_h
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include <string>
+
+//One TCP connection as the tests see it. The test owns it, feeds input as the peer would and refills room as
+//the peer acks. A WiFiClient is only a handle to one, so copies share it like the core's ClientContext.
+//Outgoing connects are answered by wifiFakeRemote, or wait out the client's timeout and fail if it's NULL.
+struct WiFiFakeConnection
+{
+  std::string input; //everything the peer has sent so far
+  size_t readAt = 0;
+  std::string output; //everything written to the peer
+  size_t room = 2920; //availableForWrite(), used up by writes
+  bool peerOpen = true; //false once the peer has closed its side
+  bool stopped = false;
+  int stopWait = -1; //what stop() was given
+  uint32_t remoteAddress = 0; //what connect() was given
+  uint16_t remotePort = 0;
+};
+
+inline WiFiFakeConnection * wifiFakeRemote = NULL;
+
+class WiFiClient : public Print
+{
+public:
+  WiFiClient() : _connection(NULL), _timeout(1000) {}
+  WiFiClient(WiFiFakeConnection * connection) : _connection(connection), _timeout(1000) {}
+
+  int connect(IPAddress address, uint16_t port)
+  {
+    if (!wifiFakeRemote)
+    {
+      delay(_timeout);
+      return 0;
+    }
+
+    _connection = wifiFakeRemote;
+    _connection->stopped = false;
+    _connection->remoteAddress = address;
+    _connection->remotePort = port;
+    return 1;
+  }
+
+  explicit operator bool() { return _connection != NULL && !_connection->stopped; }
+
+  uint8_t connected() { return (bool)*this && (_connection->peerOpen || available() > 0); }
+  int available() { return _connection ? _connection->input.size() - _connection->readAt : 0; }
+
+  int read(uint8_t * buffer, size_t size)
+  {
+    size_t count = available();
+    count = count < size ? count : size;
+    memcpy(buffer, _connection->input.data() + _connection->readAt, count);
+    _connection->readAt += count;
+    return count;
+  }
+
+  int read()
+  {
+    uint8_t c;
+    return read(&c, 1) ? c : -1;
+  }
+
+  size_t availableForWrite() { return *this && _connection->peerOpen ? _connection->room : 0; }
+
+  virtual size_t write(uint8_t value) { return write(&value, 1); }
+  virtual size_t write(const uint8_t * data, size_t size)
+  {
+    size_t count = availableForWrite();
+    count = count < size ? count : size;
+
+    if (count)
+    {
+      _connection->output.append((const char *)data, count);
+      _connection->room -= count;
+    }
+
+    return count;
+  }
+  using Print::write;
+
+  void setNoDelay(bool) {}
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+  bool stop(unsigned int maxWaitMs)
+  {
+    if (_connection)
+    {
+      _connection->stopped = true;
+      _connection->stopWait = maxWaitMs;
+    }
+
+    return true;
+  }
+  void stop() { stop(0); }
+
+private:
+  WiFiFakeConnection * _connection;
+  unsigned long _timeout;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef WiFiServer_h
+#define WiFiServer_h
+
+#include <deque>
+#include "WiFiClient.h"
+
+//Connections waiting to be accepted, in the order they arrived
+inline std::deque<WiFiFakeConnection *> wifiFakeBacklog;
+
+class WiFiServer
+{
+public:
+  WiFiServer(uint16_t port) : _port(port) {}
+
+  void begin() {}
+  void setNoDelay(bool) {}
+
+  WiFiClient available()
+  {
+    if (wifiFakeBacklog.empty())
+    {
+      return WiFiClient();
+    }
+
+    WiFiFakeConnection * connection = wifiFakeBacklog.front();
+    wifiFakeBacklog.pop_front();
+    return WiFiClient(connection);
+  }
+
+private:
+  uint16_t _port;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef bearssl_h
+#define bearssl_h
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+//The SHA-256 and HMAC calls the modules make, with BearSSL's names and the same results. Only SHA-256 is
+//behind the vtable, and the HMAC output length is always the full 32 bytes.
+
+#define br_sha256_SIZE 32
+#define HOST_SHA256_BLOCK 64
+
+struct br_sha256_context
+{
+  uint8_t buffer[HOST_SHA256_BLOCK];
+  uint32_t state[8];
+  uint64_t count;
+};
+
+struct br_hash_class
+{
+  size_t size;
+};
+
+inline const br_hash_class br_sha256_vtable = { br_sha256_SIZE };
+
+inline const uint32_t hostSha256K[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t hostRotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline void hostSha256Block(uint32_t state[8], const uint8_t block[HOST_SHA256_BLOCK])
+{
+  uint32_t w[64];
+  uint32_t v[8];
+
+  for (int i = 0; i < 16; i++)
+  {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  }
+
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = hostRotr(w[i - 15], 7) ^ hostRotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = hostRotr(w[i - 2], 17) ^ hostRotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  memcpy(v, state, sizeof(v));
+
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t s1 = hostRotr(v[4], 6) ^ hostRotr(v[4], 11) ^ hostRotr(v[4], 25);
+    uint32_t t1 = v[7] + s1 + ((v[4] & v[5]) ^ (~v[4] & v[6])) + hostSha256K[i] + w[i];
+    uint32_t s0 = hostRotr(v[0], 2) ^ hostRotr(v[0], 13) ^ hostRotr(v[0], 22);
+    uint32_t t2 = s0 + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+    memmove(v + 1, v, 7 * sizeof(uint32_t));
+    v[4] += t1;
+    v[0] = t1 + t2;
+  }
+
+  for (int i = 0; i < 8; i++)
+  {
+    state[i] += v[i];
+  }
+}
+
+inline void br_sha256_init(br_sha256_context * context)
+{
+  static const uint32_t initial[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  memcpy(context->state, initial, sizeof(initial));
+  context->count = 0;
+}
+
+inline void br_sha256_update(br_sha256_context * context, const void * data, size_t len)
+{
+  const uint8_t * bytes = (const uint8_t *)data;
+
+  while (len)
+  {
+    size_t used = context->count % HOST_SHA256_BLOCK;
+    size_t count = HOST_SHA256_BLOCK - used < len ? HOST_SHA256_BLOCK - used : len;
+
+    memcpy(context->buffer + used, bytes, count);
+    context->count += count;
+    bytes += count;
+    len -= count;
+
+    if (used + count == HOST_SHA256_BLOCK)
+    {
+      hostSha256Block(context->state, context->buffer);
+    }
+  }
+}
+
+//Like BearSSL, the context can still be updated afterwards
+inline void br_sha256_out(const br_sha256_context * context, void * out)
+{
+  br_sha256_context last = *context;
+  uint64_t bits = context->count * 8;
+  uint8_t length[8];
+  uint8_t zero = 0;
+  uint8_t one = 0x80;
+
+  for (int i = 0; i < 8; i++)
+  {
+    length[i] = bits >> (56 - i * 8);
+  }
+
+  br_sha256_update(&last, &one, 1);
+
+  while (last.count % HOST_SHA256_BLOCK != HOST_SHA256_BLOCK - 8)
+  {
+    br_sha256_update(&last, &zero, 1);
+  }
+
+  br_sha256_update(&last, length, 8);
+
+  for (int i = 0; i < 8; i++)
+  {
+    ((uint8_t *)out)[i * 4] = last.state[i] >> 24;
+    ((uint8_t *)out)[i * 4 + 1] = last.state[i] >> 16;
+    ((uint8_t *)out)[i * 4 + 2] = last.state[i] >> 8;
+    ((uint8_t *)out)[i * 4 + 3] = last.state[i];
+  }
+}
+
+struct br_hmac_key_context
+{
+  uint8_t key[HOST_SHA256_BLOCK]; //keys longer than a block are hashed first, as HMAC says
+};
+
+struct br_hmac_context
+{
+  br_sha256_context inner;
+  uint8_t key[HOST_SHA256_BLOCK];
+};
+
+inline void br_hmac_key_init(br_hmac_key_context * keyContext, const br_hash_class * digest, const void * key, size_t len)
+{
+  memset(keyContext->key, 0, sizeof(keyContext->key));
+
+  if (len > HOST_SHA256_BLOCK)
+  {
+    br_sha256_context context;
+    br_sha256_init(&context);
+    br_sha256_update(&context, key, len);
+    br_sha256_out(&context, keyContext->key);
+  }
+  else
+  {
+    memcpy(keyContext->key, key, len);
+  }
+}
+
+inline void br_hmac_init(br_hmac_context * context, const br_hmac_key_context * keyContext, size_t outLen)
+{
+  uint8_t pad[HOST_SHA256_BLOCK];
+
+  memcpy(context->key, keyContext->key, sizeof(context->key));
+
+  for (int i = 0; i < HOST_SHA256_BLOCK; i++)
+  {
+    pad[i] = context->key[i] ^ 0x36;
+  }
+
+  br_sha256_init(&context->inner);
+  br_sha256_update(&context->inner, pad, sizeof(pad));
+}
+
+inline void br_hmac_update(br_hmac_context * context, const void * data, size_t len)
+{
+  br_sha256_update(&context->inner, data, len);
+}
+
+inline size_t br_hmac_out(const br_hmac_context * context, void * out)
+{
+  br_sha256_context outer;
+  uint8_t pad[HOST_SHA256_BLOCK];
+  uint8_t inner[br_sha256_SIZE];
+
+  br_sha256_out(&context->inner, inner);
+
+  for (int i = 0; i < HOST_SHA256_BLOCK; i++)
+  {
+    pad[i] = context->key[i] ^ 0x5c;
+  }
+
+  br_sha256_init(&outer);
+  br_sha256_update(&outer, pad, sizeof(pad));
+  br_sha256_update(&outer, inner, sizeof(inner));
+  br_sha256_out(&outer, out);
+  return br_sha256_SIZE;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef lwip_dns_h
+#define lwip_dns_h
+
+#include <inttypes.h>
+#include <string.h>
+
+//lwIP's non-blocking lookup. The test says what a lookup finds and whether it comes from the cache, which answers
+//straight away, or has to wait for hostDnsAnswer() the way a query to the server does.
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+struct ip4_addr_t
+{
+  uint32_t addr;
+};
+
+struct ip_addr_t
+{
+  ip4_addr_t ip4;
+  uint8_t type; //0 for IPv4
+};
+
+#define IP_IS_V4(address) ((address)->type == 0)
+#define ip_2_ip4(address) (&(address)->ip4)
+#define ip4_addr_get_u32(address) ((address)->addr)
+
+typedef void (*dns_found_callback)(const char * name, const ip_addr_t * address, void * arg);
+
+inline uint32_t hostDnsAddress = 0; //what lookups find, 0 for a host that doesn't exist
+inline bool hostDnsCached = true;
+inline uint32_t hostDnsLookups = 0;
+inline char hostDnsName[64];
+inline dns_found_callback hostDnsCallback = NULL;
+inline void * hostDnsArg = NULL;
+
+inline err_t dns_gethostbyname(const char * name, ip_addr_t * address, dns_found_callback found, void * arg)
+{
+  hostDnsLookups++;
+  strncpy(hostDnsName, name, sizeof(hostDnsName) - 1);
+
+  if (!hostDnsCached)
+  {
+    hostDnsCallback = found;
+    hostDnsArg = arg;
+    return ERR_INPROGRESS;
+  }
+
+  if (!hostDnsAddress)
+  {
+    return ERR_ARG;
+  }
+
+  address->ip4.addr = hostDnsAddress;
+  address->type = 0;
+  return ERR_OK;
+}
+
+//Answers the lookup that is waiting, with hostDnsAddress
+inline void hostDnsAnswer()
+{
+  ip_addr_t address = { { hostDnsAddress }, 0 };
+  dns_found_callback found = hostDnsCallback;
+
+  hostDnsCallback = NULL;
+
+  if (found)
+  {
+    found(hostDnsName, hostDnsAddress ? &address : NULL, hostDnsArg);
+  }
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include <unity.h>
+
+#include <string.h>
+#include "CommandArgs.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static uint8_t parse(CommandArgs &args, const char * line)
+{
+  return args.parse(line, strlen(line));
+}
+
+static void assertValue(const CommandArgs &args, CommandKey key, const char * expected)
+{
+  uint16_t len;
+  const char * value = args.get(key, len);
+
+  TEST_ASSERT_NOT_NULL(value);
+  TEST_ASSERT_EQUAL_UINT16(strlen(expected), len);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, value, len);
+}
+
+static void test_splits_command_line_into_spans()
+{
+  CommandArgs args;
+  const char * line = "UPDATEDISPLAY RED=255;GREEN=0;BLUE=12;";
+
+  TEST_ASSERT_EQUAL_UINT8(3, parse(args, line));
+  assertValue(args, KeyRed, "255");
+  assertValue(args, KeyGreen, "0");
+  assertValue(args, KeyBlue, "12");
+  TEST_ASSERT_FALSE(args.has(KeyFlashTime));
+
+  //Spans point into the line, nothing is copied
+  uint16_t len;
+  TEST_ASSERT_TRUE(args.get(KeyRed, len) == strstr(line, "255"));
+}
+
+static void test_keys_are_case_insensitive()
+{
+  CommandArgs args;
+
+  TEST_ASSERT_EQUAL_UINT8(2, parse(args, "SETSETTINGS ssid=home;UseDhcp=true;"));
+  assertValue(args, KeySsid, "home");
+  assertValue(args, KeyUseDhcp, "true");
+}
+
+static void test_values_keep_spaces_and_equals()
+{
+  CommandArgs args;
+
+  TEST_ASSERT_EQUAL_UINT8(2, parse(args, "MESSAGE MESSAGE=build 42 = green;PW=a=b;"));
+  assertValue(args, KeyMessage, "build 42 = green");
+  assertValue(args, KeyPw, "a=b");
+}
+
+static void test_unknown_empty_and_repeated_keys()
+{
+  CommandArgs args;
+
+  TEST_ASSERT_EQUAL_UINT8(1, parse(args, "X NOPE=1;RED=;GREEN=7;GREEN=9;"));
+  TEST_ASSERT_FALSE(args.has(KeyRed));
+  assertValue(args, KeyGreen, "7");
+}
+
+static void test_value_without_closing_semicolon_is_dropped()
+{
+  CommandArgs args;
+
+  TEST_ASSERT_EQUAL_UINT8(1, parse(args, "X RED=1;GREEN=2"));
+  assertValue(args, KeyRed, "1");
+  TEST_ASSERT_FALSE(args.has(KeyGreen));
+}
+
+static void test_parse_clears_previous_values()
+{
+  CommandArgs args;
+  parse(args, "X RED=1;");
+
+  TEST_ASSERT_EQUAL_UINT8(0, parse(args, "HELP"));
+  TEST_ASSERT_FALSE(args.has(KeyRed));
+}
+
+static void test_get_int()
+{
+  CommandArgs args;
+  parse(args, "X RED=255;GREEN=-12;BLUE=abc;INDEX=123456789012;");
+
+  TEST_ASSERT_EQUAL_INT32(255, args.getInt(KeyRed));
+  TEST_ASSERT_EQUAL_INT32(-12, args.getInt(KeyGreen));
+  TEST_ASSERT_EQUAL_INT32(0, args.getInt(KeyBlue));
+  TEST_ASSERT_EQUAL_INT32(0, args.getInt(KeyIndex));
+  TEST_ASSERT_EQUAL_INT32(0, args.getInt(KeyPeriod));
+}
+
+static void test_equals_ignore_case_and_get_string()
+{
+  CommandArgs args;
+  parse(args, "X EASE=True;SSID=my net;");
+
+  TEST_ASSERT_TRUE(args.equalsIgnoreCase(KeyEase, "TRUE"));
+  TEST_ASSERT_FALSE(args.equalsIgnoreCase(KeyEase, "TRU"));
+  TEST_ASSERT_FALSE(args.equalsIgnoreCase(KeyUseDhcp, "TRUE"));
+  TEST_ASSERT_EQUAL_STRING("my net", args.getString(KeySsid).c_str());
+  TEST_ASSERT_EQUAL_STRING("", args.getString(KeyPw).c_str());
+}
+
+static void test_set_follows_parse_rules()
+{
+  CommandArgs args;
+
+  TEST_ASSERT_TRUE(args.set(KeyPlain, "body", 4));
+  TEST_ASSERT_FALSE(args.set(KeyPlain, "again", 5));
+  TEST_ASSERT_FALSE(args.set(KeyRed, "", 0));
+  TEST_ASSERT_FALSE(args.set(CommandKeyCount, "1", 1));
+  assertValue(args, KeyPlain, "body");
+}
+
+static void test_key_names_round_trip()
+{
+  for (uint8_t i = 0; i < CommandKeyCount; i++)
+  {
+    const char * name = getCommandKeyName((CommandKey)i);
+    TEST_ASSERT_EQUAL_INT(i, getCommandKey(name, strlen(name)));
+  }
+
+  TEST_ASSERT_EQUAL_INT(CommandKeyCount, getCommandKey("ZONESX", 6));
+  TEST_ASSERT_EQUAL_INT(CommandKeyCount, getCommandKey("ZONE", 3));
+  TEST_ASSERT_EQUAL_STRING("unknown", getCommandKeyName(CommandKeyCount));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_splits_command_line_into_spans);
+  RUN_TEST(test_keys_are_case_insensitive);
+  RUN_TEST(test_values_keep_spaces_and_equals);
+  RUN_TEST(test_unknown_empty_and_repeated_keys);
+  RUN_TEST(test_value_without_closing_semicolon_is_dropped);
+  RUN_TEST(test_parse_clears_previous_values);
+  RUN_TEST(test_get_int);
+  RUN_TEST(test_equals_ignore_case_and_get_string);
+  RUN_TEST(test_set_follows_parse_rules);
+  RUN_TEST(test_key_names_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,209 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <new>
+#include <chrono>
+#include "CommandArgs.h"
+
+#define INPUT_LEN 256
+#define BENCH_COMMANDS 20000
+
+//Every allocation in the test binary goes through here, so the bench can show what each parse costs the heap
+static long _allocations = 0;
+
+void * operator new(size_t size)
+{
+  void * p = malloc(size);
+
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+
+  _allocations++;
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+/********Baseline Region*/
+
+//The lookup every command used before CommandArgs, kept as it was in main.cpp so the bench has something to
+//compare against. std::string stands in for the Arduino String: both copy by value onto the heap past a short
+//inline buffer, so the copies and substrings cost the same kind of allocations.
+
+static bool equalsIgnoreCase(const std::string &a, const std::string &b)
+{
+  return a.length() == b.length() && strncasecmp(a.c_str(), b.c_str(), a.length()) == 0;
+}
+
+static int findStringIgnoreCase(std::string source, std::string toFind, uint startIndex = 0)
+{
+
+  uint index = startIndex;
+  uint sourceLen = source.length();
+  uint toFindLen = toFind.length();
+
+  while(index + toFindLen < sourceLen)
+  {
+
+    if (equalsIgnoreCase(source.substr(index, toFindLen), toFind))
+    {
+      return index;
+    }
+
+    index++;
+  }
+
+  return -1;
+}
+
+static std::string getValueFromInputString(std::string input, std::string key)
+{
+  std::string value;
+  int index;
+  int endIndex;
+
+  //Jump out right away incase the input is empty so we don't have to worry about it causing any problems.
+  if (input.empty())
+  {
+    return value;
+  }
+
+  //First find the index of the key
+  index = findStringIgnoreCase(input, key + "=");
+
+  if (index < 0)
+  {
+    return value;
+  }
+
+  //Need to move to the next index so we are at the start of the value
+  index += key.length() + 1;
+
+  //Find the end of the value, should be the next ;
+  endIndex = input.find(";", index);
+
+  //If the endIndex <= index, there is no value
+  if (endIndex <= index)
+  {
+    return value;
+  }
+
+  return input.substr(index, endIndex - index);
+
+}
+
+/********End Baseline Region*/
+
+//Every key UPDATEDISPLAY reads, in the order the old handler looked them up
+static const CommandKey _keys[] = { KeyEffect, KeyProgress, KeyBrightness, KeyPeriod, KeyEase, KeyRed, KeyGreen, KeyBlue,
+  KeyFlashTime, KeyDisplayTime };
+#define KEY_COUNT (sizeof(_keys) / sizeof(_keys[0]))
+
+static std::string _input;
+
+void setUp()
+{
+  //A long note ahead of the keys pads the line out to INPUT_LEN, so every lookup has the whole line to scan
+  const char * keys = "EFFECT=BREATHE;PROGRESS=50;BRIGHTNESS=200;PERIOD=2000;EASE=true;RED=255;GREEN=128;BLUE=0;"
+    "FLASHTIME=5000;DISPLAYTIME=60000;";
+  _input = "UPDATEDISPLAY NOTE=";
+  _input.append(INPUT_LEN - _input.length() - 1 - strlen(keys), 'x');
+  _input += ";";
+  _input += keys;
+}
+
+void tearDown()
+{
+}
+
+static long sumBaseline()
+{
+  long sum = 0;
+
+  for (uint8_t i = 0; i < KEY_COUNT; i++)
+  {
+    sum += atol(getValueFromInputString(_input, getCommandKeyName(_keys[i])).c_str());
+  }
+
+  return sum;
+}
+
+static long sumCommandArgs()
+{
+  CommandArgs args;
+  long sum = 0;
+
+  args.parse(_input.c_str(), _input.length());
+
+  for (uint8_t i = 0; i < KEY_COUNT; i++)
+  {
+    sum += args.getInt(_keys[i]);
+  }
+
+  return sum;
+}
+
+static void test_both_read_the_same_values()
+{
+  TEST_ASSERT_EQUAL(INPUT_LEN, _input.length());
+  TEST_ASSERT_EQUAL(50 + 200 + 2000 + 255 + 128 + 5000 + 60000, sumBaseline());
+  TEST_ASSERT_EQUAL(sumBaseline(), sumCommandArgs());
+}
+
+static void test_bench_baseline_vs_command_args()
+{
+  volatile long sink = 0;
+
+  long allocations = _allocations;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < BENCH_COMMANDS; i++)
+  {
+    sink = sink + sumBaseline();
+  }
+
+  double baselineNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  long baselineAllocations = _allocations - allocations;
+
+  allocations = _allocations;
+  start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < BENCH_COMMANDS; i++)
+  {
+    sink = sink + sumCommandArgs();
+  }
+
+  double argsNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  long argsAllocations = _allocations - allocations;
+
+  printf("%u byte UPDATEDISPLAY, %u keys, %u commands\n", INPUT_LEN, (unsigned)KEY_COUNT, BENCH_COMMANDS);
+  printf("getValueFromInputString: %.0f ns, %.1f allocations per command\n", baselineNs / BENCH_COMMANDS,
+    (double)baselineAllocations / BENCH_COMMANDS);
+  printf("CommandArgs:             %.0f ns, %.1f allocations per command\n", argsNs / BENCH_COMMANDS,
+    (double)argsAllocations / BENCH_COMMANDS);
+
+  TEST_ASSERT_EQUAL(0, argsAllocations);
+  TEST_ASSERT_TRUE(argsNs < baselineNs);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_both_read_the_same_values);
+  RUN_TEST(test_bench_baseline_vs_command_args);
+  return UNITY_END();
+}
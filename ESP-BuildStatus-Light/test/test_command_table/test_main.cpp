@@ -0,0 +1,161 @@
+#include <unity.h>
+
+#include <string.h>
+#include "CommandTable.h"
+
+static int okHandler(const CommandArgs &args, Print &out)
+{
+  return 200;
+}
+
+//The names and routes of the firmware's table, the handlers don't matter here
+static const Command _commands[] =
+{
+  { "RESTART", NULL, okHandler, 0, 0 },
+  { "SETSETTINGS", NULL, okHandler, commandKeyBit(KeySsid) | commandKeyBit(KeyPw) | commandKeyBit(KeyUseDhcp), 0 },
+  { "HELP", NULL, okHandler, 0, 0 },
+  { "GETSTATUS", NULL, okHandler, 0, COMMAND_JSON },
+  { "GETUSERIDS", NULL, okHandler, 0, 0 },
+  { "SETUSERID", NULL, okHandler, commandKeyBit(KeyIndex) | commandKeyBit(KeyId), 0 },
+  { "CLEARUSERID", NULL, okHandler, commandKeyBit(KeyIndex), 0 },
+  { "SETDISPLAY", NULL, okHandler, 0, 0 },
+  { "SETMESSAGE", "/Display/Message", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { "SETBRIGHTNESS", "/Display/Brightness", okHandler, commandKeyBit(KeyLevel), COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/", okHandler, 0, 0 },
+  { NULL, "/Display", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Red", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Green", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Blue", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Yellow", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Purple", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/White", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Off", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Color", okHandler, 0, COMMAND_AUTH | COMMAND_JSON },
+  { NULL, "/Display/Pixels", okHandler, 0, COMMAND_AUTH },
+  { "UPDATEDISPLAY", "/Display/Update", okHandler, 0, COMMAND_AUTH },
+  { "SETZONES", "/Display/Zones", okHandler, commandKeyBit(KeyZones), COMMAND_AUTH | COMMAND_JSON },
+  { "SETPOLL", "/Poll", okHandler, commandKeyBit(KeyUrl) | commandKeyBit(KeyInterval), COMMAND_AUTH },
+  { "GETMETRICS", "/Metrics", okHandler, 0, COMMAND_STREAM },
+  { "PROFILE", "/Profile", okHandler, 0, COMMAND_AUTH | COMMAND_STREAM },
+};
+
+#define COMMAND_COUNT (sizeof(_commands) / sizeof(_commands[0]))
+
+constexpr CommandIndex _serialIndex = buildCommandIndex(_commands, false);
+constexpr CommandIndex _httpIndex = buildCommandIndex(_commands, true);
+static_assert(_serialIndex.seed < COMMAND_MAX_SEED, "No perfect hash for the serial commands");
+static_assert(_httpIndex.seed < COMMAND_MAX_SEED, "No perfect hash for the routes");
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static const Command * find(bool route, const char * name)
+{
+  return findCommand(_commands, route ? _httpIndex : _serialIndex, route, name, strlen(name));
+}
+
+static void test_every_name_and_route_finds_its_row()
+{
+  for (uint8_t i = 0; i < COMMAND_COUNT; i++)
+  {
+    if (_commands[i].name != NULL)
+    {
+      TEST_ASSERT_TRUE(find(false, _commands[i].name) == &_commands[i]);
+    }
+
+    if (_commands[i].route != NULL)
+    {
+      TEST_ASSERT_TRUE(find(true, _commands[i].route) == &_commands[i]);
+    }
+  }
+}
+
+static void test_index_has_one_slot_per_name()
+{
+  uint8_t names = 0;
+  uint8_t routes = 0;
+
+  for (uint8_t i = 0; i < COMMAND_COUNT; i++)
+  {
+    names += _commands[i].name != NULL;
+    routes += _commands[i].route != NULL;
+  }
+
+  for (uint8_t i = 0; i < COMMAND_SLOTS; i++)
+  {
+    names -= _serialIndex.slots[i] != COMMAND_NONE;
+    routes -= _httpIndex.slots[i] != COMMAND_NONE;
+  }
+
+  TEST_ASSERT_EQUAL_UINT8(0, names);
+  TEST_ASSERT_EQUAL_UINT8(0, routes);
+}
+
+static void test_serial_names_match_any_case()
+{
+  TEST_ASSERT_TRUE(find(false, "help") == &_commands[2]);
+  TEST_ASSERT_TRUE(find(false, "SetPoll") == &_commands[23]);
+}
+
+static void test_routes_match_case_exactly()
+{
+  TEST_ASSERT_NULL(find(true, "/display/red"));
+  TEST_ASSERT_NULL(find(true, "/METRICS"));
+}
+
+static void test_unknown_names_are_not_found()
+{
+  TEST_ASSERT_NULL(find(false, "HEL"));
+  TEST_ASSERT_NULL(find(false, "HELPX"));
+  TEST_ASSERT_NULL(find(false, ""));
+  TEST_ASSERT_NULL(find(false, "NOSUCHCOMMAND"));
+  TEST_ASSERT_NULL(find(true, "/Display/"));
+  TEST_ASSERT_NULL(find(true, "/Display/Redd"));
+}
+
+//A serial lookup must not reach HTTP only rows, or the other way round
+static void test_names_and_routes_are_separate()
+{
+  TEST_ASSERT_NULL(find(false, "/Display/Red"));
+  TEST_ASSERT_NULL(find(true, "SETPOLL"));
+  TEST_ASSERT_NULL(find(true, "RESTART"));
+}
+
+static void test_length_is_respected()
+{
+  //Only the first 4 characters are the name
+  TEST_ASSERT_TRUE(findCommand(_commands, _serialIndex, false, "HELP RED=1;", 4) == &_commands[2]);
+  TEST_ASSERT_NULL(findCommand(_commands, _serialIndex, false, "HELP", 3));
+}
+
+static void test_missing_required_keys()
+{
+  CommandArgs args;
+  const char * line = "SETSETTINGS SSID=home;PW=secret;";
+  args.parse(line, strlen(line));
+
+  TEST_ASSERT_EQUAL_INT(KeyUseDhcp, getMissingCommandKey(_commands[1], args));
+  TEST_ASSERT_EQUAL_INT(CommandKeyCount, getMissingCommandKey(_commands[2], args));
+
+  args.set(KeyUseDhcp, "true", 4);
+  TEST_ASSERT_EQUAL_INT(CommandKeyCount, getMissingCommandKey(_commands[1], args));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_name_and_route_finds_its_row);
+  RUN_TEST(test_index_has_one_slot_per_name);
+  RUN_TEST(test_serial_names_match_any_case);
+  RUN_TEST(test_routes_match_case_exactly);
+  RUN_TEST(test_unknown_names_are_not_found);
+  RUN_TEST(test_names_and_routes_are_separate);
+  RUN_TEST(test_length_is_respected);
+  RUN_TEST(test_missing_required_keys);
+  return UNITY_END();
+}
@@ -0,0 +1,193 @@
+#include <unity.h>
+
+#include <stddef.h>
+#include <string.h>
+#include <FS.h>
+#include <coredecls.h>
+#include "ConfigStore.h"
+
+#define PATH_A "/config.a"
+#define PATH_B "/config.b"
+#define VERSION 3
+
+struct TestConfig
+{
+  char ssid[16];
+  uint32_t interval;
+  uint8_t zones;
+};
+
+void setUp()
+{
+  SPIFFS.files.clear();
+  SPIFFS.writeBudget = -1;
+}
+
+void tearDown()
+{
+}
+
+static TestConfig makeConfig(const char * ssid, uint32_t interval)
+{
+  TestConfig config = {};
+  strcpy(config.ssid, ssid);
+  config.interval = interval;
+  config.zones = 2;
+  return config;
+}
+
+//A copy as ConfigStore would write it, for the cases a test can't reach through save()
+static void writeCopy(const char * path, uint16_t version, uint32_t sequence, const void * data, uint16_t size)
+{
+  ConfigHeader header = { CONFIG_MAGIC, version, size, sequence, 0 };
+  header.crc = crc32(data, size, crc32(&header, offsetof(ConfigHeader, crc)));
+
+  std::vector<uint8_t> & file = SPIFFS.files[path];
+  file.assign((const uint8_t *)&header, (const uint8_t *)(&header + 1));
+  file.insert(file.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+}
+
+static void assertLoads(const char * ssid, uint32_t interval, uint32_t sequence)
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig loaded;
+
+  TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL_STRING(ssid, loaded.ssid);
+  TEST_ASSERT_EQUAL_UINT32(interval, loaded.interval);
+  TEST_ASSERT_EQUAL_UINT32(sequence, store.getSequence());
+}
+
+static void test_nothing_saved_loads_zeroed()
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig loaded;
+  memset(&loaded, 0xAA, sizeof(loaded));
+
+  TEST_ASSERT_FALSE(store.load(&loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL_STRING("", loaded.ssid);
+  TEST_ASSERT_EQUAL_UINT32(0, loaded.interval);
+}
+
+static void test_saves_alternate_between_copies()
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig config = makeConfig("first", 10);
+
+  TEST_ASSERT_TRUE(store.save(&config, sizeof(config)));
+  TEST_ASSERT_TRUE(SPIFFS.exists(PATH_A));
+  TEST_ASSERT_FALSE(SPIFFS.exists(PATH_B));
+
+  config = makeConfig("second", 20);
+  TEST_ASSERT_TRUE(store.save(&config, sizeof(config)));
+  TEST_ASSERT_TRUE(SPIFFS.exists(PATH_B));
+
+  std::vector<uint8_t> b = SPIFFS.files[PATH_B];
+  config = makeConfig("third", 30);
+  TEST_ASSERT_TRUE(store.save(&config, sizeof(config)));
+  TEST_ASSERT_TRUE(b == SPIFFS.files[PATH_B]);
+
+  assertLoads("third", 30, 3);
+}
+
+static void test_corrupt_newest_copy_falls_back()
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig config = makeConfig("old", 10);
+  store.save(&config, sizeof(config));
+  config = makeConfig("new", 20);
+  store.save(&config, sizeof(config));
+
+  SPIFFS.files[PATH_B][sizeof(ConfigHeader) + 1] ^= 0x01;
+
+  assertLoads("old", 10, 1);
+}
+
+static void test_power_lost_during_save_keeps_last_good_copy()
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig config = makeConfig("good", 10);
+  store.save(&config, sizeof(config));
+  config = makeConfig("better", 20);
+  store.save(&config, sizeof(config));
+
+  //The next save goes over A, the older copy, and stops part way through the data
+  SPIFFS.writeBudget = sizeof(ConfigHeader) + 4;
+  config = makeConfig("lost", 30);
+  TEST_ASSERT_FALSE(store.save(&config, sizeof(config)));
+  SPIFFS.writeBudget = -1;
+
+  assertLoads("better", 20, 2);
+
+  //And the store still knows B is current, so a retry goes to A again
+  TEST_ASSERT_TRUE(store.save(&config, sizeof(config)));
+  assertLoads("lost", 30, 3);
+}
+
+static void test_both_copies_bad_loads_zeroed()
+{
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig config = makeConfig("one", 10);
+  store.save(&config, sizeof(config));
+  store.save(&config, sizeof(config));
+  SPIFFS.files[PATH_A].resize(sizeof(ConfigHeader) + 2);
+  SPIFFS.files[PATH_B][0] ^= 0xFF;
+
+  ConfigStore reloaded(PATH_A, PATH_B, VERSION);
+  TestConfig loaded;
+  TEST_ASSERT_FALSE(reloaded.load(&loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL_STRING("", loaded.ssid);
+}
+
+static void test_sequence_wrap_still_picks_newest()
+{
+  TestConfig older = makeConfig("older", 10);
+  TestConfig newer = makeConfig("newer", 20);
+  writeCopy(PATH_A, VERSION, 0xFFFFFFFF, &older, sizeof(older));
+  writeCopy(PATH_B, VERSION, 0, &newer, sizeof(newer));
+
+  assertLoads("newer", 20, 0);
+}
+
+static void test_other_version_is_ignored()
+{
+  TestConfig current = makeConfig("current", 10);
+  TestConfig other = makeConfig("other", 20);
+  writeCopy(PATH_A, VERSION, 1, &current, sizeof(current));
+  writeCopy(PATH_B, VERSION + 1, 2, &other, sizeof(other));
+
+  assertLoads("current", 10, 1);
+}
+
+//Older firmware wrote a shorter record, the fields it didn't have load as zero. A longer one can't be trusted.
+static void test_record_size_changes()
+{
+  TestConfig config = makeConfig("short", 10);
+  config.zones = 0;
+  writeCopy(PATH_A, VERSION, 1, &config, offsetof(TestConfig, zones));
+
+  ConfigStore store(PATH_A, PATH_B, VERSION);
+  TestConfig loaded;
+  memset(&loaded, 0xAA, sizeof(loaded));
+  TEST_ASSERT_TRUE(store.load(&loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL_STRING("short", loaded.ssid);
+  TEST_ASSERT_EQUAL_UINT8(0, loaded.zones);
+
+  uint8_t longer[sizeof(TestConfig) + 8] = {};
+  writeCopy(PATH_B, VERSION, 2, longer, sizeof(longer));
+  assertLoads("short", 10, 1);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_saved_loads_zeroed);
+  RUN_TEST(test_saves_alternate_between_copies);
+  RUN_TEST(test_corrupt_newest_copy_falls_back);
+  RUN_TEST(test_power_lost_during_save_keeps_last_good_copy);
+  RUN_TEST(test_both_copies_bad_loads_zeroed);
+  RUN_TEST(test_sequence_wrap_still_picks_newest);
+  RUN_TEST(test_other_version_is_ignored);
+  RUN_TEST(test_record_size_changes);
+  return UNITY_END();
+}
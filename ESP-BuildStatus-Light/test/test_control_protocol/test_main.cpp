@@ -0,0 +1,328 @@
+#include <unity.h>
+
+#include <bearssl/bearssl.h>
+#include "ControlProtocol.h"
+
+#define USER_ID "secret-user-id"
+#define OTHER_USER_ID "another-user-id"
+
+//SHA-256 of each User Id, truncated like the stored digests. Token 3 has no User Id.
+static uint8_t digests[2][CONTROL_KEY_SIZE];
+
+static bool lookupKey(uint8_t tokenId, uint8_t key[CONTROL_KEY_SIZE])
+{
+  if (tokenId < 1 || tokenId > 2)
+  {
+    return false;
+  }
+
+  deriveControlKey(digests[tokenId - 1], key);
+  return true;
+}
+
+static void storeDigest(uint8_t index, const char * userId)
+{
+  br_sha256_context context;
+  uint8_t hash[32];
+
+  br_sha256_init(&context);
+  br_sha256_update(&context, userId, strlen(userId));
+  br_sha256_out(&context, hash);
+  memcpy(digests[index], hash, CONTROL_KEY_SIZE);
+}
+
+//What a sender on another machine does: knows its User Id and token id, learns the boot id from acks
+//and counts its sequence up
+struct HostSender
+{
+  uint8_t tokenId;
+  uint8_t key[CONTROL_KEY_SIZE];
+  uint32_t sequence;
+  uint32_t bootId;
+  uint8_t frame[CONTROL_MAX_FRAME];
+  size_t length;
+
+  HostSender(const char * userId, uint8_t id)
+  {
+    tokenId = id;
+    getControlKey(userId, strlen(userId), key);
+    sequence = 0;
+    bootId = 0;
+    length = 0;
+  }
+
+  const uint8_t * build(uint8_t opcode, uint8_t zone, const uint8_t * payload, uint16_t payloadLen)
+  {
+    uint32_t values[2] = { ++sequence, bootId };
+
+    frame[0] = CONTROL_MAGIC_0;
+    frame[1] = CONTROL_MAGIC_1;
+    frame[2] = CONTROL_VERSION;
+    frame[3] = opcode;
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      frame[4 + i] = values[i / 4] >> (i % 4 * 8);
+    }
+
+    frame[12] = tokenId;
+    frame[13] = zone;
+    frame[14] = payloadLen;
+    frame[15] = payloadLen >> 8;
+    memcpy(frame + CONTROL_HEADER_SIZE, payload, payloadLen);
+    length = CONTROL_HEADER_SIZE + payloadLen + CONTROL_MAC_SIZE;
+    signControlFrame(frame, length, key);
+    return frame;
+  }
+
+  const uint8_t * buildColor(uint8_t red, uint8_t green, uint8_t blue)
+  {
+    const uint8_t payload[CONTROL_COLOR_SIZE] = { red, green, blue, 0xE8, 0x03, 0xD0, 0x07 };
+    return build(OpColor, 0, payload, sizeof(payload));
+  }
+};
+
+static ControlReceiver receiver(lookupKey);
+static ControlFrame frame;
+
+//Sends the frame and reads the ack back like the sender would, taking the boot id from it
+static ControlResult sendFrame(HostSender &sender, const uint8_t * data, size_t length)
+{
+  uint8_t ack[CONTROL_ACK_SIZE];
+  ControlResult result = receiver.receive(data, length, frame);
+
+  buildControlAck(frame.sequence, receiver.getBootId(), result, ack);
+  TEST_ASSERT_EQUAL_UINT8(CONTROL_MAGIC_0, ack[0]);
+  TEST_ASSERT_EQUAL_UINT8(CONTROL_MAGIC_1, ack[1]);
+  TEST_ASSERT_EQUAL_UINT8(CONTROL_VERSION, ack[2]);
+  TEST_ASSERT_EQUAL_UINT8(result, ack[3]);
+  TEST_ASSERT_EQUAL_UINT32(frame.sequence, readControlUint32(ack + 4));
+  sender.bootId = readControlUint32(ack + 8);
+  return result;
+}
+
+static ControlResult send(HostSender &sender)
+{
+  return sendFrame(sender, sender.frame, sender.length);
+}
+
+void setUp()
+{
+  storeDigest(0, USER_ID);
+  storeDigest(1, OTHER_USER_ID);
+  receiver = ControlReceiver(lookupKey);
+  receiver.begin(0x12345678);
+}
+
+void tearDown()
+{
+}
+
+//Worked out with Python's hmac and hashlib, so a sender written in anything gets the same bytes
+static void test_key_and_mac_match_a_reference()
+{
+  const uint8_t expectedKey[CONTROL_KEY_SIZE] = { 0x14, 0x7f, 0xea, 0x6e, 0x5a, 0xd1, 0xe6, 0xfa, 0xfa, 0xce, 0x1e, 0xe0, 0x4a, 0x40, 0x21, 0xba };
+  const uint8_t expectedMac[CONTROL_MAC_SIZE] = { 0x88, 0x6e, 0xb4, 0x1d, 0xb4, 0x75, 0xdf, 0xb3, 0x3d, 0x74, 0xb1, 0xa6, 0x85, 0xdc, 0x5c, 0x2e };
+  HostSender sender(USER_ID, 1);
+  uint8_t lightKey[CONTROL_KEY_SIZE];
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expectedKey, sender.key, CONTROL_KEY_SIZE);
+  TEST_ASSERT_TRUE(lookupKey(1, lightKey));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expectedKey, lightKey, CONTROL_KEY_SIZE);
+
+  sender.sequence = 6;
+  sender.bootId = 0x12345678;
+  sender.buildColor(255, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expectedMac, sender.frame + sender.length - CONTROL_MAC_SIZE, CONTROL_MAC_SIZE);
+}
+
+static void test_first_frame_learns_the_boot_id()
+{
+  HostSender sender(USER_ID, 1);
+
+  sender.buildColor(255, 0, 0);
+  TEST_ASSERT_EQUAL(ControlWrongBoot, send(sender));
+  TEST_ASSERT_EQUAL_UINT32(0x12345678, sender.bootId);
+
+  sender.buildColor(255, 0, 0);
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  TEST_ASSERT_EQUAL(OpColor, frame.opcode);
+  TEST_ASSERT_EQUAL(1, frame.tokenId);
+  TEST_ASSERT_EQUAL(CONTROL_COLOR_SIZE, frame.payloadLen);
+  TEST_ASSERT_EQUAL_UINT8(255, frame.payload[0]);
+  TEST_ASSERT_EQUAL_UINT16(1000, readControlUint16(frame.payload + 3));
+  TEST_ASSERT_EQUAL_UINT16(2000, readControlUint16(frame.payload + 5));
+}
+
+static void test_replayed_and_older_frames_are_stale()
+{
+  HostSender sender(USER_ID, 1);
+  uint8_t older[CONTROL_MAX_FRAME];
+  size_t olderLength;
+  sender.bootId = receiver.getBootId();
+
+  sender.buildColor(1, 2, 3);
+  memcpy(older, sender.frame, sender.length);
+  olderLength = sender.length;
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  TEST_ASSERT_EQUAL(ControlStale, send(sender));
+
+  sender.buildColor(4, 5, 6);
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  TEST_ASSERT_EQUAL(ControlStale, sendFrame(sender, older, olderLength));
+  TEST_ASSERT_EQUAL_UINT32(2, receiver.getCount(ControlStale));
+
+  //Each token keeps its own sequence
+  HostSender other(OTHER_USER_ID, 2);
+  other.bootId = receiver.getBootId();
+  other.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlOk, send(other));
+}
+
+//A new boot id on restart makes every frame captured before it useless, even though the sequences are forgotten
+static void test_frames_from_before_a_restart_are_refused()
+{
+  HostSender sender(USER_ID, 1);
+  uint8_t captured[CONTROL_MAX_FRAME];
+  size_t capturedLength;
+  sender.bootId = receiver.getBootId();
+
+  sender.buildColor(1, 2, 3);
+  memcpy(captured, sender.frame, sender.length);
+  capturedLength = sender.length;
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+
+  receiver.begin(0xCAFE);
+
+  TEST_ASSERT_EQUAL(ControlWrongBoot, sendFrame(sender, captured, capturedLength));
+  TEST_ASSERT_EQUAL_UINT32(0xCAFE, sender.bootId);
+
+  //Changing the boot id in the captured frame breaks its MAC
+  captured[8] = 0xFE;
+  captured[9] = 0xCA;
+  captured[10] = 0;
+  captured[11] = 0;
+  TEST_ASSERT_EQUAL(ControlBadMac, sendFrame(sender, captured, capturedLength));
+
+  sender.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+}
+
+//A forged frame is refused before its sequence is recorded, so the real frame with that sequence still goes through
+static void test_bad_mac()
+{
+  HostSender sender(USER_ID, 1);
+  HostSender forger(OTHER_USER_ID, 1);
+  sender.bootId = receiver.getBootId();
+  forger.bootId = receiver.getBootId();
+
+  sender.buildColor(1, 2, 3);
+  sender.frame[CONTROL_HEADER_SIZE] ^= 1;
+  TEST_ASSERT_EQUAL(ControlBadMac, send(sender));
+  sender.frame[CONTROL_HEADER_SIZE] ^= 1;
+  sender.frame[sender.length - 1] ^= 0x80;
+  TEST_ASSERT_EQUAL(ControlBadMac, send(sender));
+
+  //Signed with another User Id's key but claiming token 1, with a sequence far ahead
+  forger.sequence = 1000000;
+  forger.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlBadMac, send(forger));
+
+  sender.sequence = 0;
+  sender.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  TEST_ASSERT_EQUAL_UINT32(3, receiver.getCount(ControlBadMac));
+}
+
+static void test_sequence_wraps()
+{
+  HostSender sender(USER_ID, 1);
+  uint8_t beforeWrap[CONTROL_MAX_FRAME];
+  size_t beforeWrapLength;
+  sender.bootId = receiver.getBootId();
+  sender.sequence = 0xFFFFFFFD;
+
+  sender.buildColor(1, 2, 3);
+  memcpy(beforeWrap, sender.frame, sender.length);
+  beforeWrapLength = sender.length;
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+
+  for (int i = 0; i < 4; i++)
+  {
+    sender.buildColor(1, 2, 3);
+    TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(2, frame.sequence);
+  TEST_ASSERT_EQUAL(ControlStale, sendFrame(sender, beforeWrap, beforeWrapLength));
+}
+
+static void test_malformed_frames()
+{
+  HostSender sender(USER_ID, 1);
+  HostSender unknown(USER_ID, 3);
+  HostSender outOfRange(USER_ID, CONTROL_TOKEN_COUNT + 1);
+  sender.bootId = receiver.getBootId();
+
+  sender.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlBadFrame, sendFrame(sender, sender.frame, CONTROL_HEADER_SIZE + CONTROL_MAC_SIZE - 1));
+  TEST_ASSERT_EQUAL(ControlBadFrame, sendFrame(sender, sender.frame, sender.length - 1));
+
+  sender.frame[0] = 'X';
+  TEST_ASSERT_EQUAL(ControlBadFrame, send(sender));
+
+  sender.buildColor(1, 2, 3);
+  sender.frame[2] = CONTROL_VERSION + 1;
+  TEST_ASSERT_EQUAL(ControlBadVersion, send(sender));
+
+  //A payload length past the end of the packet
+  sender.buildColor(1, 2, 3);
+  sender.frame[15] = 1;
+  TEST_ASSERT_EQUAL(ControlBadFrame, send(sender));
+
+  unknown.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlUnknownToken, send(unknown));
+  outOfRange.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlUnknownToken, send(outOfRange));
+  sender.tokenId = 0;
+  sender.buildColor(1, 2, 3);
+  TEST_ASSERT_EQUAL(ControlUnknownToken, send(sender));
+
+  TEST_ASSERT_EQUAL_UINT32(4, receiver.getCount(ControlBadFrame));
+  TEST_ASSERT_EQUAL_UINT32(1, receiver.getCount(ControlBadVersion));
+  TEST_ASSERT_EQUAL_UINT32(3, receiver.getCount(ControlUnknownToken));
+  TEST_ASSERT_EQUAL_UINT32(0, receiver.getCount(ControlOk));
+}
+
+static void test_largest_payload()
+{
+  HostSender sender(USER_ID, 2);
+  uint8_t payload[CONTROL_MAX_PAYLOAD];
+  storeDigest(1, USER_ID);
+  sender.bootId = receiver.getBootId();
+
+  for (int i = 0; i < CONTROL_MAX_PAYLOAD; i++)
+  {
+    payload[i] = i;
+  }
+
+  sender.build(OpPixels, 3, payload, sizeof(payload));
+  TEST_ASSERT_EQUAL(CONTROL_MAX_FRAME, sender.length);
+  TEST_ASSERT_EQUAL(ControlOk, send(sender));
+  TEST_ASSERT_EQUAL(3, frame.zone);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(payload, frame.payload, CONTROL_MAX_PAYLOAD);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_key_and_mac_match_a_reference);
+  RUN_TEST(test_first_frame_learns_the_boot_id);
+  RUN_TEST(test_replayed_and_older_frames_are_stale);
+  RUN_TEST(test_frames_from_before_a_restart_are_refused);
+  RUN_TEST(test_bad_mac);
+  RUN_TEST(test_sequence_wraps);
+  RUN_TEST(test_malformed_frames);
+  RUN_TEST(test_largest_payload);
+  return UNITY_END();
+}
@@ -0,0 +1,325 @@
+#include <unity.h>
+
+#include <string>
+#include "HttpServer.h"
+
+#define CONNECTION_COUNT 8
+
+static HttpServer server(80);
+static WiFiFakeConnection connections[CONNECTION_COUNT];
+static int handled;
+static std::string lastPath;
+static std::string lastArgs;
+static std::string lastBody;
+static size_t replyLength; //0 sends the path back, more streams that many bytes
+
+static void handleRequest(HttpRequest &request)
+{
+  handled++;
+  lastPath.assign(request.path(), request.pathLength());
+  lastArgs.clear();
+
+  for (uint8_t i = 0; i < request.argCount(); i++)
+  {
+    const HttpArg &arg = request.arg(i);
+    lastArgs.append(arg.name, arg.nameLen).append("=").append(arg.value, arg.valueLen).append(";");
+  }
+
+  lastBody.assign(request.body() ? request.body() : "", request.bodyLength());
+
+  if (replyLength)
+  {
+    std::string content(replyLength, 'x');
+    request.beginResponse(200, "text/plain");
+    request.write((const uint8_t *)content.data(), content.size());
+  }
+  else
+  {
+    request.send(200, "text/plain", lastPath.c_str(), lastPath.size());
+  }
+}
+
+void setUp()
+{
+  //Drain whatever an earlier test left in the pool
+  for (int i = 0; i < CONNECTION_COUNT; i++)
+  {
+    connections[i].peerOpen = false;
+  }
+
+  wifiFakeBacklog.clear();
+  server.poll();
+
+  for (int i = 0; i < CONNECTION_COUNT; i++)
+  {
+    connections[i] = WiFiFakeConnection();
+  }
+
+  server.begin();
+  server.onRequest(handleRequest);
+  handled = 0;
+  replyLength = 0;
+}
+
+void tearDown()
+{
+}
+
+static WiFiFakeConnection &connect(int index, const char * input = "")
+{
+  connections[index].input = input;
+  wifiFakeBacklog.push_back(&connections[index]);
+  return connections[index];
+}
+
+static bool startsWith(const std::string &text, const char * prefix)
+{
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static void test_get_with_query()
+{
+  WiFiFakeConnection &client = connect(0, "GET /light%20one?zone=2&color=%23FF0000 HTTP/1.1\r\nHost: x\r\n\r\n");
+  uint32_t served = server.requestsServed();
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL(1, handled);
+  TEST_ASSERT_EQUAL_STRING("/light one", lastPath.c_str());
+  TEST_ASSERT_EQUAL_STRING("zone=2;color=#FF0000;", lastArgs.c_str());
+  TEST_ASSERT_TRUE(startsWith(client.output, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n"));
+  TEST_ASSERT_TRUE(client.output.find("\r\n\r\n/light one") != std::string::npos);
+  TEST_ASSERT_TRUE(client.stopped);
+  TEST_ASSERT_EQUAL(HTTP_CLOSE_WAIT, client.stopWait);
+  TEST_ASSERT_EQUAL_UINT32(served + 1, server.requestsServed());
+  TEST_ASSERT_EQUAL(0, server.activeConnections());
+}
+
+static void test_dripped_bytes_one_per_poll()
+{
+  const char * request = "POST /update HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                         "Content-Length: 13\r\n\r\nname=a+b&on=1";
+  WiFiFakeConnection &client = connect(0);
+
+  for (const char * c = request; *c; c++)
+  {
+    TEST_ASSERT_EQUAL(0, handled);
+    client.input += *c;
+    server.poll();
+    hostMicros += 1000;
+  }
+
+  TEST_ASSERT_EQUAL(1, handled);
+  TEST_ASSERT_EQUAL_STRING("/update", lastPath.c_str());
+  TEST_ASSERT_EQUAL_STRING("name=a b;on=1;", lastArgs.c_str());
+  TEST_ASSERT_EQUAL(0, lastBody.size());
+  TEST_ASSERT_TRUE(client.stopped);
+}
+
+static void test_plain_body()
+{
+  connect(0, "POST /pixels HTTP/1.1\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nAAAA=");
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL(1, handled);
+  TEST_ASSERT_EQUAL_STRING("AAAA=", lastBody.c_str());
+  TEST_ASSERT_EQUAL_STRING("", lastArgs.c_str());
+}
+
+static void assertRejected(const char * input, const char * statusLine)
+{
+  WiFiFakeConnection &client = connect(0, input);
+  uint32_t rejected = server.requestsRejected();
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL(0, handled);
+  TEST_ASSERT_TRUE(startsWith(client.output, statusLine));
+  TEST_ASSERT_TRUE(client.stopped);
+  TEST_ASSERT_EQUAL_UINT32(rejected + 1, server.requestsRejected());
+  setUp();
+}
+
+static void test_bad_requests()
+{
+  assertRejected("GET\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("GET /\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("GET / SPDY/3\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", "HTTP/1.1 501 Not Implemented\r\n");
+}
+
+//A \r that doesn't start a \r\n used to be taken as the line's end, and a line with none at all stored
+//through the NULL memchr gave back
+static void test_stray_cr_is_rejected()
+{
+  assertRejected("GET / HTTP/1.1\r\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("GET /\r HTTP/1.1\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("GET / HTTP/1.1\r\nHost: x\r\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+  assertRejected("GET / HTTP/1.1\r\nHost:\rx\r\n\r\n", "HTTP/1.1 400 Bad Request\r\n");
+}
+
+static void test_too_large()
+{
+  std::string headers = "GET / HTTP/1.1\r\nX-Pad: " + std::string(HTTP_REQUEST_SIZE, 'a');
+  assertRejected(headers.c_str(), "HTTP/1.1 413 Payload Too Large\r\n");
+  assertRejected("POST / HTTP/1.1\r\nContent-Length: 1020\r\n\r\n", "HTTP/1.1 413 Payload Too Large\r\n");
+  assertRejected("POST / HTTP/1.1\r\nContent-Length: 99999999999\r\n\r\n", "HTTP/1.1 413 Payload Too Large\r\n");
+}
+
+static void test_slow_request_times_out()
+{
+  WiFiFakeConnection &client = connect(0, "GET / HTTP/1.1\r\n");
+
+  server.poll();
+  hostMicros += (HTTP_TIMEOUT - 1) * 1000UL;
+  server.poll();
+  TEST_ASSERT_TRUE(client.output.empty());
+  TEST_ASSERT_EQUAL(1, server.activeConnections());
+
+  hostMicros += 1000;
+  server.poll();
+
+  TEST_ASSERT_EQUAL(0, handled);
+  TEST_ASSERT_TRUE(startsWith(client.output, "HTTP/1.1 408 Request Timeout\r\n"));
+  TEST_ASSERT_EQUAL(0, server.activeConnections());
+}
+
+static void test_client_gone_before_request_done()
+{
+  WiFiFakeConnection &client = connect(0, "GET / HT");
+
+  server.poll();
+  client.peerOpen = false;
+  server.poll();
+
+  TEST_ASSERT_EQUAL(0, handled);
+  TEST_ASSERT_TRUE(client.output.empty());
+  TEST_ASSERT_TRUE(client.stopped);
+  TEST_ASSERT_EQUAL(0, server.activeConnections());
+}
+
+//A client that never acks fills the send buffer, the reply waits HTTP_WRITE_BUDGET for it and drops the rest
+static void test_full_send_buffer_cuts_the_reply()
+{
+  WiFiFakeConnection &client = connect(0, "GET / HTTP/1.1\r\n\r\n");
+  uint32_t cut = server.repliesCut();
+  uint64_t startedAt = hostMicros;
+  client.room = 200;
+  replyLength = 4000;
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL(1, handled);
+  TEST_ASSERT_EQUAL(200, client.output.size());
+  TEST_ASSERT_EQUAL_UINT32(cut + 1, server.repliesCut());
+  TEST_ASSERT_TRUE(hostMicros - startedAt >= HTTP_WRITE_BUDGET * 1000UL);
+  TEST_ASSERT_TRUE(hostMicros - startedAt < (HTTP_WRITE_BUDGET + 2) * 1000UL);
+  TEST_ASSERT_TRUE(client.stopped);
+}
+
+static void test_reply_that_fits_is_not_cut()
+{
+  WiFiFakeConnection &client = connect(0, "GET / HTTP/1.1\r\n\r\n");
+  uint32_t cut = server.repliesCut();
+  client.room = 8000;
+  replyLength = 4000;
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL_UINT32(cut, server.repliesCut());
+  TEST_ASSERT_EQUAL(std::string::npos, client.output.find("Content-Length"));
+  TEST_ASSERT_EQUAL(4000, client.output.size() - client.output.find("\r\n\r\n") - 4);
+}
+
+//Only HTTP_MAX_CONNECTIONS are accepted, the rest wait in the backlog until a slot frees up
+static void test_pool_exhaustion()
+{
+  for (int i = 0; i < HTTP_MAX_CONNECTIONS + 2; i++)
+  {
+    connect(i, "GET /");
+  }
+
+  server.poll();
+
+  TEST_ASSERT_EQUAL(HTTP_MAX_CONNECTIONS, server.activeConnections());
+  TEST_ASSERT_EQUAL(2, wifiFakeBacklog.size());
+
+  connections[1].input += " HTTP/1.1\r\n\r\n";
+  server.poll();
+
+  TEST_ASSERT_EQUAL(1, handled);
+  TEST_ASSERT_TRUE(connections[1].stopped);
+  TEST_ASSERT_EQUAL(HTTP_MAX_CONNECTIONS - 1, server.activeConnections());
+
+  //The freed slot takes the next waiting client on the following poll
+  server.poll();
+  TEST_ASSERT_EQUAL(HTTP_MAX_CONNECTIONS, server.activeConnections());
+  TEST_ASSERT_EQUAL(1, wifiFakeBacklog.size());
+}
+
+//Clients sending at once, each a byte at a time, in an interleaved order, all get their own reply
+static void test_concurrent_clients()
+{
+  char requests[CONNECTION_COUNT][64];
+  size_t sent[CONNECTION_COUNT] = {};
+  int done = 0;
+
+  for (int i = 0; i < CONNECTION_COUNT; i++)
+  {
+    snprintf(requests[i], sizeof(requests[i]), "GET /client/%d?n=%d HTTP/1.1\r\nHost: light\r\n\r\n", i, i * 7);
+    connect(i);
+  }
+
+  for (int round = 0; done < CONNECTION_COUNT && round < 1000; round++)
+  {
+    for (int i = 0; i < CONNECTION_COUNT; i++)
+    {
+      size_t step = (i + round) % 3 + 1;
+
+      while (step-- && requests[i][sent[i]])
+      {
+        connections[i].input += requests[i][sent[i]++];
+      }
+    }
+
+    server.poll();
+    TEST_ASSERT_TRUE(server.activeConnections() <= HTTP_MAX_CONNECTIONS);
+    hostMicros += 1000;
+
+    done = 0;
+
+    for (int i = 0; i < CONNECTION_COUNT; i++)
+    {
+      done += connections[i].stopped;
+    }
+  }
+
+  TEST_ASSERT_EQUAL(CONNECTION_COUNT, handled);
+
+  for (int i = 0; i < CONNECTION_COUNT; i++)
+  {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "\r\n\r\n/client/%d", i);
+    TEST_ASSERT_TRUE(startsWith(connections[i].output, "HTTP/1.1 200 OK\r\n"));
+    TEST_ASSERT_TRUE(connections[i].output.find(expected) != std::string::npos);
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_get_with_query);
+  RUN_TEST(test_dripped_bytes_one_per_poll);
+  RUN_TEST(test_plain_body);
+  RUN_TEST(test_bad_requests);
+  RUN_TEST(test_stray_cr_is_rejected);
+  RUN_TEST(test_too_large);
+  RUN_TEST(test_slow_request_times_out);
+  RUN_TEST(test_client_gone_before_request_done);
+  RUN_TEST(test_full_send_buffer_cuts_the_reply);
+  RUN_TEST(test_reply_that_fits_is_not_cut);
+  RUN_TEST(test_pool_exhaustion);
+  RUN_TEST(test_concurrent_clients);
+  return UNITY_END();
+}
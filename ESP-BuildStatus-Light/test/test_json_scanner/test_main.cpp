@@ -0,0 +1,160 @@
+#include <unity.h>
+
+#include <string.h>
+#include "JsonScanner.h"
+
+static const char * const _fields[] = { "status", "branch", "commit.author.name", "runs[].conclusion" };
+
+static JsonScanner _scanner;
+
+void setUp()
+{
+  _scanner.setFields(_fields, 4);
+}
+
+void tearDown()
+{
+}
+
+static bool feed(const char * json)
+{
+  return _scanner.feed(json, strlen(json));
+}
+
+static void assertField(uint8_t field, const char * expected)
+{
+  TEST_ASSERT_TRUE(_scanner.isFound(field));
+  TEST_ASSERT_EQUAL_STRING(expected, _scanner.getValue(field));
+}
+
+static const char * _document =
+  "{\"id\": 12, \"status\": \"failed\", \"runs\": [{\"conclusion\": \"skipped\"}, {\"conclusion\": \"failure\"}],"
+  " \"commit\": {\"sha\": \"abc\", \"author\": {\"name\": \"Sam \\\"QA\\\" Lee\", \"email\": \"s@example.com\"}},"
+  " \"branch\": \"main\", \"extra\": [1, 2.5e3, true, false, null, [], {}]}";
+
+static void test_finds_nested_fields()
+{
+  TEST_ASSERT_TRUE(feed(_document));
+
+  TEST_ASSERT_TRUE(_scanner.isDone());
+  TEST_ASSERT_FALSE(_scanner.hasError());
+  assertField(0, "failed");
+  assertField(1, "main");
+  assertField(2, "Sam \"QA\" Lee");
+  //The first element wins
+  assertField(3, "skipped");
+}
+
+static void test_same_result_a_byte_at_a_time()
+{
+  for (const char * p = _document; *p; p++)
+  {
+    TEST_ASSERT_TRUE(_scanner.feed(p, 1));
+  }
+
+  TEST_ASSERT_TRUE(_scanner.isDone());
+  assertField(0, "failed");
+  assertField(1, "main");
+  assertField(2, "Sam \"QA\" Lee");
+  assertField(3, "skipped");
+}
+
+static void test_literals_are_kept_as_written()
+{
+  TEST_ASSERT_TRUE(feed("{\"status\": -12.5e+3, \"branch\": null, \"runs\": [{\"conclusion\": true}]}"));
+
+  assertField(0, "-12.5e+3");
+  assertField(1, "null");
+  assertField(3, "true");
+}
+
+static void test_missing_field_is_empty()
+{
+  TEST_ASSERT_TRUE(feed("{\"status\": \"ok\", \"author\": {\"name\": \"top level, not commit.author\"}}"));
+
+  assertField(0, "ok");
+  TEST_ASSERT_FALSE(_scanner.isFound(2));
+  TEST_ASSERT_EQUAL_STRING("", _scanner.getValue(2));
+}
+
+static void test_escapes_and_non_ascii()
+{
+  //\u00e9 and a raw UTF-8 e-acute both become one ?, the LCD can't show them
+  TEST_ASSERT_TRUE(feed("{\"status\": \"a\\tb\\/c\\u0041\\u00e9 caf\xc3\xa9\"}"));
+
+  assertField(0, "a\tb/cA? caf?");
+}
+
+static void test_long_value_is_cut()
+{
+  char json[128];
+  char expected[JSON_MAX_VALUE];
+  memset(expected, 'x', sizeof(expected) - 1);
+  expected[sizeof(expected) - 1] = '\0';
+  strcpy(json, "{\"status\": \"");
+  memset(json + strlen(json), 'x', 60);
+  strcpy(json + 12 + 60, "\"}");
+
+  TEST_ASSERT_TRUE(feed(json));
+  assertField(0, expected);
+}
+
+static void test_invalid_input_is_an_error()
+{
+  const char * bad[] = { "{\"status\" \"x\"}", "{\"status\": \"x\",}", "[1 2]", "{\"a\": \"\\q\"}", "{\"a\": \"\\u00g0\"}", "}", "{\"a\": [}" };
+
+  for (uint8_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+  {
+    _scanner.reset();
+    TEST_ASSERT_FALSE(feed(bad[i]));
+    TEST_ASSERT_TRUE(_scanner.hasError());
+    TEST_ASSERT_FALSE(_scanner.isDone());
+  }
+}
+
+static void test_too_deep_is_an_error()
+{
+  char json[JSON_MAX_DEPTH + 2];
+  memset(json, '[', JSON_MAX_DEPTH + 1);
+  json[JSON_MAX_DEPTH + 1] = '\0';
+
+  TEST_ASSERT_FALSE(feed(json));
+
+  _scanner.reset();
+  json[JSON_MAX_DEPTH] = '\0';
+  TEST_ASSERT_TRUE(feed(json));
+}
+
+static void test_trailing_data_is_ignored()
+{
+  TEST_ASSERT_TRUE(feed("{\"status\": \"ok\"} garbage {"));
+
+  TEST_ASSERT_TRUE(_scanner.isDone());
+  assertField(0, "ok");
+}
+
+static void test_reset_keeps_fields()
+{
+  feed("{\"status\": \"first\"}");
+  _scanner.reset();
+
+  TEST_ASSERT_FALSE(_scanner.isFound(0));
+  TEST_ASSERT_TRUE(feed("{\"status\": \"second\"}"));
+  assertField(0, "second");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_finds_nested_fields);
+  RUN_TEST(test_same_result_a_byte_at_a_time);
+  RUN_TEST(test_literals_are_kept_as_written);
+  RUN_TEST(test_missing_field_is_empty);
+  RUN_TEST(test_escapes_and_non_ascii);
+  RUN_TEST(test_long_value_is_cut);
+  RUN_TEST(test_invalid_input_is_an_error);
+  RUN_TEST(test_too_deep_is_an_error);
+  RUN_TEST(test_trailing_data_is_ignored);
+  RUN_TEST(test_reset_keeps_fields);
+  return UNITY_END();
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "JsonWriter.h"
+#include "ChunkWriter.h"
+
+//Counts every allocation in the test binary, writing JSON must not make any
+static long _allocations = 0;
+
+void * operator new(size_t size)
+{
+  void * p = malloc(size);
+
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+
+  _allocations++;
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+  free(p);
+}
+
+//Collects what a ChunkWriter hands on, and how many chunks it took
+class Collector : public Print
+{
+public:
+  Collector() : length(0), writes(0) {}
+
+  virtual size_t write(uint8_t value)
+  {
+    return write(&value, 1);
+  }
+
+  virtual size_t write(const uint8_t * data, size_t len)
+  {
+    memcpy(buffer + length, data, len);
+    length += len;
+    writes++;
+    return len;
+  }
+
+  char buffer[1024];
+  size_t length;
+  uint32_t writes;
+};
+
+static char _buffer[512];
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void assertOutput(const char * expected, ChunkWriter & out)
+{
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), out.length());
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, out.data(), out.length());
+}
+
+static void writeStatus(JsonWriter & json)
+{
+  json.beginObject();
+  json.beginArray("zones");
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    json.beginObject();
+    json.addUint("zone", i + 1);
+    json.addInt("flashTime", -1 - i);
+    json.addBool("on", i & 1);
+    json.endObject();
+  }
+
+  json.endArray();
+  json.beginArray("empty");
+  json.endArray();
+  json.addIp("ip", 0x0101A8C0);
+  json.addString("message", "build \"42\" ok");
+  json.endObject();
+}
+
+static const char * _status = "{\"zones\":[{\"zone\":1,\"flashTime\":-1,\"on\":false},{\"zone\":2,\"flashTime\":-2,\"on\":true}],"
+  "\"empty\":[],\"ip\":\"192.168.1.1\",\"message\":\"build \\\"42\\\" ok\"}";
+
+static void test_writes_nested_containers()
+{
+  ChunkWriter out(_buffer, sizeof(_buffer));
+  JsonWriter json(out);
+
+  writeStatus(json);
+
+  assertOutput(_status, out);
+}
+
+static void test_number_limits()
+{
+  ChunkWriter out(_buffer, sizeof(_buffer));
+  JsonWriter json(out);
+
+  json.beginArray();
+  json.addInt(NULL, INT32_MIN);
+  json.addInt(NULL, INT32_MAX);
+  json.addInt(NULL, 0);
+  json.addUint(NULL, UINT32_MAX);
+  json.endArray();
+
+  assertOutput("[-2147483648,2147483647,0,4294967295]", out);
+}
+
+//Only quotes, backslashes and control characters are escaped, UTF-8 goes through as it is
+static void test_string_escapes()
+{
+  ChunkWriter out(_buffer, sizeof(_buffer));
+  JsonWriter json(out);
+  const char value[] = "a\"b\\c\nd\re\tf\x01g\x7Fh caf\xc3\xa9 /";
+
+  json.addString(NULL, value);
+
+  assertOutput("\"a\\\"b\\\\c\\nd\\re\\tf\\u0001g\\u007fh caf\xc3\xa9 /\"", out);
+
+  //Well formed 2, 3 and 4 byte sequences pass through, every byte of a bad one becomes '?': a stray
+  //continuation byte, an overlong '/', a surrogate, a sequence cut short by the next character and by the end
+  ChunkWriter invalidOut(_buffer, sizeof(_buffer));
+  JsonWriter invalidJson(invalidOut);
+  const char invalid[] = "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80|\x80|\xc0\xaf|\xed\xa0\x80|\xe2\x82" "a|\xf0\x9f\x98";
+
+  invalidJson.addString(NULL, invalid);
+
+  assertOutput("\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80|?|??|???|??a|???\"", invalidOut);
+}
+
+static void test_string_with_length_can_hold_nul()
+{
+  ChunkWriter out(_buffer, sizeof(_buffer));
+  JsonWriter json(out);
+
+  json.addString(NULL, "ab\0cd", 5);
+
+  assertOutput("\"ab\\u0000cd\"", out);
+}
+
+static void test_chunked_output_matches()
+{
+  Collector target;
+  char small[7];
+  ChunkWriter out(small, sizeof(small), &target);
+  JsonWriter json(out);
+
+  writeStatus(json);
+  out.flush();
+
+  TEST_ASSERT_EQUAL_size_t(strlen(_status), target.length);
+  TEST_ASSERT_EQUAL_STRING_LEN(_status, target.buffer, target.length);
+  TEST_ASSERT_EQUAL_UINT32(strlen(_status), out.bytesWritten());
+  TEST_ASSERT_TRUE(target.writes <= (strlen(_status) + sizeof(small) - 1) / sizeof(small));
+}
+
+static void test_full_buffer_drops_the_rest()
+{
+  char small[8];
+  ChunkWriter out(small, sizeof(small));
+  JsonWriter json(out);
+
+  json.addString(NULL, "0123456789");
+
+  TEST_ASSERT_EQUAL_size_t(sizeof(small), out.length());
+  TEST_ASSERT_EQUAL_STRING_LEN("\"0123456", out.data(), sizeof(small));
+}
+
+static void test_writing_allocates_nothing()
+{
+  Collector target;
+  char small[16];
+  long before = _allocations;
+
+  for (uint16_t i = 0; i < 1000; i++)
+  {
+    ChunkWriter whole(_buffer, sizeof(_buffer));
+    JsonWriter json(whole);
+    writeStatus(json);
+
+    target.length = 0;
+    ChunkWriter chunked(small, sizeof(small), &target);
+    JsonWriter chunkedJson(chunked);
+    writeStatus(chunkedJson);
+    chunked.flush();
+  }
+
+  TEST_ASSERT_EQUAL_INT32(before, _allocations);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_writes_nested_containers);
+  RUN_TEST(test_number_limits);
+  RUN_TEST(test_string_escapes);
+  RUN_TEST(test_string_with_length_can_hold_nul);
+  RUN_TEST(test_chunked_output_matches);
+  RUN_TEST(test_full_buffer_drops_the_rest);
+  RUN_TEST(test_writing_allocates_nothing);
+  return UNITY_END();
+}
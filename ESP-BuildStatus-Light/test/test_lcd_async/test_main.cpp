@@ -0,0 +1,191 @@
+#include <unity.h>
+
+#include "LiquidCrystal.h"
+#include "LcdGpio.h"
+
+//Board wiring, no RW, so every wait is the timed settle and the fake clock decides when a byte may go
+#define RS 16
+#define EN 2
+#define RW_UNUSED 0
+
+static LiquidCrystal lcd(RS, EN, 5, 12, 4, 15);
+
+void setUp()
+{
+  //RW is tied low on the board, the model reads it from a pin nothing drives
+  hostPinValues[RW_UNUSED] = LOW;
+  lcdModelAttach(RS, RW_UNUSED, EN, 5, 12, 4, 15);
+  lcd.setAsync(false);
+  lcd.begin(20, 4);
+  delay(3);
+  lcd.setAsync(true);
+}
+
+void tearDown()
+{
+}
+
+static void test_send_only_queues()
+{
+  uint32_t executed = lcdModel.executed;
+
+  lcd.print("hello");
+
+  TEST_ASSERT_EQUAL(5, lcd.queued());
+  TEST_ASSERT_EQUAL_UINT32(executed, lcdModel.executed);
+}
+
+//However long ago the last byte went, one pump() puts one byte on the bus
+static void test_one_byte_per_pump()
+{
+  uint32_t executed = lcdModel.executed;
+
+  lcd.print("hello");
+
+  for (uint8_t i = 1; i <= 5; i++)
+  {
+    delay(1);
+    TEST_ASSERT_EQUAL(i < 5, lcd.pump());
+    TEST_ASSERT_EQUAL_UINT32(executed + i, lcdModel.executed);
+    TEST_ASSERT_EQUAL(5 - i, lcd.queued());
+  }
+
+  TEST_ASSERT_FALSE(lcd.pump());
+  TEST_ASSERT_EQUAL_STRING_LEN("hello", (const char *)lcdModel.ddram, 5);
+}
+
+//pump() never waits: until the settle time is up it sends nothing
+static void test_pump_waits_out_the_settle_time()
+{
+  uint32_t executed = lcdModel.executed;
+
+  lcd.print("ab");
+  lcd.pump();
+  TEST_ASSERT_EQUAL_UINT32(executed + 1, lcdModel.executed);
+
+  //Each pump() reads micros() at least once, so a few calls can't get past the 100uS
+  for (uint8_t i = 0; i < 20; i++)
+  {
+    TEST_ASSERT_TRUE(lcd.pump());
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(executed + 1, lcdModel.executed);
+
+  delayMicroseconds(LCD_SETTLE_US);
+  TEST_ASSERT_FALSE(lcd.pump());
+  TEST_ASSERT_EQUAL_UINT32(executed + 2, lcdModel.executed);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+}
+
+//Clear and home take milliseconds, the byte after them waits for LCD_SLOW_SETTLE_US
+static void test_slow_commands_hold_the_next_byte()
+{
+  void (LiquidCrystal::*slow[])() = { &LiquidCrystal::clear, &LiquidCrystal::home };
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    uint32_t executed = lcdModel.executed;
+    uint64_t sentAt;
+
+    (lcd.*slow[i])();
+    lcd.write('x');
+    delay(1);
+    lcd.pump();
+    sentAt = hostMicros;
+    TEST_ASSERT_EQUAL_UINT32(executed + 1, lcdModel.executed);
+
+    while (hostMicros - sentAt < LCD_SLOW_SETTLE_US - 10)
+    {
+      TEST_ASSERT_TRUE(lcd.pump());
+      delayMicroseconds(10);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(executed + 1, lcdModel.executed);
+
+    delayMicroseconds(20);
+    TEST_ASSERT_FALSE(lcd.pump());
+    TEST_ASSERT_EQUAL_UINT32(executed + 2, lcdModel.executed);
+    TEST_ASSERT_EQUAL_UINT8('x', lcdModel.ddram[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+    delay(3);
+  }
+}
+
+//A full ring makes send() wait for and push out the oldest byte, so nothing is lost or reordered
+static void test_full_ring_sends_synchronously()
+{
+  char text[LCD_QUEUE_SIZE + 40];
+
+  for (uint16_t i = 0; i < sizeof(text); i++)
+  {
+    text[i] = 'A' + i % 26;
+  }
+
+  uint32_t executed = lcdModel.executed;
+  lcd.setCursor(0, 0);
+  lcd.write((const uint8_t *)text, 40);
+  TEST_ASSERT_EQUAL(41, lcd.queued());
+  lcd.setCursor(0, 0);
+  lcd.write((const uint8_t *)text, sizeof(text) - 1);
+
+  TEST_ASSERT_EQUAL(LCD_QUEUE_SIZE, lcd.queued());
+  TEST_ASSERT_EQUAL_UINT32(41 + 1 + sizeof(text) - 1 - LCD_QUEUE_SIZE, lcdModel.executed - executed);
+
+  while (lcd.queued())
+  {
+    delay(1);
+    lcd.pump();
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(41 + 1 + sizeof(text) - 1, lcdModel.executed - executed);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+
+  //167 bytes from the home position go round both lines twice and 7 cells into a third time
+  for (uint8_t i = 0; i < 40; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(text[i < 7 ? 160 + i : 80 + i], lcdModel.ddram[i]);
+    TEST_ASSERT_EQUAL_UINT8(text[120 + i], lcdModel.ddram[0x40 + i]);
+  }
+}
+
+static void test_leaving_async_drains_the_ring()
+{
+  lcd.setCursor(0, 1);
+  lcd.print("drained");
+  TEST_ASSERT_EQUAL(8, lcd.queued());
+
+  lcd.setAsync(false);
+
+  TEST_ASSERT_EQUAL(0, lcd.queued());
+  TEST_ASSERT_EQUAL_STRING_LEN("drained", (const char *)lcdModel.ddram + 0x40, 7);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+}
+
+//begin() starts the panel over, so whatever was queued for it before is dropped
+static void test_begin_drops_the_ring()
+{
+  uint32_t executed;
+
+  lcd.print("stale");
+  lcd.begin(20, 4);
+  executed = lcdModel.executed;
+
+  TEST_ASSERT_EQUAL(0, lcd.queued());
+  delay(3);
+  TEST_ASSERT_FALSE(lcd.pump());
+  TEST_ASSERT_EQUAL_UINT32(executed, lcdModel.executed);
+  TEST_ASSERT_EQUAL_UINT8(' ', lcdModel.ddram[0]);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_send_only_queues);
+  RUN_TEST(test_one_byte_per_pump);
+  RUN_TEST(test_pump_waits_out_the_settle_time);
+  RUN_TEST(test_slow_commands_hold_the_next_byte);
+  RUN_TEST(test_full_ring_sends_synchronously);
+  RUN_TEST(test_leaving_async_drains_the_ring);
+  RUN_TEST(test_begin_drops_the_ring);
+  return UNITY_END();
+}
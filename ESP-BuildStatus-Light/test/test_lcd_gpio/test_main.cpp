@@ -0,0 +1,258 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include "LiquidCrystal.h"
+#include "LcdGpio.h"
+
+//Same wiring as the board: RS 16, EN 2, D4-D7 on 5, 12, 4, 15. The board has no RW, the busy flag tests
+//put it on GPIO 0.
+#define RS 16
+#define RW 0
+#define EN 2
+#define BIT(pin) (1UL << (pin))
+#define DATA_MASK (BIT(5) | BIT(12) | BIT(4) | BIT(15))
+
+void setUp()
+{
+  lcdGpioReset();
+  lcdModel.attached = false;
+}
+
+void tearDown()
+{
+}
+
+//Checks the 5 writes for one nibble starting at the log entry at index
+static void assertNibble(uint32_t index, uint32_t set)
+{
+  TEST_ASSERT_TRUE(lcdGpioLog[index].set);
+  TEST_ASSERT_EQUAL_HEX32(set, lcdGpioLog[index].mask);
+  TEST_ASSERT_FALSE(lcdGpioLog[index + 1].set);
+  TEST_ASSERT_EQUAL_HEX32(DATA_MASK & ~set, lcdGpioLog[index + 1].mask);
+
+  //Enable pulse
+  TEST_ASSERT_FALSE(lcdGpioLog[index + 2].set);
+  TEST_ASSERT_EQUAL_HEX32(BIT(EN), lcdGpioLog[index + 2].mask);
+  TEST_ASSERT_TRUE(lcdGpioLog[index + 3].set);
+  TEST_ASSERT_EQUAL_HEX32(BIT(EN), lcdGpioLog[index + 3].mask);
+  TEST_ASSERT_FALSE(lcdGpioLog[index + 4].set);
+  TEST_ASSERT_EQUAL_HEX32(BIT(EN), lcdGpioLog[index + 4].mask);
+}
+
+static void test_nibble_is_one_set_and_one_clear()
+{
+  LiquidCrystal lcd(RS, EN, 5, 12, 4, 15);
+  lcd.begin(20, 4);
+  lcdGpioReset();
+
+  //0x41: high nibble 4 is D6 (GPIO 4), low nibble 1 is D4 (GPIO 5)
+  lcd.write('A');
+
+  TEST_ASSERT_EQUAL_UINT32(10, lcdGpioWrites);
+  assertNibble(0, BIT(4));
+  assertNibble(5, BIT(5));
+  TEST_ASSERT_EQUAL(HIGH, hostPinValues[RS]);
+  TEST_ASSERT_EQUAL(HIGH, hostPinValues[5]);
+  TEST_ASSERT_EQUAL(LOW, hostPinValues[4]);
+  TEST_ASSERT_EQUAL(LOW, hostPinValues[EN]);
+}
+
+static void test_every_nibble_value_drives_the_data_pins()
+{
+  LiquidCrystal lcd(RS, EN, 5, 12, 4, 15);
+  const uint8_t pins[4] = { 5, 12, 4, 15 };
+  lcd.begin(20, 4);
+
+  for (uint16_t value = 0; value < 256; value++)
+  {
+    lcdGpioReset();
+    lcd.write((uint8_t)value);
+
+    TEST_ASSERT_EQUAL_UINT32(10, lcdGpioWrites);
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      TEST_ASSERT_EQUAL(value & (1 << i) ? HIGH : LOW, hostPinValues[pins[i]]);
+    }
+  }
+}
+
+static void test_command_leaves_rs_low()
+{
+  LiquidCrystal lcd(RS, EN, 5, 12, 4, 15);
+  lcd.begin(20, 4);
+  lcd.write('A');
+  lcdGpioReset();
+
+  lcd.setCursor(0, 1);
+
+  TEST_ASSERT_EQUAL_UINT32(10, lcdGpioWrites);
+  TEST_ASSERT_EQUAL(LOW, hostPinValues[RS]);
+}
+
+//The data pins go back to digitalWrite(), only the enable pulse still uses the registers
+static void test_data_pin_past_15_falls_back_to_digital_write()
+{
+  LiquidCrystal lcd(RS, EN, 5, 12, 4, 16);
+  lcd.begin(20, 4);
+  lcdGpioReset();
+
+  lcd.write(0xFF);
+
+  TEST_ASSERT_EQUAL_UINT32(6, lcdGpioWrites);
+
+  for (uint8_t i = 0; i < 6; i++)
+  {
+    TEST_ASSERT_EQUAL_HEX32(BIT(EN), lcdGpioLog[i].mask);
+  }
+
+  TEST_ASSERT_EQUAL(HIGH, hostPinValues[16]);
+}
+
+//A panel with RW wired, and the controller model behind it
+static void beginWithModel(LiquidCrystal &lcd)
+{
+  lcdModelAttach(RS, RW, EN, 5, 12, 4, 15);
+  lcd.begin(20, 4);
+}
+
+static void test_model_sees_what_the_driver_sends()
+{
+  LiquidCrystal lcd(RS, RW, EN, 5, 12, 4, 15);
+  beginWithModel(lcd);
+
+  TEST_ASSERT_TRUE(lcdModel.fourBit);
+  lcd.setCursor(2, 1);
+  lcd.print("Build");
+
+  TEST_ASSERT_EQUAL_STRING_LEN("Build", (const char *)lcdModel.ddram + 0x42, 5);
+  TEST_ASSERT_EQUAL_HEX8(0x47, lcdModel.address);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+}
+
+static void test_read_status_returns_the_address_counter()
+{
+  LiquidCrystal lcd(RS, RW, EN, 5, 12, 4, 15);
+  beginWithModel(lcd);
+  delay(2);
+
+  lcd.setCursor(5, 2);
+  delay(1);
+  TEST_ASSERT_EQUAL_HEX8(0x19, lcd.readStatus());
+
+  lcd.write('x');
+  delay(1);
+  TEST_ASSERT_EQUAL_HEX8(0x1A, lcd.readStatus());
+
+  //Reading leaves the data pins as outputs again, so the next byte still goes out
+  lcd.write('y');
+  TEST_ASSERT_EQUAL_UINT8('y', lcdModel.ddram[0x1A]);
+}
+
+static void test_busy_flag_while_clearing()
+{
+  LiquidCrystal lcd(RS, RW, EN, 5, 12, 4, 15);
+  beginWithModel(lcd);
+  lcd.print("abc");
+  delay(1);
+
+  lcd.clear();
+
+  TEST_ASSERT_EQUAL_HEX8(0x80, lcd.readStatus());
+  delayMicroseconds(LCD_MODEL_SLOW_EXEC_US);
+  TEST_ASSERT_EQUAL_HEX8(0x00, lcd.readStatus());
+  TEST_ASSERT_EQUAL_UINT8(' ', lcdModel.ddram[0]);
+}
+
+//Without RW the status can't be read, the driver says it's busy and relies on the timed settle
+static void test_no_rw_pin_reads_busy()
+{
+  LiquidCrystal lcd(RS, EN, 5, 12, 4, 15);
+  lcd.begin(20, 4);
+
+  TEST_ASSERT_EQUAL_HEX8(0xFF, lcd.readStatus());
+}
+
+//Sends a 20x4 page of text plus the cursor moves and returns how long it took on the fake clock
+static uint64_t timePage(LiquidCrystal &lcd)
+{
+  uint64_t start = hostMicros;
+
+  for (uint8_t row = 0; row < 4; row++)
+  {
+    lcd.setCursor(0, row);
+    lcd.print("0123456789ABCDEFGHIJ");
+  }
+
+  lcd.setCursor(0, 0);
+  return hostMicros - start;
+}
+
+//Polling the busy flag lets each byte go as soon as the controller is done instead of after the worst case settle,
+//and neither way sends a byte the controller is still busy for
+static void test_busy_polling_is_faster_and_never_early()
+{
+  LiquidCrystal lcd(RS, RW, EN, 5, 12, 4, 15);
+  beginWithModel(lcd);
+  delay(2);
+
+  lcd.setBusyPolling(false);
+  uint64_t timed = timePage(lcd);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+
+  lcd.setBusyPolling(true);
+  uint64_t polled = timePage(lcd);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+
+  TEST_ASSERT_TRUE(polled < timed);
+  TEST_ASSERT_EQUAL_STRING_LEN("0123456789ABCDEFGHIJ", (const char *)lcdModel.ddram + 0x54, 20);
+}
+
+//Bytes per second on the fake clock, where micros() itself costs 1uS a call. That makes these the ratio
+//between the two ways rather than what the ESP manages.
+static void test_bench_busy_flag_against_timed_bytes_per_second()
+{
+  const uint8_t pages = 50;
+  const uint32_t bytes = pages * (4 * 20 + 5);
+  LiquidCrystal lcd(RS, RW, EN, 5, 12, 4, 15);
+  uint64_t timed = 0;
+  uint64_t polled = 0;
+  beginWithModel(lcd);
+  delay(2);
+  uint32_t executed = lcdModel.executed;
+
+  lcd.setBusyPolling(false);
+
+  for (uint8_t i = 0; i < pages; i++)
+  {
+    timed += timePage(lcd);
+  }
+
+  lcd.setBusyPolling(true);
+
+  for (uint8_t i = 0; i < pages; i++)
+  {
+    polled += timePage(lcd);
+  }
+
+  printf("timed:     %7.0f bytes/s\n", bytes * 1e6 / timed);
+  printf("busy flag: %7.0f bytes/s\n", bytes * 1e6 / polled);
+  TEST_ASSERT_EQUAL_UINT32(0, lcdModel.writesWhileBusy);
+  TEST_ASSERT_EQUAL_UINT32(2 * bytes, lcdModel.executed - executed);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nibble_is_one_set_and_one_clear);
+  RUN_TEST(test_every_nibble_value_drives_the_data_pins);
+  RUN_TEST(test_command_leaves_rs_low);
+  RUN_TEST(test_data_pin_past_15_falls_back_to_digital_write);
+  RUN_TEST(test_model_sees_what_the_driver_sends);
+  RUN_TEST(test_read_status_returns_the_address_counter);
+  RUN_TEST(test_busy_flag_while_clearing);
+  RUN_TEST(test_no_rw_pin_reads_busy);
+  RUN_TEST(test_busy_polling_is_faster_and_never_early);
+  RUN_TEST(test_bench_busy_flag_against_timed_bytes_per_second);
+  return UNITY_END();
+}
@@ -0,0 +1,223 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <chrono>
+#include <SPI.h>
+#include "LedEffects.h"
+
+#define PERIOD 2000
+#define TICK 20 //ms between frames, as the LED task runs
+#define BENCH_FRAMES 10000
+
+static LedEffectParams params;
+
+void setUp()
+{
+  SPI.reset();
+  params = LedEffectParams();
+  params.period = PERIOD;
+  params.red = 255;
+  params.green = 128;
+  params.blue = 0;
+  params.brightness = LED_FULL_BRIGHTNESS;
+  params.fromRed = 0;
+  params.fromGreen = 0;
+  params.fromBlue = 255;
+}
+
+void tearDown()
+{
+}
+
+static void assertPixel(LedFrame &frame, uint8_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+  uint8_t r, g, b;
+  frame.getPixel(index, r, g, b);
+  const uint8_t expected[3] = { red, green, blue };
+  const uint8_t actual[3] = { r, g, b };
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, 3);
+}
+
+static void assertAll(LedFrame &frame, uint8_t red, uint8_t green, uint8_t blue)
+{
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    assertPixel(frame, i, red, green, blue);
+  }
+}
+
+static void test_names_round_trip()
+{
+  for (uint8_t i = 0; i < EffectCount; i++)
+  {
+    const char * name = getLedEffectName((LedEffect)i);
+    TEST_ASSERT_EQUAL(i, getLedEffect(name, strlen(name)));
+  }
+
+  TEST_ASSERT_EQUAL(EffectBreathe, getLedEffect("BREATHE", 7));
+  TEST_ASSERT_EQUAL(EffectCount, getLedEffect("breath", 6));
+  TEST_ASSERT_EQUAL_STRING("unknown", getLedEffectName(EffectCount));
+}
+
+static void test_fade_goes_from_start_to_target_and_holds()
+{
+  LedFrame frame;
+  params.effect = EffectFade;
+
+  for (uint8_t eased = 0; eased < 2; eased++)
+  {
+    params.eased = eased;
+
+    renderLedEffect(params, 0, frame, 0, LED_COUNT);
+    assertAll(frame, 0, 0, 255);
+
+    renderLedEffect(params, PERIOD, frame, 0, LED_COUNT);
+    assertAll(frame, 255, 128, 0);
+
+    renderLedEffect(params, PERIOD * 10, frame, 0, LED_COUNT);
+    assertAll(frame, 255, 128, 0);
+  }
+}
+
+static void test_breathe_is_off_at_the_ends_and_full_in_the_middle()
+{
+  LedFrame frame;
+  uint8_t r, g, b;
+  params.effect = EffectBreathe;
+
+  renderLedEffect(params, 0, frame, 0, LED_COUNT);
+  assertAll(frame, 0, 0, 0);
+
+  renderLedEffect(params, PERIOD / 2, frame, 0, LED_COUNT);
+  frame.getPixel(LED_COUNT - 1, r, g, b);
+  TEST_ASSERT_GREATER_THAN(250, r);
+  TEST_ASSERT_GREATER_THAN(124, g);
+  TEST_ASSERT_EQUAL(0, b);
+
+  renderLedEffect(params, PERIOD * 3, frame, 0, LED_COUNT);
+  assertAll(frame, 0, 0, 0);
+}
+
+static void test_chase_lights_every_fourth_and_moves()
+{
+  LedFrame frame;
+  params.effect = EffectChase;
+
+  renderLedEffect(params, 0, frame, 0, LED_COUNT);
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    assertPixel(frame, i, i % 4 ? 0 : 255, i % 4 ? 0 : 128, 0);
+  }
+
+  //A quarter of the period moves it one LED on
+  renderLedEffect(params, PERIOD / 4, frame, 0, LED_COUNT);
+  assertPixel(frame, 0, 0, 0, 0);
+  assertPixel(frame, 1, 255, 128, 0);
+}
+
+static void test_comet_head_and_tail()
+{
+  LedFrame frame;
+  uint8_t r, g, b;
+  params.effect = EffectComet;
+
+  renderLedEffect(params, 0, frame, 0, LED_COUNT);
+
+  assertPixel(frame, 0, 255, 128, 0);
+  frame.getPixel(LED_COUNT - 1, r, g, b);
+  TEST_ASSERT_TRUE(r > 0 && r < 255);
+  assertPixel(frame, LED_COUNT / 3, 0, 0, 0);
+  assertPixel(frame, LED_COUNT - LED_COUNT / 3, 0, 0, 0);
+
+  //Half way round the head is half way along
+  renderLedEffect(params, PERIOD / 2, frame, 0, LED_COUNT);
+  assertPixel(frame, LED_COUNT / 2, 255, 128, 0);
+  assertPixel(frame, 0, 0, 0, 0);
+}
+
+static void test_progress_fills_to_percent_and_only_its_zone()
+{
+  LedFrame frame;
+  params.effect = EffectProgress;
+  params.progress = 50;
+
+  renderLedEffect(params, 0, frame, 4, 8);
+  assertAll(frame, 0, 0, 0);
+
+  renderLedEffect(params, PERIOD, frame, 4, 8);
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    bool lit = i >= 4 && i < 8;
+    assertPixel(frame, i, lit ? 255 : 0, lit ? 128 : 0, 0);
+  }
+
+  //Past 100 is held at 100
+  params.progress = 200;
+  renderLedEffect(params, PERIOD, frame, 4, 8);
+  assertPixel(frame, 11, 255, 128, 0);
+  assertPixel(frame, 12, 0, 0, 0);
+}
+
+static void test_short_period_is_raised_to_the_minimum()
+{
+  LedFrame frame;
+  params.effect = EffectFade;
+  params.period = 0;
+
+  renderLedEffect(params, MIN_EFFECT_PERIOD / 2, frame, 0, LED_COUNT);
+  assertPixel(frame, 0, 127, 63, 128);
+}
+
+//Renders and sends 10k frames of each effect the way the LED task does, one every TICK ms. The last frame
+//falls on a whole number of periods, so its colours are known. Reports the host time per frame, which is
+//only useful to compare changes against each other, not as the ESP's time.
+static void bench_effect(LedEffect effect, uint8_t red, uint8_t green, uint8_t blue)
+{
+  LedFrame frame;
+  params.effect = effect;
+  params.progress = 100;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i <= BENCH_FRAMES; i++)
+  {
+    renderLedEffect(params, i * TICK, frame, 0, LED_COUNT);
+    frame.show();
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  printf("%-8s %7.1f ns/frame, %u frames sent\n", getLedEffectName(effect), ns / (BENCH_FRAMES + 1),
+         (unsigned)frame.framesSent());
+
+  assertPixel(frame, 0, red, green, blue);
+  TEST_ASSERT_EQUAL_UINT32(frame.framesSent(), SPI.transfers);
+}
+
+static void test_bench_10k_frames()
+{
+  bench_effect(EffectFade, 255, 128, 0);
+  setUp();
+  bench_effect(EffectBreathe, 0, 0, 0);
+  setUp();
+  bench_effect(EffectChase, 255, 128, 0);
+  setUp();
+  bench_effect(EffectComet, 255, 128, 0);
+  setUp();
+  bench_effect(EffectProgress, 255, 128, 0);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_names_round_trip);
+  RUN_TEST(test_fade_goes_from_start_to_target_and_holds);
+  RUN_TEST(test_breathe_is_off_at_the_ends_and_full_in_the_middle);
+  RUN_TEST(test_chase_lights_every_fourth_and_moves);
+  RUN_TEST(test_comet_head_and_tail);
+  RUN_TEST(test_progress_fills_to_percent_and_only_its_zone);
+  RUN_TEST(test_short_period_is_raised_to_the_minimum);
+  RUN_TEST(test_bench_10k_frames);
+  return UNITY_END();
+}
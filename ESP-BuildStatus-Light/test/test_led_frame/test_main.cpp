@@ -0,0 +1,172 @@
+#include <unity.h>
+
+#include <SPI.h>
+#include "LedFrame.h"
+#include "LedGamma.h"
+
+#define WORD(i) (LED_SOF_LEN + (i) * 4)
+
+void setUp()
+{
+  SPI.reset();
+}
+
+void tearDown()
+{
+}
+
+static void assertWord(uint8_t index, uint8_t header, uint8_t blue, uint8_t green, uint8_t red)
+{
+  const uint8_t expected[4] = { header, blue, green, red };
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, SPI.bytes + WORD(index), 4);
+}
+
+static void assertFraming()
+{
+  const uint8_t start[LED_SOF_LEN] = { 0x00, 0x00, 0x00, 0x00 };
+  const uint8_t end[LED_EOF_LEN] = { 0xFF, 0x00 };
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(start, SPI.bytes, LED_SOF_LEN);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(end, SPI.bytes + LED_FRAME_LEN - LED_EOF_LEN, LED_EOF_LEN);
+}
+
+static void test_new_frame_is_all_off()
+{
+  LedFrame frame;
+
+  TEST_ASSERT_TRUE(frame.show());
+  TEST_ASSERT_EQUAL_UINT32(1, SPI.transfers);
+  TEST_ASSERT_EQUAL_UINT32(LED_FRAME_LEN, SPI.length);
+  assertFraming();
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    assertWord(i, LED_START_BYTE, 0, 0, 0);
+  }
+}
+
+static void test_full_colors_use_full_current_and_pwm()
+{
+  LedFrame frame;
+  frame.setPixel(0, 255, 255, 255);
+  frame.setPixel(1, 255, 0, 0);
+  frame.setPixel(2, 0, 255, 0);
+  frame.setPixel(3, 0, 0, 255);
+
+  frame.show();
+
+  assertFraming();
+  assertWord(0, 0xFF, 0xFF, 0xFF, 0xFF);
+  assertWord(1, 0xFF, 0x00, 0x00, 0xFF);
+  assertWord(2, 0xFF, 0x00, 0xFF, 0x00);
+  assertWord(3, 0xFF, 0xFF, 0x00, 0x00);
+  assertWord(4, LED_START_BYTE, 0, 0, 0);
+}
+
+//The global current is the lowest that fits, so above the bottom step the PWM keeps at least half its range
+static void test_dim_color_lowers_global_current()
+{
+  LedFrame frame;
+  frame.setPixel(0, 128, 0, 0);
+  frame.setPixel(1, 32, 0, 0);
+
+  frame.show();
+
+  uint8_t global = SPI.bytes[WORD(0)] & ~LED_START_BYTE;
+  TEST_ASSERT_EQUAL_HEX8(LED_START_BYTE, SPI.bytes[WORD(0)] & LED_START_BYTE);
+  TEST_ASSERT_GREATER_THAN(1, global);
+  TEST_ASSERT_TRUE(global < LED_GLOBAL_MAX);
+  TEST_ASSERT_GREATER_THAN(127, SPI.bytes[WORD(0) + 3]);
+  TEST_ASSERT_EQUAL_HEX8(0, SPI.bytes[WORD(0) + 1]);
+  TEST_ASSERT_EQUAL_HEX8(0, SPI.bytes[WORD(0) + 2]);
+
+  TEST_ASSERT_EQUAL_HEX8(LED_START_BYTE | 1, SPI.bytes[WORD(1)]);
+  TEST_ASSERT_GREATER_THAN(0, SPI.bytes[WORD(1) + 3]);
+}
+
+static void test_fill_only_lights_count()
+{
+  LedFrame frame;
+  frame.fill(0, 0, 255, LED_FULL_BRIGHTNESS, 3);
+
+  frame.show();
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    if (i < 3)
+    {
+      assertWord(i, 0xFF, 0xFF, 0x00, 0x00);
+    }
+    else
+    {
+      assertWord(i, LED_START_BYTE, 0, 0, 0);
+    }
+  }
+}
+
+static void test_zero_brightness_turns_everything_off()
+{
+  LedFrame frame;
+  frame.fill(255, 255, 255, LED_FULL_BRIGHTNESS);
+  frame.setBrightness(0);
+  frame.setPixel(LED_COUNT - 1, 255, 255, 255, 0);
+
+  frame.show();
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    assertWord(i, LED_START_BYTE, 0, 0, 0);
+  }
+
+  //Pixel brightness 0 alone is off too
+  frame.setBrightness(LED_FULL_BRIGHTNESS);
+  SPI.reset();
+  frame.show();
+  assertWord(0, 0xFF, 0xFF, 0xFF, 0xFF);
+  assertWord(LED_COUNT - 1, LED_START_BYTE, 0, 0, 0);
+}
+
+static void test_one_transfer_per_frame_and_none_when_clean()
+{
+  LedFrame frame;
+  frame.fill(255, 0, 0, LED_FULL_BRIGHTNESS);
+
+  TEST_ASSERT_TRUE(frame.show());
+  TEST_ASSERT_FALSE(frame.isDirty());
+
+  //Nothing changed, setting the same color again doesn't dirty it either
+  frame.setPixel(0, 255, 0, 0);
+  TEST_ASSERT_FALSE(frame.show());
+  TEST_ASSERT_EQUAL_UINT32(1, SPI.transfers);
+
+  TEST_ASSERT_TRUE(frame.show(true));
+  TEST_ASSERT_EQUAL_UINT32(2, SPI.transfers);
+
+  frame.setPixel(5, 0, 255, 0);
+  TEST_ASSERT_TRUE(frame.show());
+  TEST_ASSERT_EQUAL_UINT32(3, SPI.transfers);
+  TEST_ASSERT_EQUAL_UINT32(3 * LED_FRAME_LEN, SPI.length);
+  TEST_ASSERT_EQUAL_UINT32(3, frame.framesSent());
+}
+
+static void test_out_of_range_pixel_is_ignored()
+{
+  LedFrame frame;
+  frame.show();
+
+  frame.setPixel(LED_COUNT, 255, 255, 255);
+
+  TEST_ASSERT_FALSE(frame.isDirty());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_new_frame_is_all_off);
+  RUN_TEST(test_full_colors_use_full_current_and_pwm);
+  RUN_TEST(test_dim_color_lowers_global_current);
+  RUN_TEST(test_fill_only_lights_count);
+  RUN_TEST(test_zero_brightness_turns_everything_off);
+  RUN_TEST(test_one_transfer_per_frame_and_none_when_clean);
+  RUN_TEST(test_out_of_range_pixel_is_ignored);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "MessagePages.h"
+
+#define SOAK_MESSAGES 100000
+
+//Every allocation in the test binary goes through here, so the soak can check the heap never moves
+static long _allocations = 0;
+static long _liveBytes = 0;
+
+void * operator new(size_t size)
+{
+  size_t * block = (size_t *)malloc(sizeof(size_t) + size);
+
+  if (block == NULL)
+  {
+    throw std::bad_alloc();
+  }
+
+  _allocations++;
+  _liveBytes += size;
+  *block = size;
+  return block + 1;
+}
+
+void operator delete(void * p) noexcept
+{
+  if (p != NULL)
+  {
+    size_t * block = (size_t *)p - 1;
+    _liveBytes -= *block;
+    free(block);
+  }
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+static MessagePages _pages;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void setMessage(const char * message)
+{
+  _pages.set(message, strlen(message));
+}
+
+static void assertLine(uint8_t index, const char * expected)
+{
+  const MessageLine &line = _pages.line(index);
+  TEST_ASSERT_EQUAL_UINT8(strlen(expected), line.len);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, _pages.text() + line.offset, line.len);
+}
+
+//Lines are spans of the text in order, at most one space apart, and each row is its line padded with spaces
+static void assertWrapped()
+{
+  uint16_t next = 0;
+
+  TEST_ASSERT_TRUE(_pages.lineCount() <= MAX_MESSAGE_LINES);
+
+  for (uint8_t i = 0; i < _pages.lineCount(); i++)
+  {
+    const MessageLine &line = _pages.line(i);
+    const char * row = _pages.page(i);
+
+    TEST_ASSERT_TRUE(line.len < MESSAGE_COLS);
+    TEST_ASSERT_TRUE(line.offset == next || (line.offset == next + 1 && _pages.text()[next] == ' '));
+    TEST_ASSERT_EQUAL_MEMORY(_pages.text() + line.offset, row, line.len);
+
+    for (uint8_t col = line.len; col < MESSAGE_COLS; col++)
+    {
+      TEST_ASSERT_EQUAL(' ', row[col]);
+    }
+
+    next = line.offset + line.len;
+  }
+
+  //Only a space the last line broke on is left over
+  if (_pages.lineCount() < MAX_MESSAGE_LINES)
+  {
+    TEST_ASSERT_TRUE(_pages.length() == next || (_pages.length() == next + 1 && _pages.text()[next] == ' '));
+  }
+}
+
+static void test_wraps_at_the_last_space_that_fits()
+{
+  setMessage("Build 1234 failed on main, tests are red again");
+
+  TEST_ASSERT_EQUAL_UINT8(3, _pages.lineCount());
+  assertLine(0, "Build 1234 failed");
+  assertLine(1, "on main, tests are");
+  assertLine(2, "red again");
+  TEST_ASSERT_EQUAL_UINT8(1, _pages.pageCount());
+  assertWrapped();
+}
+
+static void test_long_word_is_cut()
+{
+  setMessage("abcdefghijklmnopqrstuvwxyz");
+
+  TEST_ASSERT_EQUAL_UINT8(2, _pages.lineCount());
+  assertLine(0, "abcdefghijklmnopqrs");
+  assertLine(1, "tuvwxyz");
+  assertWrapped();
+}
+
+static void test_pages_scroll_a_line_at_a_time()
+{
+  setMessage("one two three four five six seven eight nine ten eleven twelve thirteen fourteen fifteen");
+
+  TEST_ASSERT_GREATER_THAN(MESSAGE_PAGE_ROWS, _pages.lineCount());
+  TEST_ASSERT_EQUAL_UINT8(_pages.lineCount(), _pages.pageCount());
+
+  //The last page starts at the last line, with blank rows under it
+  const char * last = _pages.page(_pages.pageCount() - 1);
+  for (uint16_t i = MESSAGE_COLS; i < MESSAGE_PAGE_ROWS * MESSAGE_COLS; i++)
+  {
+    TEST_ASSERT_EQUAL(' ', last[i]);
+  }
+
+  assertWrapped();
+}
+
+static void test_empty_message_has_no_pages()
+{
+  setMessage("hello");
+  _pages.set(NULL, 0);
+
+  TEST_ASSERT_EQUAL_UINT16(0, _pages.length());
+  TEST_ASSERT_EQUAL_UINT8(0, _pages.lineCount());
+  TEST_ASSERT_EQUAL_UINT8(0, _pages.pageCount());
+  TEST_ASSERT_EQUAL_STRING("", _pages.text());
+}
+
+static void test_long_message_is_capped()
+{
+  char message[MAX_MESSAGE_LEN + 50];
+  memset(message, 'x', sizeof(message));
+
+  _pages.set(message, sizeof(message));
+
+  TEST_ASSERT_EQUAL_UINT16(MAX_MESSAGE_LEN, _pages.length());
+  TEST_ASSERT_EQUAL_UINT16(MAX_MESSAGE_LEN, strlen(_pages.text()));
+  assertWrapped();
+}
+
+//Random words and lengths, including runs of spaces and messages over the cap
+static uint16_t makeMessage(char * message, uint16_t size, uint32_t &seed)
+{
+  seed = seed * 1103515245 + 12345;
+  uint16_t len = (seed >> 16) % size;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    uint8_t r = (seed >> 16) % 8;
+    message[i] = r == 0 ? ' ' : 'a' + (seed >> 20) % 26;
+  }
+
+  return len;
+}
+
+static void test_soak_keeps_heap_flat()
+{
+  char message[MAX_MESSAGE_LEN + 40];
+  uint32_t seed = 1;
+  long allocations = _allocations;
+  long liveBytes = _liveBytes;
+
+  for (uint32_t i = 0; i < SOAK_MESSAGES; i++)
+  {
+    uint16_t len = makeMessage(message, sizeof(message), seed);
+    _pages.set(message, len);
+    assertWrapped();
+  }
+
+  TEST_ASSERT_EQUAL_INT32(allocations, _allocations);
+  TEST_ASSERT_EQUAL_INT32(liveBytes, _liveBytes);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_wraps_at_the_last_space_that_fits);
+  RUN_TEST(test_long_word_is_cut);
+  RUN_TEST(test_pages_scroll_a_line_at_a_time);
+  RUN_TEST(test_empty_message_has_no_pages);
+  RUN_TEST(test_long_message_is_capped);
+  RUN_TEST(test_soak_keeps_heap_flat);
+  return UNITY_END();
+}
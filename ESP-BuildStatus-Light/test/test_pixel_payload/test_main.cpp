@@ -0,0 +1,232 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include <SPI.h>
+#include "PixelPayload.h"
+
+#define BENCH_PAYLOADS 10000
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint8_t pixels[PIXEL_PAYLOAD_RGBB_LEN];
+
+static std::string encode(const uint8_t * data, size_t len)
+{
+  std::string out;
+
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t bits = data[i] << 16;
+    size_t count = len - i < 3 ? len - i : 3;
+
+    if (count > 1) bits |= data[i + 1] << 8;
+    if (count > 2) bits |= data[i + 2];
+
+    for (size_t j = 0; j < 4; j++)
+    {
+      if (j <= count)
+      {
+        out += BASE64[(bits >> (18 - j * 6)) & 0x3F];
+      }
+      else
+      {
+        out += '=';
+      }
+    }
+  }
+
+  return out;
+}
+
+//The stream the frame sends is what matters, so compare it with a frame set pixel by pixel
+static void assertFrame(LedFrame &frame, const uint8_t * data, uint8_t stride)
+{
+  LedFrame expected;
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    const uint8_t * pixel = data + i * stride;
+    expected.setPixel(i, pixel[0], pixel[1], pixel[2], stride == 4 ? pixel[3] : LED_FULL_BRIGHTNESS);
+  }
+
+  expected.show(true);
+  frame.show(true);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data(), frame.data(), LED_FRAME_LEN);
+}
+
+static void assertUntouched(LedFrame &frame)
+{
+  uint8_t r, g, b;
+
+  for (uint8_t i = 0; i < LED_COUNT; i++)
+  {
+    frame.getPixel(i, r, g, b);
+    TEST_ASSERT_EQUAL(0, r | g | b);
+  }
+}
+
+void setUp()
+{
+  SPI.reset();
+
+  for (size_t i = 0; i < sizeof(pixels); i++)
+  {
+    pixels[i] = i * 37 + 11;
+  }
+}
+
+void tearDown()
+{
+}
+
+static void test_raw_rgb()
+{
+  LedFrame frame;
+
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, (const char *)pixels, PIXEL_PAYLOAD_RGB_LEN, false));
+  assertFrame(frame, pixels, 3);
+}
+
+static void test_raw_rgb_brightness()
+{
+  LedFrame frame;
+
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, (const char *)pixels, PIXEL_PAYLOAD_RGBB_LEN, false));
+  assertFrame(frame, pixels, 4);
+}
+
+static void test_raw_wrong_size()
+{
+  LedFrame frame;
+
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, (const char *)pixels, PIXEL_PAYLOAD_RGB_LEN - 1, false));
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, (const char *)pixels, PIXEL_PAYLOAD_RGBB_LEN + 1, false));
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, "", 0, false));
+  assertUntouched(frame);
+}
+
+static void test_base64_both_sizes()
+{
+  LedFrame frame;
+  std::string rgb = encode(pixels, PIXEL_PAYLOAD_RGB_LEN);
+  std::string rgbb = encode(pixels, PIXEL_PAYLOAD_RGBB_LEN);
+
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, rgb.c_str(), rgb.length(), true));
+  assertFrame(frame, pixels, 3);
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, rgbb.c_str(), rgbb.length(), true));
+  assertFrame(frame, pixels, 4);
+}
+
+static void test_base64_url_safe_and_query_space()
+{
+  LedFrame frame;
+  std::string standard = encode(pixels, PIXEL_PAYLOAD_RGBB_LEN);
+  std::string urlSafe = standard;
+  std::string query = standard;
+
+  for (size_t i = 0; i < standard.length(); i++)
+  {
+    if (standard[i] == '+') { urlSafe[i] = '-'; query[i] = ' '; }
+    if (standard[i] == '/') { urlSafe[i] = '_'; }
+  }
+
+  TEST_ASSERT_TRUE(standard.find('+') != std::string::npos && standard.find('/') != std::string::npos);
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, urlSafe.c_str(), urlSafe.length(), true));
+  assertFrame(frame, pixels, 4);
+
+  LedFrame fromQuery;
+  TEST_ASSERT_TRUE(setPixelsFromPayload(fromQuery, query.c_str(), query.length(), true));
+  assertFrame(fromQuery, pixels, 4);
+}
+
+static void test_base64_skips_filler()
+{
+  LedFrame frame;
+  std::string encoded = encode(pixels, PIXEL_PAYLOAD_RGB_LEN);
+  std::string wrapped;
+
+  for (size_t i = 0; i < encoded.length(); i++)
+  {
+    if (i && i % 76 == 0)
+    {
+      wrapped += "\r\n";
+    }
+    wrapped += encoded[i];
+  }
+  wrapped += "\t==\n";
+
+  TEST_ASSERT_TRUE(setPixelsFromPayload(frame, wrapped.c_str(), wrapped.length(), true));
+  assertFrame(frame, pixels, 3);
+}
+
+static void test_base64_rejects_bad_characters()
+{
+  LedFrame frame;
+  std::string encoded = encode(pixels, PIXEL_PAYLOAD_RGB_LEN);
+
+  encoded[40] = '*';
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, encoded.c_str(), encoded.length(), true));
+  assertUntouched(frame);
+}
+
+static void test_base64_rejects_wrong_size()
+{
+  LedFrame frame;
+  std::string shortBy3 = encode(pixels, PIXEL_PAYLOAD_RGB_LEN - 3);
+  std::string between = encode(pixels, PIXEL_PAYLOAD_RGB_LEN + 3);
+
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, shortBy3.c_str(), shortBy3.length(), true));
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, between.c_str(), between.length(), true));
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, "", 0, true));
+  assertUntouched(frame);
+}
+
+//72 bytes is 96 characters. One more used to floor back to 72 bytes and be taken.
+static void test_base64_rejects_lone_trailing_character()
+{
+  LedFrame frame;
+  std::string encoded = encode(pixels, PIXEL_PAYLOAD_RGB_LEN) + "Q";
+
+  TEST_ASSERT_EQUAL(97, encoded.length());
+  TEST_ASSERT_FALSE(setPixelsFromPayload(frame, encoded.c_str(), encoded.length(), true));
+  assertUntouched(frame);
+}
+
+static void test_bench_parse_to_frame()
+{
+  LedFrame frame;
+  std::string encoded = encode(pixels, PIXEL_PAYLOAD_RGBB_LEN);
+  bool ok = true;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < BENCH_PAYLOADS; i++)
+  {
+    ok &= setPixelsFromPayload(frame, encoded.c_str(), encoded.length(), true);
+    frame.show();
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  TEST_ASSERT_TRUE(ok);
+  printf("base64 RGB + brightness payload to frame: %.0f ns per payload (%u payloads)\n", ns / BENCH_PAYLOADS, BENCH_PAYLOADS);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_raw_rgb);
+  RUN_TEST(test_raw_rgb_brightness);
+  RUN_TEST(test_raw_wrong_size);
+  RUN_TEST(test_base64_both_sizes);
+  RUN_TEST(test_base64_url_safe_and_query_space);
+  RUN_TEST(test_base64_skips_filler);
+  RUN_TEST(test_base64_rejects_bad_characters);
+  RUN_TEST(test_base64_rejects_wrong_size);
+  RUN_TEST(test_base64_rejects_lone_trailing_character);
+  RUN_TEST(test_bench_parse_to_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,234 @@
+#include <unity.h>
+
+#include "Scheduler.h"
+
+//Virtual uS clock, tasks move it by however long they pretend to take
+static uint32_t fakeNow;
+static char order[64];
+static uint8_t orderLen;
+static uint32_t durations[MAX_SCHEDULER_TASKS];
+
+static unsigned long fakeClock()
+{
+  return fakeNow;
+}
+
+#define TASK(index, letter) \
+  static void task##letter() \
+  { \
+    if (orderLen < sizeof(order) - 1) \
+    { \
+      order[orderLen++] = #letter[0]; \
+    } \
+    fakeNow += durations[index]; \
+  }
+
+TASK(0, A)
+TASK(1, B)
+TASK(2, C)
+
+void setUp()
+{
+  fakeNow = 0;
+  orderLen = 0;
+  memset(order, 0, sizeof(order));
+  memset(durations, 0, sizeof(durations));
+}
+
+void tearDown()
+{
+}
+
+//Runs everything that is due at now, in the order the scheduler picks
+static void runDue(Scheduler &scheduler)
+{
+  while (scheduler.run(fakeNow))
+  {
+  }
+}
+
+static void test_nothing_runs_before_its_deadline()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 500);
+
+  TEST_ASSERT_TRUE(scheduler.run(0));
+  TEST_ASSERT_FALSE(scheduler.run(999));
+  TEST_ASSERT_TRUE(scheduler.run(1000));
+  TEST_ASSERT_EQUAL_UINT32(2, scheduler.getTask(0).runs);
+}
+
+static void test_table_full()
+{
+  Scheduler scheduler(fakeClock);
+
+  for (uint8_t i = 0; i < MAX_SCHEDULER_TASKS; i++)
+  {
+    TEST_ASSERT_EQUAL(i, scheduler.addTask("a", taskA, 1000, 500));
+  }
+
+  TEST_ASSERT_EQUAL(-1, scheduler.addTask("b", taskB, 1000, 500));
+  TEST_ASSERT_EQUAL(MAX_SCHEDULER_TASKS, scheduler.getTaskCount());
+}
+
+//The most overdue runs first, whatever order the tasks were added in
+static void test_earliest_deadline_first()
+{
+  Scheduler scheduler(fakeClock);
+  fakeNow = 0;
+  scheduler.addTask("a", taskA, 10000, 500);
+  fakeNow = 300;
+  scheduler.addTask("b", taskB, 10000, 500);
+  fakeNow = 100;
+  scheduler.addTask("c", taskC, 10000, 500);
+
+  fakeNow = 1000;
+  runDue(scheduler);
+
+  TEST_ASSERT_EQUAL_STRING("ACB", order);
+}
+
+//One call runs one task, so the one just run only comes round again once the rest have had their turn
+static void test_one_task_per_run()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1, 500);
+  scheduler.addTask("b", taskB, 1, 500);
+
+  fakeNow = 10;
+  TEST_ASSERT_TRUE(scheduler.run(fakeNow));
+  TEST_ASSERT_TRUE(scheduler.run(fakeNow));
+  TEST_ASSERT_EQUAL_STRING("AB", order);
+}
+
+static void test_overrun_is_counted()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 500);
+  durations[0] = 500;
+  scheduler.run(fakeNow);
+  durations[0] = 501;
+  fakeNow = 1000;
+  scheduler.run(fakeNow);
+
+  const SchedulerTask &task = scheduler.getTask(0);
+  TEST_ASSERT_EQUAL_UINT32(2, task.runs);
+  TEST_ASSERT_EQUAL_UINT32(1, task.overruns);
+  TEST_ASSERT_EQUAL_UINT32(501, task.maxDuration);
+}
+
+//A task that blocks for whole periods makes the others skip deadlines rather than run back to back to catch up
+static void test_long_overrun_skips_missed_periods()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 500);
+  scheduler.addTask("b", taskB, 100000, 500);
+  durations[1] = 3500;
+
+  runDue(scheduler);
+  TEST_ASSERT_EQUAL_UINT32(3500, fakeNow);
+
+  runDue(scheduler);
+
+  const SchedulerTask &task = scheduler.getTask(0);
+  TEST_ASSERT_EQUAL_UINT32(2, task.runs);
+  TEST_ASSERT_EQUAL_UINT32(2, task.skipped);
+  TEST_ASSERT_EQUAL_UINT32(2500, task.maxLatency);
+  TEST_ASSERT_EQUAL_UINT32(fakeNow + 1000, task.deadline);
+  TEST_ASSERT_FALSE(scheduler.run(fakeNow + 999));
+}
+
+static void test_jitter_is_max_minus_min_latency()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 500);
+
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.getTask(0).jitter());
+
+  scheduler.run(200);
+  scheduler.run(1050);
+  scheduler.run(2700);
+
+  const SchedulerTask &task = scheduler.getTask(0);
+  TEST_ASSERT_EQUAL_UINT32(50, task.minLatency);
+  TEST_ASSERT_EQUAL_UINT32(700, task.maxLatency);
+  TEST_ASSERT_EQUAL_UINT32(650, task.jitter());
+
+  scheduler.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, task.jitter());
+  scheduler.run(3900);
+  TEST_ASSERT_EQUAL_UINT32(900, task.minLatency);
+  TEST_ASSERT_EQUAL_UINT32(0, task.jitter());
+}
+
+//Replays a second of loop() with three tasks like the real ones: loop() idles 10uS when nothing is due.
+//Nothing is skipped, each runs once a period, and a task is never later than the others' run times added up.
+static void test_replay_of_a_busy_second()
+{
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 300);
+  scheduler.addTask("b", taskB, 5000, 1000);
+  scheduler.addTask("c", taskC, 20000, 2000);
+  durations[0] = 200;
+  durations[1] = 800;
+  durations[2] = 1500;
+
+  while (fakeNow < 1000000)
+  {
+    if (!scheduler.run(fakeNow))
+    {
+      fakeNow += 10;
+    }
+  }
+
+  const uint32_t expectedRuns[3] = { 1000, 200, 50 };
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    const SchedulerTask &task = scheduler.getTask(i);
+    TEST_ASSERT_TRUE(task.runs >= expectedRuns[i] && task.runs <= expectedRuns[i] + 1);
+    TEST_ASSERT_EQUAL_UINT32(0, task.skipped);
+    TEST_ASSERT_EQUAL_UINT32(0, task.overruns);
+    TEST_ASSERT_TRUE(task.maxLatency <= 200 + 800 + 1500);
+    TEST_ASSERT_TRUE(task.jitter() <= task.maxLatency);
+  }
+
+  //a is held up by c's 1500uS every 20mS, so its start moves about by at least that much
+  TEST_ASSERT_TRUE(scheduler.getTask(0).jitter() >= 1300);
+}
+
+//micros() wraps every 71 minutes, deadlines and latencies are differences so they carry on across it
+static void test_clock_wrap()
+{
+  fakeNow = 0xFFFFFFFF - 1500;
+  Scheduler scheduler(fakeClock);
+  scheduler.addTask("a", taskA, 1000, 500);
+
+  for (int i = 0; i < 5; i++)
+  {
+    TEST_ASSERT_TRUE(scheduler.run(fakeNow + 10));
+    fakeNow += 1000;
+    TEST_ASSERT_FALSE(scheduler.run(fakeNow - 1));
+  }
+
+  const SchedulerTask &task = scheduler.getTask(0);
+  TEST_ASSERT_EQUAL_UINT32(5, task.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, task.skipped);
+  TEST_ASSERT_EQUAL_UINT32(10, task.maxLatency);
+  TEST_ASSERT_EQUAL_UINT32(0, task.jitter());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_runs_before_its_deadline);
+  RUN_TEST(test_table_full);
+  RUN_TEST(test_earliest_deadline_first);
+  RUN_TEST(test_one_task_per_run);
+  RUN_TEST(test_overrun_is_counted);
+  RUN_TEST(test_long_overrun_skips_missed_periods);
+  RUN_TEST(test_jitter_is_max_minus_min_latency);
+  RUN_TEST(test_replay_of_a_busy_second);
+  RUN_TEST(test_clock_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,287 @@
+#include <unity.h>
+
+#include <string>
+#include "StatusPoller.h"
+
+#define URL "http://ci.example:8080/job/status.json"
+#define ADDRESS 0x0A00A8C0 //192.168.0.10 the way lwIP holds it
+#define INTERVAL 60
+#define DOCUMENT "{\"status\":\"success\",\"branch\":\"main\",\"author\":\"Ann\"}"
+
+static StatusPoller * poller;
+static std::string results;
+static uint32_t now;
+static WiFiFakeConnection server;
+
+static void onResult(JsonScanner &scanner)
+{
+  results += scanner.getValue(PollStatus);
+  results += "/";
+  results += scanner.getValue(PollBranch);
+  results += "/";
+  results += scanner.getValue(PollAuthor);
+  results += ";";
+}
+
+static void pollAt(uint32_t time)
+{
+  now = time;
+  hostMicros = (uint64_t)now * 1000;
+  poller->poll(now);
+}
+
+//Starts the next poll, one interval on, against a server that has just accepted the connection. A cached lookup
+//still comes back on the next poll(), so that gets a call too.
+static void startPoll()
+{
+  server = WiFiFakeConnection();
+  wifiFakeRemote = &server;
+  pollAt(now + INTERVAL * 1000);
+  pollAt(now);
+}
+
+static void reply(const char * response)
+{
+  server.input += response;
+  server.peerOpen = false;
+}
+
+static uint32_t count(PollResult result)
+{
+  return poller->getCount(result);
+}
+
+void setUp()
+{
+  //It points into itself, so it can't be copied over with a fresh one
+  poller = new StatusPoller(onResult);
+  results.clear();
+  hostDnsAddress = ADDRESS;
+  hostDnsCached = true;
+  hostDnsLookups = 0;
+  hostDnsCallback = NULL;
+  wifiFakeRemote = NULL;
+  server = WiFiFakeConnection();
+  now = 0;
+  hostMicros = 0;
+  TEST_ASSERT_TRUE(poller->configure(URL, strlen(URL), INTERVAL));
+}
+
+void tearDown()
+{
+  delete poller;
+}
+
+static void test_configure()
+{
+  TEST_ASSERT_FALSE(poller->configure("https://ci.example/", 19, INTERVAL));
+  TEST_ASSERT_FALSE(poller->configure("http://", 7, INTERVAL));
+  TEST_ASSERT_FALSE(poller->configure("http://host:0/", 14, INTERVAL));
+  TEST_ASSERT_FALSE(poller->configure("http://host:70000/", 18, INTERVAL));
+  TEST_ASSERT_TRUE(poller->configure("http://host", 11, 1));
+  TEST_ASSERT_EQUAL_UINT32(POLL_MIN_INTERVAL, poller->getInterval());
+  TEST_ASSERT_TRUE(poller->configure("http://host", 11, POLL_MAX_INTERVAL + 1));
+  TEST_ASSERT_EQUAL_UINT32(POLL_MAX_INTERVAL, poller->getInterval());
+  TEST_ASSERT_FALSE(poller->setField(PollBranch, "a.very.long.path.that.does.not.fit.in.the.field", 48));
+}
+
+//The first poll looks the host up, every later one reuses the address and sends the ETag it was given
+static void test_etag_then_not_modified()
+{
+  server = WiFiFakeConnection();
+  wifiFakeRemote = &server;
+  pollAt(0);
+  pollAt(0);
+
+  TEST_ASSERT_EQUAL_UINT32(1, hostDnsLookups);
+  TEST_ASSERT_EQUAL_STRING("ci.example", hostDnsName);
+  TEST_ASSERT_EQUAL_HEX32(ADDRESS, server.remoteAddress);
+  TEST_ASSERT_EQUAL(8080, server.remotePort);
+  TEST_ASSERT_EQUAL_STRING("GET /job/status.json HTTP/1.0\r\nHost: ci.example\r\nAccept: application/json\r\n"
+                           "User-Agent: ESP-BuildStatus-Light\r\n\r\n", server.output.c_str());
+
+  reply("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: \"v1\"\r\n\r\n" DOCUMENT);
+  pollAt(now + 20);
+
+  TEST_ASSERT_EQUAL_STRING("success/main/Ann;", results.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollChanged));
+  TEST_ASSERT_EQUAL(200, poller->getLastStatusCode());
+  TEST_ASSERT_TRUE(server.stopped);
+
+  //Not due yet
+  wifiFakeRemote = NULL;
+  pollAt(now + INTERVAL * 1000 - 21);
+  TEST_ASSERT_EQUAL_UINT32(0, count(PollFailed));
+
+  startPoll();
+  TEST_ASSERT_EQUAL_UINT32(1, hostDnsLookups);
+  TEST_ASSERT_TRUE(server.output.find("\r\nIf-None-Match: \"v1\"\r\n") != std::string::npos);
+
+  reply("HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\n\r\n");
+  pollAt(now + 20);
+
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollNotModified));
+  TEST_ASSERT_EQUAL(304, poller->getLastStatusCode());
+  TEST_ASSERT_EQUAL_STRING("success/main/Ann;", results.c_str());
+}
+
+//Every piece of the response split up, down to one byte per poll()
+static void test_dribbled_response()
+{
+  const char * response = "HTTP/1.1 200 OK\r\nETag: \"v2\"\r\nX-Long: " "0123456789012345678901234567890123456789"
+                          "0123456789012345678901234567890123456789012345678901234567890123456789\r\n\r\n"
+                          "{\"build\":{\"n\":5},\"status\":\"fail\\u0065d\",\"branch\":\"dev\",\"author\":\"Bo\"}";
+  startPoll();
+
+  for (const char * c = response; *c; c++)
+  {
+    TEST_ASSERT_EQUAL_STRING("", results.c_str());
+    server.input += *c;
+    pollAt(now + 1);
+  }
+
+  TEST_ASSERT_EQUAL_STRING("failed/dev/Bo;", results.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollChanged));
+  TEST_ASSERT_TRUE(server.stopped);
+
+  startPoll();
+  TEST_ASSERT_TRUE(server.output.find("If-None-Match: \"v2\"") != std::string::npos);
+}
+
+//A lookup that isn't cached doesn't hold up poll(), the connect waits for its answer
+static void test_lookup_in_progress()
+{
+  hostDnsCached = false;
+  server = WiFiFakeConnection();
+  wifiFakeRemote = &server;
+  pollAt(0);
+  pollAt(100);
+
+  TEST_ASSERT_EQUAL(0, server.remotePort);
+
+  hostDnsAnswer();
+  pollAt(200);
+
+  TEST_ASSERT_EQUAL_HEX32(ADDRESS, server.remoteAddress);
+  TEST_ASSERT_TRUE(server.output.find("GET /job/status.json") == 0);
+}
+
+static void test_unknown_host()
+{
+  hostDnsAddress = 0;
+  pollAt(0);
+  pollAt(0);
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollFailed));
+
+  //A lookup that never comes back gives up after POLL_TIMEOUT
+  hostDnsCached = false;
+  pollAt(INTERVAL * 1000);
+  pollAt(INTERVAL * 1000 + POLL_TIMEOUT);
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollFailed));
+  pollAt(INTERVAL * 1000 + POLL_TIMEOUT + 1);
+  TEST_ASSERT_EQUAL_UINT32(2, count(PollFailed));
+  TEST_ASSERT_EQUAL(0, poller->getLastStatusCode());
+}
+
+//The one wait: connecting to an address nothing answers on takes POLL_CONNECT_TIMEOUT, and the host is looked
+//up again next time in case it moved
+static void test_unreachable_host()
+{
+  pollAt(0);
+  pollAt(0);
+
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollFailed));
+  TEST_ASSERT_EQUAL_UINT32(POLL_CONNECT_TIMEOUT, poller->getMaxConnectWait());
+  TEST_ASSERT_EQUAL_UINT32(POLL_CONNECT_TIMEOUT, millis());
+
+  startPoll();
+  TEST_ASSERT_EQUAL_UINT32(2, hostDnsLookups);
+  TEST_ASSERT_EQUAL_HEX32(ADDRESS, server.remoteAddress);
+}
+
+static void test_failed_responses()
+{
+  startPoll();
+  reply("HTTP/1.1 500 Internal Server Error\r\n\r\nbroken");
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollFailed));
+  TEST_ASSERT_EQUAL(500, poller->getLastStatusCode());
+
+  //Closed half way through the headers
+  startPoll();
+  reply("HTTP/1.1 200 OK\r\nETag: \"v3\"\r\n");
+  pollAt(now + 1);
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_UINT32(2, count(PollFailed));
+
+  //Closed half way through the body
+  startPoll();
+  reply("HTTP/1.1 200 OK\r\n\r\n{\"status\":\"succ");
+  pollAt(now + 1);
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_UINT32(3, count(PollFailed));
+
+  //Not JSON
+  startPoll();
+  reply("HTTP/1.1 200 OK\r\n\r\n<html>");
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_UINT32(4, count(PollFailed));
+
+  //Stalls with the connection open
+  startPoll();
+  server.input = "HTTP/1.1 200 OK\r\n\r\n{";
+  pollAt(now + 1);
+  pollAt(now + POLL_TIMEOUT - 1);
+  TEST_ASSERT_EQUAL_UINT32(4, count(PollFailed));
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_UINT32(5, count(PollFailed));
+  TEST_ASSERT_TRUE(server.stopped);
+
+  TEST_ASSERT_EQUAL_STRING("", results.c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, count(PollChanged));
+}
+
+//A document without a status isn't taken, and its ETag isn't kept so the next poll fetches it whole
+static void test_document_without_status()
+{
+  startPoll();
+  reply("HTTP/1.1 200 OK\r\nETag: \"v4\"\r\n\r\n{\"branch\":\"main\"}");
+  pollAt(now + 1);
+
+  TEST_ASSERT_EQUAL_UINT32(1, count(PollFailed));
+  TEST_ASSERT_EQUAL_STRING("", results.c_str());
+
+  startPoll();
+  TEST_ASSERT_EQUAL(std::string::npos, server.output.find("If-None-Match"));
+}
+
+//Changing a field path forgets the ETag, the document may hold the new field
+static void test_new_field_refetches()
+{
+  startPoll();
+  reply("HTTP/1.1 200 OK\r\nETag: \"v5\"\r\n\r\n{\"status\":\"success\",\"commit\":{\"by\":\"Cy\"}}");
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_STRING("success//;", results.c_str());
+
+  TEST_ASSERT_TRUE(poller->setField(PollAuthor, "commit.by", 9));
+  startPoll();
+  TEST_ASSERT_EQUAL(std::string::npos, server.output.find("If-None-Match"));
+  reply("HTTP/1.1 200 OK\r\nETag: \"v5\"\r\n\r\n{\"status\":\"success\",\"commit\":{\"by\":\"Cy\"}}");
+  pollAt(now + 1);
+  TEST_ASSERT_EQUAL_STRING("success//;success//Cy;", results.c_str());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_configure);
+  RUN_TEST(test_etag_then_not_modified);
+  RUN_TEST(test_dribbled_response);
+  RUN_TEST(test_lookup_in_progress);
+  RUN_TEST(test_unknown_host);
+  RUN_TEST(test_unreachable_host);
+  RUN_TEST(test_failed_responses);
+  RUN_TEST(test_document_without_status);
+  RUN_TEST(test_new_field_refetches);
+  return UNITY_END();
+}
@@ -0,0 +1,284 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <chrono>
+#include "TokenTable.h"
+
+#define BENCH_LOOKUPS 20000
+
+static TokenEntries entries;
+static TokenTable table(entries);
+
+void setUp()
+{
+  table.clear();
+}
+
+void tearDown()
+{
+}
+
+static void userId(uint16_t number, char * text, size_t size)
+{
+  snprintf(text, size, "user-id-%u", number);
+}
+
+static void setUserId(uint16_t index, uint16_t number)
+{
+  char text[32];
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  userId(number, text, sizeof(text));
+  TokenTable::hashToken(text, strlen(text), digest);
+  TEST_ASSERT_TRUE(table.set(index, digest));
+}
+
+static int findUserId(uint16_t number)
+{
+  char text[32];
+
+  userId(number, text, sizeof(text));
+  return table.find(text, strlen(text));
+}
+
+//Digests that all start at the same slot, so every lookup has to probe past the ones before it
+static void collidingDigest(uint16_t number, uint8_t digest[TOKEN_DIGEST_SIZE])
+{
+  memset(digest, 0, TOKEN_DIGEST_SIZE);
+  digest[0] = 0x34;
+  digest[1] = 0x12;
+  digest[2] = number;
+  digest[3] = number >> 8;
+  digest[15] = 0xA5;
+}
+
+static void test_set_and_find()
+{
+  setUserId(3, 1);
+  setUserId(200, 2);
+
+  TEST_ASSERT_EQUAL(3, findUserId(1));
+  TEST_ASSERT_EQUAL(200, findUserId(2));
+  TEST_ASSERT_EQUAL(-1, findUserId(3));
+  TEST_ASSERT_EQUAL(-1, table.find("", 0));
+  TEST_ASSERT_EQUAL(2, table.getCount());
+  TEST_ASSERT_TRUE(table.has(3));
+  TEST_ASSERT_FALSE(table.has(4));
+  TEST_ASSERT_FALSE(table.has(TOKEN_CAPACITY));
+}
+
+static void test_digest_is_truncated_sha256()
+{
+  //SHA-256("abc") starts ba7816bf 8f01cfea 414140de 5dae2223
+  const uint8_t expected[TOKEN_DIGEST_SIZE] = { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23 };
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  TokenTable::hashToken("abc", 3, digest);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, TOKEN_DIGEST_SIZE);
+}
+
+static void test_overwrite_replaces_the_old_user_id()
+{
+  setUserId(5, 1);
+  setUserId(6, 2);
+  setUserId(5, 3);
+
+  TEST_ASSERT_EQUAL(-1, findUserId(1));
+  TEST_ASSERT_EQUAL(5, findUserId(3));
+  TEST_ASSERT_EQUAL(6, findUserId(2));
+  TEST_ASSERT_EQUAL(2, table.getCount());
+}
+
+static void test_out_of_range_set_is_refused()
+{
+  uint8_t digest[TOKEN_DIGEST_SIZE] = {};
+
+  TEST_ASSERT_FALSE(table.set(TOKEN_CAPACITY, digest));
+  TEST_ASSERT_EQUAL(0, table.getCount());
+
+  table.remove(TOKEN_CAPACITY);
+  table.remove(0);
+  TEST_ASSERT_EQUAL(0, table.getCount());
+}
+
+//Removing an entry from the middle of a probe chain mustn't hide the ones after it
+static void test_remove_keeps_the_rest_of_the_probe()
+{
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  for (uint16_t i = 0; i < 10; i++)
+  {
+    collidingDigest(i, digest);
+    table.set(i, digest);
+  }
+
+  table.remove(4);
+
+  for (uint16_t i = 0; i < 10; i++)
+  {
+    collidingDigest(i, digest);
+    TEST_ASSERT_EQUAL(i == 4 ? -1 : i, table.findDigest(digest));
+  }
+
+  TEST_ASSERT_EQUAL(9, table.getCount());
+  TEST_ASSERT_FALSE(table.has(4));
+
+  //And it can be found again once it is back
+  collidingDigest(4, digest);
+  table.set(4, digest);
+  TEST_ASSERT_EQUAL(4, table.findDigest(digest));
+}
+
+static void test_full_table()
+{
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    setUserId(i, i + 1000);
+  }
+
+  TEST_ASSERT_EQUAL(TOKEN_CAPACITY, table.getCount());
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    TEST_ASSERT_EQUAL(i, findUserId(i + 1000));
+  }
+
+  //Misses still end at an empty slot
+  for (uint16_t i = 0; i < 1000; i++)
+  {
+    TEST_ASSERT_EQUAL(-1, findUserId(i));
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i += 2)
+  {
+    table.remove(i);
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    TEST_ASSERT_EQUAL(i % 2 ? i : -1, findUserId(i + 1000));
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i += 2)
+  {
+    setUserId(i, i + 5000);
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    TEST_ASSERT_EQUAL(i, findUserId(i % 2 ? i + 1000 : i + 5000));
+  }
+}
+
+//Every entry in one chain, the worst a table can be laid out
+static void test_full_table_in_one_probe_chain()
+{
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    collidingDigest(i, digest);
+    table.set(i, digest);
+  }
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    collidingDigest(i, digest);
+    TEST_ASSERT_EQUAL(i, table.findDigest(digest));
+  }
+
+  collidingDigest(TOKEN_CAPACITY, digest);
+  TEST_ASSERT_EQUAL(-1, table.findDigest(digest));
+}
+
+//Entries written straight into the struct, like when loaded from flash, are found once load() lays out the slots
+static void test_load()
+{
+  setUserId(10, 1);
+  setUserId(20, 2);
+  TokenEntries copy = entries;
+  TokenTable loaded(copy);
+
+  TEST_ASSERT_EQUAL(0, loaded.getCount());
+  loaded.load();
+
+  TEST_ASSERT_EQUAL(2, loaded.getCount());
+  TEST_ASSERT_EQUAL(10, loaded.find("user-id-1", 9));
+  TEST_ASSERT_EQUAL(20, loaded.find("user-id-2", 9));
+}
+
+static double timeLookups(bool hit, uint16_t count)
+{
+  char text[32];
+  volatile int found = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < BENCH_LOOKUPS; i++)
+  {
+    userId(hit ? 1000 + i % count : 100000 + i, text, sizeof(text));
+    found += table.find(text, strlen(text)) >= 0;
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL(hit ? BENCH_LOOKUPS : 0, found);
+  return ns / BENCH_LOOKUPS;
+}
+
+//What a request pays to authenticate as the table fills. The SHA-256 is the same whatever the count, the
+//probe is what would grow. Host times, only useful to compare against each other.
+static void test_bench_auth_cost_by_token_count()
+{
+  const uint16_t counts[] = { 1, 16, 64, 128, 256 };
+  uint8_t digest[TOKEN_DIGEST_SIZE];
+
+  for (uint8_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+  {
+    table.clear();
+
+    for (uint16_t i = 0; i < counts[c]; i++)
+    {
+      setUserId(i, 1000 + i);
+    }
+
+    double hit = timeLookups(true, counts[c]);
+    double miss = timeLookups(false, counts[c]);
+    printf("%3u User Ids: %6.1f ns/hit %6.1f ns/miss\n", counts[c], hit, miss);
+  }
+
+  //The same, skipping the hash, against the worst layout
+  table.clear();
+
+  for (uint16_t i = 0; i < TOKEN_CAPACITY; i++)
+  {
+    collidingDigest(i, digest);
+    table.set(i, digest);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  volatile int found = 0;
+
+  for (uint32_t i = 0; i < BENCH_LOOKUPS; i++)
+  {
+    collidingDigest(i % TOKEN_CAPACITY, digest);
+    found += table.findDigest(digest) >= 0;
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  printf("256 in one chain: %6.1f ns/findDigest\n", ns / BENCH_LOOKUPS);
+  TEST_ASSERT_EQUAL(BENCH_LOOKUPS, found);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_set_and_find);
+  RUN_TEST(test_digest_is_truncated_sha256);
+  RUN_TEST(test_overwrite_replaces_the_old_user_id);
+  RUN_TEST(test_out_of_range_set_is_refused);
+  RUN_TEST(test_remove_keeps_the_rest_of_the_probe);
+  RUN_TEST(test_full_table);
+  RUN_TEST(test_full_table_in_one_probe_chain);
+  RUN_TEST(test_load);
+  RUN_TEST(test_bench_auth_cost_by_token_count);
+  return UNITY_END();
+}